@@ -0,0 +1,205 @@
+// Times the BatchMath kernels against the plain glm code they replace.
+// Built by the BatchMathBenchmark target when GABEX_BUILD_BENCHMARKS is on.
+
+#include "BatchMath.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace GWIN;
+
+namespace
+{
+    constexpr size_t OBJECT_COUNT = 50000;
+    constexpr int RUNS = 50;
+
+    // Best of RUNS in nanoseconds per object, the best run is the one least disturbed by the rest of the system
+    template <typename F>
+    double measure(F &&body)
+    {
+        double best = 1e30;
+        for (int run = 0; run < RUNS; ++run)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            body();
+            auto end = std::chrono::high_resolution_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count());
+        }
+        return best / OBJECT_COUNT;
+    }
+
+    // difference is the largest error of the matrices, or the number of objects the tests disagree on
+    void report(const char *name, double glmTime, double batchTime, double difference)
+    {
+        std::printf("%-12s glm %7.2f ns  batch %7.2f ns  x%5.2f  difference %g\n", name, glmTime, batchTime, glmTime / batchTime, difference);
+    }
+
+    // Keeps the compiler from dropping results nobody reads
+    volatile float sink;
+}
+
+int main()
+{
+    std::mt19937 random{42};
+    std::uniform_real_distribution<float> position{-100.f, 100.f};
+    std::uniform_real_distribution<float> unit{-1.f, 1.f};
+    std::uniform_real_distribution<float> size{0.5f, 2.f};
+
+    std::vector<float> tx(OBJECT_COUNT), ty(OBJECT_COUNT), tz(OBJECT_COUNT);
+    std::vector<float> qx(OBJECT_COUNT), qy(OBJECT_COUNT), qz(OBJECT_COUNT), qw(OBJECT_COUNT);
+    std::vector<float> sx(OBJECT_COUNT), sy(OBJECT_COUNT), sz(OBJECT_COUNT);
+    std::vector<float> radius(OBJECT_COUNT);
+
+    for (size_t i = 0; i < OBJECT_COUNT; ++i)
+    {
+        tx[i] = position(random), ty[i] = position(random), tz[i] = position(random);
+
+        glm::quat q = glm::normalize(glm::quat(unit(random), unit(random), unit(random), unit(random)));
+        qx[i] = q.x, qy[i] = q.y, qz[i] = q.z, qw[i] = q.w;
+
+        sx[i] = size(random), sy[i] = size(random), sz[i] = size(random);
+        radius[i] = size(random);
+    }
+
+    std::printf("BatchMath over %zu objects, %s plane tests\n", OBJECT_COUNT, BatchMath::usesAVX2() ? "AVX2" : "SSE");
+
+    // T * R * S, the way TransformComponent::mat4() builds it
+    std::vector<glm::mat4> glmMatrices(OBJECT_COUNT), batchMatrices(OBJECT_COUNT);
+    {
+        double glmTime = measure([&]()
+        {
+            for (size_t i = 0; i < OBJECT_COUNT; ++i)
+            {
+                glm::mat4 identity(1.f);
+                glmMatrices[i] = glm::translate(identity, {tx[i], ty[i], tz[i]}) * glm::mat4_cast(glm::quat(qw[i], qx[i], qy[i], qz[i])) * glm::scale(identity, {sx[i], sy[i], sz[i]});
+            }
+        });
+
+        BatchMath::TRSStreams streams{tx.data(), ty.data(), tz.data(), qx.data(), qy.data(), qz.data(), qw.data(), sx.data(), sy.data(), sz.data()};
+        double batchTime = measure([&]() { BatchMath::composeTRS(streams, OBJECT_COUNT, batchMatrices.data()); });
+
+        float maxError = 0.f;
+        for (size_t i = 0; i < OBJECT_COUNT; ++i)
+            for (int c = 0; c < 4; ++c)
+                for (int r = 0; r < 4; ++r)
+                    maxError = std::max(maxError, std::abs(glmMatrices[i][c][r] - batchMatrices[i][c][r]));
+
+        report("composeTRS", glmTime, batchTime, maxError);
+    }
+
+    // Parent * local, as the world matrix update does for children
+    {
+        std::vector<glm::mat4> glmProducts(OBJECT_COUNT), batchProducts(OBJECT_COUNT);
+        std::vector<glm::mat4> parents(glmMatrices.rbegin(), glmMatrices.rend());
+
+        double glmTime = measure([&]()
+        {
+            for (size_t i = 0; i < OBJECT_COUNT; ++i)
+            {
+                glmProducts[i] = parents[i] * glmMatrices[i];
+            }
+        });
+        double batchTime = measure([&]() { BatchMath::multiply(parents.data(), glmMatrices.data(), batchProducts.data(), OBJECT_COUNT); });
+
+        float maxError = 0.f;
+        for (size_t i = 0; i < OBJECT_COUNT; ++i)
+            for (int c = 0; c < 4; ++c)
+                for (int r = 0; r < 4; ++r)
+                    maxError = std::max(maxError, std::abs(glmProducts[i][c][r] - batchProducts[i][c][r]) / std::max(1.f, std::abs(glmProducts[i][c][r])));
+
+        report("multiply", glmTime, batchTime, maxError);
+    }
+
+    // A frustum looking down -z from the origin, covering part of the objects
+    glm::mat4 viewProjection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 150.f);
+    glm::vec4 planes[6];
+    {
+        glm::mat4 m = glm::transpose(viewProjection);
+        planes[0] = m[3] + m[0];
+        planes[1] = m[3] - m[0];
+        planes[2] = m[3] + m[1];
+        planes[3] = m[3] - m[1];
+        planes[4] = m[2];
+        planes[5] = m[3] - m[2];
+        for (glm::vec4 &plane : planes)
+        {
+            plane /= glm::length(glm::vec3(plane));
+        }
+    }
+
+    auto inside = [&](const glm::vec3 &point, float limit)
+    {
+        for (const glm::vec4 &plane : planes)
+        {
+            if (glm::dot(glm::vec3(plane), point) + plane.w < limit)
+                return false;
+        }
+        return true;
+    };
+
+    std::vector<uint8_t> glmVisible(OBJECT_COUNT), batchVisible(OBJECT_COUNT);
+    auto mismatches = [&]()
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < OBJECT_COUNT; ++i)
+        {
+            count += glmVisible[i] != batchVisible[i] ? 1 : 0;
+        }
+        return static_cast<double>(count);
+    };
+
+    {
+        double glmTime = measure([&]()
+        {
+            for (size_t i = 0; i < OBJECT_COUNT; ++i)
+            {
+                glmVisible[i] = inside({tx[i], ty[i], tz[i]}, -radius[i]) ? 1 : 0;
+            }
+        });
+        double batchTime = measure([&]() { BatchMath::testSpheres(planes, tx.data(), ty.data(), tz.data(), radius.data(), OBJECT_COUNT, batchVisible.data()); });
+
+        report("testSpheres", glmTime, batchTime, mismatches());
+    }
+
+    {
+        std::vector<float> minX(OBJECT_COUNT), minY(OBJECT_COUNT), minZ(OBJECT_COUNT);
+        std::vector<float> maxX(OBJECT_COUNT), maxY(OBJECT_COUNT), maxZ(OBJECT_COUNT);
+        for (size_t i = 0; i < OBJECT_COUNT; ++i)
+        {
+            minX[i] = tx[i] - sx[i], minY[i] = ty[i] - sy[i], minZ[i] = tz[i] - sz[i];
+            maxX[i] = tx[i] + sx[i], maxY[i] = ty[i] + sy[i], maxZ[i] = tz[i] + sz[i];
+        }
+
+        double glmTime = measure([&]()
+        {
+            for (size_t i = 0; i < OBJECT_COUNT; ++i)
+            {
+                bool visible = true;
+                for (int p = 0; p < 6 && visible; ++p)
+                {
+                    glm::vec3 corner{planes[p].x >= 0.f ? maxX[i] : minX[i], planes[p].y >= 0.f ? maxY[i] : minY[i], planes[p].z >= 0.f ? maxZ[i] : minZ[i]};
+                    visible = glm::dot(glm::vec3(planes[p]), corner) + planes[p].w >= 0.f;
+                }
+                glmVisible[i] = visible ? 1 : 0;
+            }
+        });
+        double batchTime = measure([&]()
+        {
+            BatchMath::testAABBs(planes, minX.data(), minY.data(), minZ.data(), maxX.data(), maxY.data(), maxZ.data(), OBJECT_COUNT, batchVisible.data());
+        });
+
+        report("testAABBs", glmTime, batchTime, mismatches());
+    }
+
+    sink = glmMatrices[OBJECT_COUNT / 2][3][0] + batchMatrices[OBJECT_COUNT / 3][3][1];
+
+    return 0;
+}
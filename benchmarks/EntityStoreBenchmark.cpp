@@ -0,0 +1,137 @@
+// Times the cached world matrices of GWEntityStore against rebuilding every matrix with
+// TransformComponent::mat4() in each pass that needs them, on a static 50k object scene.
+// Built by the EntityStoreBenchmark target when GABEX_BUILD_BENCHMARKS is on.
+
+#include "GWEntityStore.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace GWIN;
+
+namespace
+{
+    constexpr uint32_t OBJECT_COUNT = 50000;
+    constexpr uint32_t CHILDREN_PER_ROOT = 9;
+    constexpr int PASSES = 3; // main, shadow and culling each read every world matrix
+    constexpr int FRAMES = 100;
+
+    // Best of FRAMES in milliseconds per frame
+    template <typename F>
+    double measure(F &&frame)
+    {
+        double best = 1e30;
+        for (int run = 0; run < FRAMES; ++run)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            frame(run);
+            auto end = std::chrono::high_resolution_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+
+    // Keeps the compiler from dropping results nobody reads
+    volatile float sink;
+}
+
+int main()
+{
+    std::mt19937 random{42};
+    std::uniform_real_distribution<float> position{-100.f, 100.f};
+    std::uniform_real_distribution<float> angle{-180.f, 180.f};
+
+    GWEntityStore store;
+    std::vector<GWEntityStore::id_t> roots;
+
+    // Roots with a few children each, like imported models with their sub meshes
+    for (uint32_t id = 0; id < OBJECT_COUNT; ++id)
+    {
+        GWGameObject object = GWGameObject::createGameObject("Object", id);
+        object.transform.translation = {position(random), position(random), position(random)};
+        object.transform.rotateEuler({angle(random), angle(random), angle(random)});
+        store.insert(std::move(object));
+
+        if (id % (CHILDREN_PER_ROOT + 1) == 0)
+        {
+            roots.push_back(id);
+        }
+        else
+        {
+            store.setParent(id, roots.back());
+        }
+    }
+
+    store.updateWorldMatrices();
+
+    std::printf("%u objects, %zu roots, %d passes per frame\n", OBJECT_COUNT, roots.size(), PASSES);
+
+    // What every pass did before the cache: rebuild each matrix, parents first
+    std::vector<glm::mat4> rebuilt(store.size());
+    double perPass = measure([&](int)
+    {
+        const std::vector<TransformComponent> &transforms = store.getTransforms();
+        const std::vector<uint32_t> &parents = store.getParentIndices();
+
+        for (int pass = 0; pass < PASSES; ++pass)
+        {
+            for (size_t i = 0; i < transforms.size(); ++i)
+            {
+                glm::mat4 local = transforms[i].mat4();
+                rebuilt[i] = parents[i] == GWEntityStore::INVALID_INDEX ? local : rebuilt[parents[i]] * local;
+            }
+            sink = rebuilt[pass][3][0];
+        }
+    });
+
+    // The cache with nothing moving, every pass reads the stored matrices
+    double cachedStatic = measure([&](int)
+    {
+        store.updateWorldMatrices();
+        for (int pass = 0; pass < PASSES; ++pass)
+        {
+            sink = store.getWorldMatrices()[pass][3][0];
+        }
+    });
+
+    // The cache with one percent of the roots, and so of the objects, moving every frame
+    const size_t movingRoots = std::max<size_t>(1, roots.size() / 100);
+    double cachedMoving = measure([&](int frame)
+    {
+        for (size_t r = 0; r < movingRoots; ++r)
+        {
+            GWEntityStore::id_t id = roots[(frame * movingRoots + r) % roots.size()];
+            store.editTransform(id).translation.x += 0.01f;
+        }
+
+        store.updateWorldMatrices();
+        for (int pass = 0; pass < PASSES; ++pass)
+        {
+            sink = store.getWorldMatrices()[pass][3][0];
+        }
+    });
+
+    float maxError = 0.f;
+    for (size_t i = 0; i < store.size(); ++i)
+    {
+        glm::mat4 local = store.getTransforms()[i].mat4();
+        uint32_t parent = store.getParentIndices()[i];
+        rebuilt[i] = parent == GWEntityStore::INVALID_INDEX ? local : rebuilt[parent] * local;
+
+        for (int c = 0; c < 4; ++c)
+            for (int r = 0; r < 4; ++r)
+                maxError = std::max(maxError, std::abs(rebuilt[i][c][r] - store.getWorldMatrices()[i][c][r]));
+    }
+
+    std::printf("mat4() per pass        %8.3f ms/frame\n", perPass);
+    std::printf("cache, static scene    %8.3f ms/frame  x%.0f\n", cachedStatic, perPass / std::max(cachedStatic, 1e-6));
+    std::printf("cache, %zu roots moving %8.3f ms/frame  x%.1f\n", movingRoots, cachedMoving, perPass / std::max(cachedMoving, 1e-6));
+    std::printf("largest difference to mat4() %g\n", maxError);
+
+    return 0;
+}
@@ -0,0 +1,279 @@
+#include "BatchMath.hpp"
+#include "BatchMathAVX2.hpp"
+
+#if defined(GW_BATCH_SSE)
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+#endif
+
+namespace GWIN::BatchMath
+{
+    static bool detectAVX2()
+    {
+#if defined(GW_BATCH_SSE) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+
+        // The OS has to save the ymm registers as well
+        __cpuid(info, 1);
+        const bool osSavesAVX = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 0x6) == 0x6;
+        if (!osSavesAVX)
+            return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#elif defined(GW_BATCH_SSE) && defined(__GNUC__)
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+
+    bool usesAVX2()
+    {
+        static const bool supported = detectAVX2();
+        return supported;
+    }
+
+    static void composeScalar(const TRSStreams &in, size_t i, glm::mat4 &out)
+    {
+        const float x = in.qx[i], y = in.qy[i], z = in.qz[i], w = in.qw[i];
+
+        const float xx = x * x, yy = y * y, zz = z * z;
+        const float xy = x * y, xz = x * z, yz = y * z;
+        const float wx = w * x, wy = w * y, wz = w * z;
+
+        out[0] = glm::vec4(1.f - 2.f * (yy + zz), 2.f * (xy + wz), 2.f * (xz - wy), 0.f) * in.sx[i];
+        out[1] = glm::vec4(2.f * (xy - wz), 1.f - 2.f * (xx + zz), 2.f * (yz + wx), 0.f) * in.sy[i];
+        out[2] = glm::vec4(2.f * (xz + wy), 2.f * (yz - wx), 1.f - 2.f * (xx + yy), 0.f) * in.sz[i];
+        out[3] = glm::vec4(in.tx[i], in.ty[i], in.tz[i], 1.f);
+    }
+
+    void composeTRS(const TRSStreams &in, size_t count, glm::mat4 *out, const uint32_t *scatter)
+    {
+        size_t i = 0;
+
+#if defined(GW_BATCH_SSE)
+        const __m128 one = _mm_set1_ps(1.f);
+        const __m128 two = _mm_set1_ps(2.f);
+
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128 x = _mm_loadu_ps(in.qx + i);
+            const __m128 y = _mm_loadu_ps(in.qy + i);
+            const __m128 z = _mm_loadu_ps(in.qz + i);
+            const __m128 w = _mm_loadu_ps(in.qw + i);
+
+            const __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+            const __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+            const __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+            const __m128 sx = _mm_loadu_ps(in.sx + i);
+            const __m128 sy = _mm_loadu_ps(in.sy + i);
+            const __m128 sz = _mm_loadu_ps(in.sz + i);
+
+            // Every register holds one matrix element for four objects
+            __m128 c0x = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+            __m128 c0y = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+            __m128 c0z = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+            __m128 c0w = _mm_setzero_ps();
+
+            __m128 c1x = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+            __m128 c1y = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+            __m128 c1z = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+            __m128 c1w = _mm_setzero_ps();
+
+            __m128 c2x = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+            __m128 c2y = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+            __m128 c2z = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+            __m128 c2w = _mm_setzero_ps();
+
+            __m128 c3x = _mm_loadu_ps(in.tx + i);
+            __m128 c3y = _mm_loadu_ps(in.ty + i);
+            __m128 c3z = _mm_loadu_ps(in.tz + i);
+            __m128 c3w = one;
+
+            // After transposing, register k holds the column of object k
+            _MM_TRANSPOSE4_PS(c0x, c0y, c0z, c0w);
+            _MM_TRANSPOSE4_PS(c1x, c1y, c1z, c1w);
+            _MM_TRANSPOSE4_PS(c2x, c2y, c2z, c2w);
+            _MM_TRANSPOSE4_PS(c3x, c3y, c3z, c3w);
+
+            const __m128 columns[4][4] = {
+                {c0x, c1x, c2x, c3x},
+                {c0y, c1y, c2y, c3y},
+                {c0z, c1z, c2z, c3z},
+                {c0w, c1w, c2w, c3w}};
+
+            for (size_t k = 0; k < 4; ++k)
+            {
+                float *dst = &out[scatter ? scatter[i + k] : i + k][0][0];
+                _mm_storeu_ps(dst, columns[k][0]);
+                _mm_storeu_ps(dst + 4, columns[k][1]);
+                _mm_storeu_ps(dst + 8, columns[k][2]);
+                _mm_storeu_ps(dst + 12, columns[k][3]);
+            }
+        }
+#endif
+
+        for (; i < count; ++i)
+        {
+            composeScalar(in, i, out[scatter ? scatter[i] : i]);
+        }
+    }
+
+    glm::mat4 multiply(const glm::mat4 &a, const glm::mat4 &b)
+    {
+#if defined(GW_BATCH_SSE)
+        const __m128 a0 = _mm_loadu_ps(&a[0][0]);
+        const __m128 a1 = _mm_loadu_ps(&a[1][0]);
+        const __m128 a2 = _mm_loadu_ps(&a[2][0]);
+        const __m128 a3 = _mm_loadu_ps(&a[3][0]);
+
+        __m128 columns[4];
+        for (int j = 0; j < 4; ++j)
+        {
+            __m128 column = _mm_mul_ps(a0, _mm_set1_ps(b[j][0]));
+            column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(b[j][1])));
+            column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(b[j][2])));
+            column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(b[j][3])));
+            columns[j] = column;
+        }
+
+        glm::mat4 result;
+        for (int j = 0; j < 4; ++j)
+        {
+            _mm_storeu_ps(&result[j][0], columns[j]);
+        }
+        return result;
+#else
+        return a * b;
+#endif
+    }
+
+    void multiply(const glm::mat4 *a, const glm::mat4 *b, glm::mat4 *out, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = multiply(a[i], b[i]);
+        }
+    }
+
+    static bool sphereScalar(const glm::vec4 planes[6], float x, float y, float z, float radius)
+    {
+        for (int p = 0; p < 6; ++p)
+        {
+            if (planes[p].x * x + planes[p].y * y + planes[p].z * z + planes[p].w < -radius)
+                return false;
+        }
+        return true;
+    }
+
+    // radius may be null, which turns the spheres into points
+    static void testSpheresImpl(const glm::vec4 planes[6], const float *x, const float *y, const float *z, const float *radius, size_t count, uint8_t *visible)
+    {
+        size_t i = 0;
+
+        if (usesAVX2())
+        {
+            i = AVX2::testSpheres(&planes[0].x, x, y, z, radius, count, visible);
+        }
+
+#if defined(GW_BATCH_SSE)
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128 px = _mm_loadu_ps(x + i);
+            const __m128 py = _mm_loadu_ps(y + i);
+            const __m128 pz = _mm_loadu_ps(z + i);
+            const __m128 limit = radius ? _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i)) : _mm_setzero_ps();
+
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < 6; ++p)
+            {
+                __m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].x), px), _mm_set1_ps(planes[p].w));
+                distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].y), py), distance);
+                distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].z), pz), distance);
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, limit));
+            }
+
+            const int mask = _mm_movemask_ps(inside);
+            for (int k = 0; k < 4; ++k)
+            {
+                visible[i + k] = (mask >> k) & 1;
+            }
+        }
+#endif
+
+        for (; i < count; ++i)
+        {
+            visible[i] = sphereScalar(planes, x[i], y[i], z[i], radius ? radius[i] : 0.f) ? 1 : 0;
+        }
+    }
+
+    void testPoints(const glm::vec4 planes[6], const float *x, const float *y, const float *z, size_t count, uint8_t *visible)
+    {
+        testSpheresImpl(planes, x, y, z, nullptr, count, visible);
+    }
+
+    void testSpheres(const glm::vec4 planes[6], const float *x, const float *y, const float *z, const float *radius, size_t count, uint8_t *visible)
+    {
+        testSpheresImpl(planes, x, y, z, radius, count, visible);
+    }
+
+    void testAABBs(const glm::vec4 planes[6],
+                   const float *minX, const float *minY, const float *minZ,
+                   const float *maxX, const float *maxY, const float *maxZ,
+                   size_t count, uint8_t *visible)
+    {
+        // For every plane only the corner furthest along its normal matters, and that choice is the same for all boxes
+        const float *cornerX[6], *cornerY[6], *cornerZ[6];
+        for (int p = 0; p < 6; ++p)
+        {
+            cornerX[p] = planes[p].x >= 0.f ? maxX : minX;
+            cornerY[p] = planes[p].y >= 0.f ? maxY : minY;
+            cornerZ[p] = planes[p].z >= 0.f ? maxZ : minZ;
+        }
+
+        size_t i = 0;
+
+        if (usesAVX2())
+        {
+            i = AVX2::testAABBs(&planes[0].x, cornerX, cornerY, cornerZ, count, visible);
+        }
+
+#if defined(GW_BATCH_SSE)
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < 6; ++p)
+            {
+                __m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].x), _mm_loadu_ps(cornerX[p] + i)), _mm_set1_ps(planes[p].w));
+                distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].y), _mm_loadu_ps(cornerY[p] + i)), distance);
+                distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].z), _mm_loadu_ps(cornerZ[p] + i)), distance);
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+            }
+
+            const int mask = _mm_movemask_ps(inside);
+            for (int k = 0; k < 4; ++k)
+            {
+                visible[i + k] = (mask >> k) & 1;
+            }
+        }
+#endif
+
+        for (; i < count; ++i)
+        {
+            bool inside = true;
+            for (int p = 0; p < 6 && inside; ++p)
+            {
+                inside = planes[p].x * cornerX[p][i] + planes[p].y * cornerY[p][i] + planes[p].z * cornerZ[p][i] + planes[p].w >= 0.f;
+            }
+            visible[i] = inside ? 1 : 0;
+        }
+    }
+}
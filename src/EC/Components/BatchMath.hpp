@@ -0,0 +1,45 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GW_BATCH_SSE
+#endif
+
+// Math kernels that work on many objects per call.
+// Plane tests run 8 wide with AVX2 when the CPU has it (checked once at runtime), everything else 4 wide with SSE;
+// a scalar path handles tails and other targets.
+namespace GWIN::BatchMath
+{
+    // Whether the plane tests take the AVX2 kernels on this CPU
+    bool usesAVX2();
+
+    // Translation, rotation (quaternion) and scale as separate float streams
+    struct TRSStreams
+    {
+        const float *tx, *ty, *tz;
+        const float *qx, *qy, *qz, *qw;
+        const float *sx, *sy, *sz;
+    };
+
+    // out[scatter[i]] (or out[i] without scatter) = T * R * S, matching TransformComponent::mat4()
+    void composeTRS(const TRSStreams &in, size_t count, glm::mat4 *out, const uint32_t *scatter = nullptr);
+
+    glm::mat4 multiply(const glm::mat4 &a, const glm::mat4 &b);
+
+    // out[i] = a[i] * b[i], out may alias either input
+    void multiply(const glm::mat4 *a, const glm::mat4 *b, glm::mat4 *out, size_t count);
+
+    // Planes are (normal, distance) with normals pointing inside. visible[i] is 1 when inside or intersecting all six.
+    void testPoints(const glm::vec4 planes[6], const float *x, const float *y, const float *z, size_t count, uint8_t *visible);
+    void testSpheres(const glm::vec4 planes[6], const float *x, const float *y, const float *z, const float *radius, size_t count, uint8_t *visible);
+    void testAABBs(const glm::vec4 planes[6],
+                   const float *minX, const float *minY, const float *minZ,
+                   const float *maxX, const float *maxY, const float *maxZ,
+                   size_t count, uint8_t *visible);
+}
@@ -0,0 +1,69 @@
+#include "BatchMathAVX2.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace GWIN::BatchMath::AVX2
+{
+    size_t testSpheres(const float *planes, const float *x, const float *y, const float *z, const float *radius, size_t count, uint8_t *visible)
+    {
+        size_t i = 0;
+
+#if defined(__AVX2__)
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m256 px = _mm256_loadu_ps(x + i);
+            const __m256 py = _mm256_loadu_ps(y + i);
+            const __m256 pz = _mm256_loadu_ps(z + i);
+            const __m256 limit = radius ? _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i)) : _mm256_setzero_ps();
+
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int p = 0; p < 6; ++p)
+            {
+                const float *plane = planes + p * 4;
+                __m256 distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane[0]), px), _mm256_set1_ps(plane[3]));
+                distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane[1]), py), distance);
+                distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane[2]), pz), distance);
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, limit, _CMP_GE_OQ));
+            }
+
+            const int mask = _mm256_movemask_ps(inside);
+            for (int k = 0; k < 8; ++k)
+            {
+                visible[i + k] = (mask >> k) & 1;
+            }
+        }
+#endif
+
+        return i;
+    }
+
+    size_t testAABBs(const float *planes, const float *const cornerX[6], const float *const cornerY[6], const float *const cornerZ[6], size_t count, uint8_t *visible)
+    {
+        size_t i = 0;
+
+#if defined(__AVX2__)
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int p = 0; p < 6; ++p)
+            {
+                const float *plane = planes + p * 4;
+                __m256 distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane[0]), _mm256_loadu_ps(cornerX[p] + i)), _mm256_set1_ps(plane[3]));
+                distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane[1]), _mm256_loadu_ps(cornerY[p] + i)), distance);
+                distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane[2]), _mm256_loadu_ps(cornerZ[p] + i)), distance);
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+            }
+
+            const int mask = _mm256_movemask_ps(inside);
+            for (int k = 0; k < 8; ++k)
+            {
+                visible[i + k] = (mask >> k) & 1;
+            }
+        }
+#endif
+
+        return i;
+    }
+}
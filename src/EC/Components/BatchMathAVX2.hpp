@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 8 wide plane tests, built for AVX2 in a translation unit of their own and picked at runtime by BatchMath.
+// Planes are 6 x (normal, distance) as plain floats, so no inline glm code gets compiled for AVX2 and shared with
+// the rest of the program. Each kernel handles the first count / 8 * 8 elements and returns how many that was,
+// 0 when the file was built without AVX2.
+namespace GWIN::BatchMath::AVX2
+{
+    size_t testSpheres(const float *planes, const float *x, const float *y, const float *z, const float *radius, size_t count, uint8_t *visible);
+    size_t testAABBs(const float *planes, const float *const cornerX[6], const float *const cornerY[6], const float *const cornerZ[6], size_t count, uint8_t *visible);
+}
@@ -18,6 +18,9 @@ namespace GWIN
         void updateFrustumPlanes(const glm::mat4 vpMatrix);
 
         bool isPointInFrustum(const glm::vec3 point);
+
+        // Six (normal, distance) planes with normals pointing inside, ready for BatchMath
+        const glm::vec4 *getPlanes() const { return frustumPlanes; }
     private:
         glm::vec4 frustumPlanes[6];
     };
@@ -0,0 +1,765 @@
+#include "MeshOptimizer.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace GWIN::MeshOptimizer
+{
+    namespace
+    {
+        constexpr uint32_t NO_VERTEX = UINT32_MAX;
+
+        // FIFO cache kept as timestamps, a vertex is cached while fewer than cacheSize misses happened since it was loaded
+        struct FifoCache
+        {
+            std::vector<uint32_t> loadedAt;
+            uint32_t timestamp;
+            uint32_t cacheSize;
+
+            FifoCache(size_t vertexCount, uint32_t cacheSize) : loadedAt(vertexCount, 0), timestamp(cacheSize + 1), cacheSize(cacheSize) {}
+
+            uint32_t access(uint32_t vertex)
+            {
+                if (timestamp - loadedAt[vertex] > cacheSize)
+                {
+                    loadedAt[vertex] = timestamp++;
+                    return 1;
+                }
+                return 0;
+            }
+
+            uint32_t accessTriangle(const uint32_t *triangle)
+            {
+                return access(triangle[0]) + access(triangle[1]) + access(triangle[2]);
+            }
+
+            // Ages every vertex out of the cache
+            void flush() { timestamp += cacheSize + 1; }
+        };
+
+        // Triangles using each vertex, as one array sliced by offsets
+        struct TriangleAdjacency
+        {
+            std::vector<uint32_t> counts;
+            std::vector<uint32_t> offsets;
+            std::vector<uint32_t> triangles;
+
+            TriangleAdjacency(const uint32_t *indices, size_t indexCount, size_t vertexCount)
+                : counts(vertexCount, 0), offsets(vertexCount, 0), triangles(indexCount)
+            {
+                for (size_t i = 0; i < indexCount; ++i)
+                {
+                    counts[indices[i]]++;
+                }
+
+                uint32_t offset = 0;
+                for (size_t v = 0; v < vertexCount; ++v)
+                {
+                    offsets[v] = offset;
+                    offset += counts[v];
+                }
+
+                std::vector<uint32_t> fill = offsets;
+                for (size_t i = 0; i < indexCount; ++i)
+                {
+                    triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+                }
+            }
+        };
+    }
+
+    namespace
+    {
+        // Area weighted sum of plane quadrics, divided by the weight it gives the mean squared distance to the planes
+        struct Quadric
+        {
+            double a00{0}, a01{0}, a02{0}, a11{0}, a12{0}, a22{0};
+            double b0{0}, b1{0}, b2{0};
+            double c{0};
+            double weight{0};
+
+            static Quadric fromPlane(const glm::vec3 &normal, float distance, float weight)
+            {
+                Quadric q;
+                q.a00 = weight * normal.x * normal.x;
+                q.a01 = weight * normal.x * normal.y;
+                q.a02 = weight * normal.x * normal.z;
+                q.a11 = weight * normal.y * normal.y;
+                q.a12 = weight * normal.y * normal.z;
+                q.a22 = weight * normal.z * normal.z;
+                q.b0 = weight * normal.x * distance;
+                q.b1 = weight * normal.y * distance;
+                q.b2 = weight * normal.z * distance;
+                q.c = weight * double(distance) * distance;
+                q.weight = weight;
+                return q;
+            }
+
+            Quadric &operator+=(const Quadric &o)
+            {
+                a00 += o.a00; a01 += o.a01; a02 += o.a02;
+                a11 += o.a11; a12 += o.a12; a22 += o.a22;
+                b0 += o.b0; b1 += o.b1; b2 += o.b2;
+                c += o.c;
+                weight += o.weight;
+                return *this;
+            }
+
+            double error(const glm::vec3 &p) const
+            {
+                double x = p.x, y = p.y, z = p.z;
+                double e = a00 * x * x + a11 * y * y + a22 * z * z +
+                           2 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                           2 * (b0 * x + b1 * y + b2 * z) + c;
+                return weight > 0 ? std::max(e, 0.0) / weight : 0.0;
+            }
+        };
+
+        struct Collapse
+        {
+            uint32_t source;
+            uint32_t target;
+            double cost; // squared distance
+        };
+
+        uint64_t edgeKey(uint32_t a, uint32_t b)
+        {
+            return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+        }
+    }
+
+    VertexCacheStats analyzeVertexCache(const uint32_t *indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+    {
+        assert(indexCount % 3 == 0 && "Index count has to be a multiple of 3!");
+
+        VertexCacheStats stats{};
+        stats.triangles = indexCount / 3;
+
+        FifoCache cache(vertexCount, cacheSize);
+        std::vector<uint8_t> referenced(vertexCount, 0);
+
+        for (size_t i = 0; i < indexCount; ++i)
+        {
+            stats.transforms += cache.access(indices[i]);
+
+            if (!referenced[indices[i]])
+            {
+                referenced[indices[i]] = 1;
+                stats.vertices++;
+            }
+        }
+
+        return stats;
+    }
+
+    void optimizeVertexCache(uint32_t *destination, const uint32_t *indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+    {
+        assert(indexCount % 3 == 0 && "Index count has to be a multiple of 3!");
+        assert(destination != indices && "optimizeVertexCache can't work in place!");
+
+        size_t triangleCount = indexCount / 3;
+        if (triangleCount == 0)
+            return;
+
+        TriangleAdjacency adjacency(indices, indexCount, vertexCount);
+
+        std::vector<uint32_t> liveTriangles = adjacency.counts;
+        std::vector<uint32_t> cachedAt(vertexCount, 0);
+        std::vector<uint8_t> emitted(triangleCount, 0);
+        std::vector<uint32_t> deadEnds;
+        std::vector<uint32_t> candidates;
+        deadEnds.reserve(indexCount);
+
+        uint32_t timestamp = cacheSize + 1;
+        size_t inputCursor = 0;
+        size_t outputCount = 0;
+
+        // Fallback when no candidate is worth fanning around: the most recent vertex with triangles left, then the input order
+        auto skipDeadEnd = [&]() -> uint32_t
+        {
+            while (!deadEnds.empty())
+            {
+                uint32_t vertex = deadEnds.back();
+                deadEnds.pop_back();
+
+                if (liveTriangles[vertex] > 0)
+                    return vertex;
+            }
+
+            while (inputCursor < indexCount)
+            {
+                uint32_t vertex = indices[inputCursor++];
+
+                if (liveTriangles[vertex] > 0)
+                    return vertex;
+            }
+
+            return NO_VERTEX;
+        };
+
+        uint32_t fanVertex = indices[0];
+        while (fanVertex != NO_VERTEX)
+        {
+            candidates.clear();
+
+            // Emit every remaining triangle around the fanning vertex
+            uint32_t begin = adjacency.offsets[fanVertex];
+            uint32_t end = begin + adjacency.counts[fanVertex];
+            for (uint32_t k = begin; k < end; ++k)
+            {
+                uint32_t triangle = adjacency.triangles[k];
+                if (emitted[triangle])
+                    continue;
+
+                for (uint32_t j = 0; j < 3; ++j)
+                {
+                    uint32_t vertex = indices[triangle * 3 + j];
+
+                    destination[outputCount++] = vertex;
+                    deadEnds.push_back(vertex);
+                    candidates.push_back(vertex);
+                    liveTriangles[vertex]--;
+
+                    if (timestamp - cachedAt[vertex] > cacheSize)
+                    {
+                        cachedAt[vertex] = timestamp++;
+                    }
+                }
+
+                emitted[triangle] = 1;
+            }
+
+            // Next fan: the oldest candidate that still is in the cache after its remaining triangles are emitted
+            uint32_t best = NO_VERTEX;
+            uint32_t bestPriority = 0;
+            for (uint32_t vertex : candidates)
+            {
+                if (liveTriangles[vertex] == 0)
+                    continue;
+
+                uint32_t age = timestamp - cachedAt[vertex];
+                uint32_t priority = (age + 2 * liveTriangles[vertex] <= cacheSize) ? age : 0;
+
+                if (priority > bestPriority)
+                {
+                    bestPriority = priority;
+                    best = vertex;
+                }
+            }
+
+            fanVertex = best != NO_VERTEX ? best : skipDeadEnd();
+        }
+
+        assert(outputCount == indexCount && "Every triangle has to be emitted once!");
+    }
+
+    void optimizeOverdraw(uint32_t *destination, const uint32_t *indices, size_t indexCount,
+                          const float *positions, size_t vertexCount, size_t vertexStride,
+                          float threshold, uint32_t cacheSize)
+    {
+        assert(indexCount % 3 == 0 && "Index count has to be a multiple of 3!");
+        assert(destination != indices && "optimizeOverdraw can't work in place!");
+
+        uint32_t triangleCount = static_cast<uint32_t>(indexCount / 3);
+        if (triangleCount == 0)
+            return;
+
+        auto position = [&](uint32_t vertex)
+        {
+            const float *p = reinterpret_cast<const float *>(reinterpret_cast<const char *>(positions) + vertex * vertexStride);
+            return glm::vec3(p[0], p[1], p[2]);
+        };
+
+        FifoCache cache(vertexCount, cacheSize);
+
+        // Hard boundaries: triangles missing all three vertices, where the cache optimizer had to restart
+        std::vector<uint32_t> hardClusters;
+        for (uint32_t t = 0; t < triangleCount; ++t)
+        {
+            if (cache.accessTriangle(indices + t * 3) == 3 || t == 0)
+            {
+                hardClusters.push_back(t);
+            }
+        }
+
+        // Soft boundaries: split hard clusters wherever the part so far already amortized its cache misses
+        std::vector<uint32_t> clusters;
+        for (size_t h = 0; h < hardClusters.size(); ++h)
+        {
+            uint32_t start = hardClusters[h];
+            uint32_t end = h + 1 < hardClusters.size() ? hardClusters[h + 1] : triangleCount;
+
+            cache.flush();
+            uint32_t hardMisses = 0;
+            for (uint32_t t = start; t < end; ++t)
+            {
+                hardMisses += cache.accessTriangle(indices + t * 3);
+            }
+            float targetAcmr = threshold * float(hardMisses) / float(end - start);
+
+            cache.flush();
+            clusters.push_back(start);
+
+            uint32_t clusterMisses = 0;
+            uint32_t clusterTriangles = 0;
+            for (uint32_t t = start; t < end; ++t)
+            {
+                clusterMisses += cache.accessTriangle(indices + t * 3);
+                clusterTriangles++;
+
+                if (t + 1 < end && float(clusterMisses) / float(clusterTriangles) <= targetAcmr)
+                {
+                    clusters.push_back(t + 1);
+                    cache.flush();
+                    clusterMisses = 0;
+                    clusterTriangles = 0;
+                }
+            }
+        }
+
+        // Area weighted centroid and normal of every cluster
+        std::vector<glm::vec3> clusterCentroids(clusters.size(), glm::vec3(0.f));
+        std::vector<glm::vec3> clusterNormals(clusters.size(), glm::vec3(0.f));
+        glm::vec3 meshCentroid{0.f};
+        float meshArea = 0.f;
+
+        for (size_t c = 0; c < clusters.size(); ++c)
+        {
+            uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+            float clusterArea = 0.f;
+
+            for (uint32_t t = clusters[c]; t < end; ++t)
+            {
+                glm::vec3 p0 = position(indices[t * 3 + 0]);
+                glm::vec3 p1 = position(indices[t * 3 + 1]);
+                glm::vec3 p2 = position(indices[t * 3 + 2]);
+
+                glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                float area = glm::length(normal);
+
+                clusterCentroids[c] += (p0 + p1 + p2) * (area / 3.f);
+                clusterNormals[c] += normal;
+                clusterArea += area;
+            }
+
+            meshCentroid += clusterCentroids[c];
+            meshArea += clusterArea;
+
+            if (clusterArea > 0.f)
+            {
+                clusterCentroids[c] /= clusterArea;
+            }
+        }
+
+        if (meshArea > 0.f)
+        {
+            meshCentroid /= meshArea;
+        }
+
+        // Clusters facing away from the center are the outside of the mesh and get drawn first
+        std::vector<float> sortKeys(clusters.size(), 0.f);
+        for (size_t c = 0; c < clusters.size(); ++c)
+        {
+            float normalLength = glm::length(clusterNormals[c]);
+            if (normalLength > 0.f)
+            {
+                sortKeys[c] = glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c] / normalLength);
+            }
+        }
+
+        std::vector<uint32_t> order(clusters.size());
+        for (uint32_t c = 0; c < order.size(); ++c)
+        {
+            order[c] = c;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+                         { return sortKeys[a] > sortKeys[b]; });
+
+        size_t outputCount = 0;
+        for (uint32_t c : order)
+        {
+            uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+            size_t count = (end - clusters[c]) * 3;
+
+            std::memcpy(destination + outputCount, indices + clusters[c] * 3, count * sizeof(uint32_t));
+            outputCount += count;
+        }
+
+        assert(outputCount == indexCount && "Every triangle has to be emitted once!");
+    }
+
+    size_t simplify(uint32_t *destination, const uint32_t *indices, size_t indexCount,
+                    const float *positions, size_t vertexCount, size_t vertexStride,
+                    size_t targetIndexCount, float maxError, float *resultError)
+    {
+        assert(indexCount % 3 == 0 && "Index count has to be a multiple of 3!");
+
+        auto position = [&](uint32_t vertex)
+        {
+            const float *p = reinterpret_cast<const float *>(reinterpret_cast<const char *>(positions) + vertex * vertexStride);
+            return glm::vec3(p[0], p[1], p[2]);
+        };
+
+        std::vector<uint32_t> result(indices, indices + indexCount);
+
+        // Edges used by one triangle are borders, edges used by more are non manifold, their vertices can't move.
+        // Seams split by the importer show up as borders too, so they stay intact.
+        std::vector<uint8_t> locked(vertexCount, 0);
+        {
+            std::unordered_map<uint64_t, uint32_t> edgeUses;
+            edgeUses.reserve(indexCount);
+            for (size_t i = 0; i < indexCount; i += 3)
+            {
+                for (uint32_t e = 0; e < 3; ++e)
+                {
+                    edgeUses[edgeKey(result[i + e], result[i + (e + 1) % 3])]++;
+                }
+            }
+
+            for (auto &[key, uses] : edgeUses)
+            {
+                if (uses != 2)
+                {
+                    locked[uint32_t(key >> 32)] = 1;
+                    locked[uint32_t(key)] = 1;
+                }
+            }
+        }
+
+        std::vector<Quadric> quadrics(vertexCount);
+        for (size_t i = 0; i < indexCount; i += 3)
+        {
+            glm::vec3 p0 = position(result[i]);
+            glm::vec3 normal = glm::cross(position(result[i + 1]) - p0, position(result[i + 2]) - p0);
+            float length = glm::length(normal);
+            if (length == 0.f)
+                continue;
+
+            normal /= length;
+            Quadric q = Quadric::fromPlane(normal, -glm::dot(normal, p0), length * 0.5f);
+
+            for (uint32_t j = 0; j < 3; ++j)
+            {
+                quadrics[result[i + j]] += q;
+            }
+        }
+
+        double maxCost = double(maxError) * maxError;
+        double largestCost = 0;
+
+        std::vector<uint64_t> edges;
+        std::vector<Collapse> collapses;
+        std::vector<uint32_t> remap(vertexCount);
+        std::vector<uint8_t> touched(vertexCount);
+        std::vector<uint32_t> triangleCounts(vertexCount), triangleOffsets(vertexCount), vertexTriangles;
+
+        while (result.size() > targetIndexCount)
+        {
+            // Cheapest direction of every edge
+            edges.clear();
+            for (size_t i = 0; i < result.size(); i += 3)
+            {
+                for (uint32_t e = 0; e < 3; ++e)
+                {
+                    edges.push_back(edgeKey(result[i + e], result[i + (e + 1) % 3]));
+                }
+            }
+            std::sort(edges.begin(), edges.end());
+            edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+            collapses.clear();
+            for (uint64_t edge : edges)
+            {
+                uint32_t a = uint32_t(edge >> 32);
+                uint32_t b = uint32_t(edge);
+
+                Quadric q = quadrics[a];
+                q += quadrics[b];
+
+                double costAB = locked[a] ? HUGE_VAL : q.error(position(b));
+                double costBA = locked[b] ? HUGE_VAL : q.error(position(a));
+
+                if (costAB == HUGE_VAL && costBA == HUGE_VAL)
+                    continue;
+
+                collapses.push_back(costAB <= costBA ? Collapse{a, b, costAB} : Collapse{b, a, costBA});
+            }
+
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse &l, const Collapse &r)
+                      { return l.cost < r.cost; });
+
+            // Triangles around every vertex, for the flip test
+            std::fill(triangleCounts.begin(), triangleCounts.end(), 0);
+            for (uint32_t index : result)
+            {
+                triangleCounts[index]++;
+            }
+            uint32_t offset = 0;
+            for (size_t v = 0; v < vertexCount; ++v)
+            {
+                triangleOffsets[v] = offset;
+                offset += triangleCounts[v];
+            }
+            vertexTriangles.resize(result.size());
+            std::vector<uint32_t> fill = triangleOffsets;
+            for (size_t i = 0; i < result.size(); ++i)
+            {
+                vertexTriangles[fill[result[i]]++] = uint32_t(i / 3);
+            }
+
+            for (size_t v = 0; v < vertexCount; ++v)
+            {
+                remap[v] = uint32_t(v);
+            }
+            std::fill(touched.begin(), touched.end(), 0);
+
+            // Every collapse removes about two triangles, stop once the target is reached
+            size_t trianglesToRemove = (result.size() - targetIndexCount) / 3;
+            size_t trianglesRemoved = 0;
+            bool collapsed = false;
+
+            for (const Collapse &collapse : collapses)
+            {
+                if (collapse.cost > maxCost || trianglesRemoved >= trianglesToRemove)
+                    break;
+
+                if (touched[collapse.source] || touched[collapse.target])
+                    continue;
+
+                // Moving the source onto the target must not turn any remaining triangle over
+                glm::vec3 targetPosition = position(collapse.target);
+                bool flips = false;
+                size_t removed = 0;
+
+                uint32_t begin = triangleOffsets[collapse.source];
+                uint32_t end = begin + triangleCounts[collapse.source];
+                for (uint32_t k = begin; k < end && !flips; ++k)
+                {
+                    const uint32_t *triangle = &result[vertexTriangles[k] * 3];
+                    if (triangle[0] == collapse.target || triangle[1] == collapse.target || triangle[2] == collapse.target)
+                    {
+                        removed++;
+                        continue;
+                    }
+
+                    glm::vec3 p[3], moved[3];
+                    for (uint32_t j = 0; j < 3; ++j)
+                    {
+                        p[j] = position(triangle[j]);
+                        moved[j] = triangle[j] == collapse.source ? targetPosition : p[j];
+                    }
+
+                    glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                    glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+                    flips = glm::dot(before, after) <= 0.f;
+                }
+
+                if (flips)
+                    continue;
+
+                // Neighbouring collapses in the same pass would invalidate the flip test
+                for (uint32_t k = begin; k < end; ++k)
+                {
+                    const uint32_t *triangle = &result[vertexTriangles[k] * 3];
+                    touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+                }
+
+                remap[collapse.source] = collapse.target;
+                quadrics[collapse.target] += quadrics[collapse.source];
+                largestCost = std::max(largestCost, collapse.cost);
+                trianglesRemoved += removed;
+                collapsed = true;
+            }
+
+            if (!collapsed)
+                break;
+
+            size_t write = 0;
+            for (size_t i = 0; i < result.size(); i += 3)
+            {
+                uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+                if (a == b || b == c || a == c)
+                    continue;
+
+                result[write++] = a;
+                result[write++] = b;
+                result[write++] = c;
+            }
+            result.resize(write);
+        }
+
+        std::memcpy(destination, result.data(), result.size() * sizeof(uint32_t));
+
+        if (resultError)
+        {
+            *resultError = float(std::sqrt(largestCost));
+        }
+
+        return result.size();
+    }
+
+    size_t optimizeVertexFetch(void *destination, uint32_t *indices, size_t indexCount,
+                               const void *vertices, size_t vertexCount, size_t vertexSize)
+    {
+        assert(destination != vertices && "optimizeVertexFetch can't work in place!");
+
+        std::vector<uint32_t> remap(vertexCount, NO_VERTEX);
+        uint32_t nextVertex = 0;
+
+        char *out = static_cast<char *>(destination);
+        const char *in = static_cast<const char *>(vertices);
+
+        for (size_t i = 0; i < indexCount; ++i)
+        {
+            uint32_t vertex = indices[i];
+
+            if (remap[vertex] == NO_VERTEX)
+            {
+                remap[vertex] = nextVertex;
+                std::memcpy(out + size_t(nextVertex) * vertexSize, in + size_t(vertex) * vertexSize, vertexSize);
+                nextVertex++;
+            }
+
+            indices[i] = remap[vertex];
+        }
+
+        return nextVertex;
+    }
+
+    std::vector<Meshlet> buildMeshlets(const uint32_t *indices, size_t indexCount,
+                                       const float *positions, const float *normals, size_t vertexCount, size_t vertexStride,
+                                       uint32_t maxVertices, uint32_t maxTriangles)
+    {
+        assert(indexCount % 3 == 0 && "Index count has to be a multiple of 3!");
+        assert(maxVertices >= 3 && maxTriangles >= 1 && "A meshlet has to fit a triangle!");
+
+        auto attribute = [&](const float *base, uint32_t vertex)
+        {
+            const float *p = reinterpret_cast<const float *>(reinterpret_cast<const char *>(base) + vertex * vertexStride);
+            return glm::vec3(p[0], p[1], p[2]);
+        };
+
+        std::vector<Meshlet> meshlets;
+        std::vector<uint32_t> meshletOf(vertexCount, NO_VERTEX);
+        std::vector<uint32_t> meshletVertices;
+        std::vector<glm::vec3> faceNormals;
+
+        auto finish = [&](uint32_t firstIndex, uint32_t lastIndex)
+        {
+            Meshlet meshlet{};
+            meshlet.firstIndex = firstIndex;
+            meshlet.indexCount = lastIndex - firstIndex;
+
+            glm::vec3 min = attribute(positions, meshletVertices[0]);
+            glm::vec3 max = min;
+            for (uint32_t vertex : meshletVertices)
+            {
+                min = glm::min(min, attribute(positions, vertex));
+                max = glm::max(max, attribute(positions, vertex));
+            }
+
+            glm::vec3 center = (min + max) * 0.5f;
+            float radius = 0.f;
+            for (uint32_t vertex : meshletVertices)
+            {
+                radius = std::max(radius, glm::length(attribute(positions, vertex) - center));
+            }
+
+            // Face normals turned to the side the vertex normals point to, degenerate triangles don't count
+            faceNormals.clear();
+            glm::vec3 axis{0.f};
+            for (uint32_t i = firstIndex; i < lastIndex; i += 3)
+            {
+                glm::vec3 p0 = attribute(positions, indices[i]);
+                glm::vec3 normal = glm::cross(attribute(positions, indices[i + 1]) - p0, attribute(positions, indices[i + 2]) - p0);
+                float length = glm::length(normal);
+                if (length == 0.f)
+                    continue;
+
+                normal /= length;
+                glm::vec3 shading = attribute(normals, indices[i]) + attribute(normals, indices[i + 1]) + attribute(normals, indices[i + 2]);
+                if (glm::dot(normal, shading) < 0.f)
+                {
+                    normal = -normal;
+                }
+
+                faceNormals.push_back(normal);
+                axis += normal;
+            }
+
+            float cutoff = -1.f;
+            float axisLength = glm::length(axis);
+            if (axisLength > 0.f)
+            {
+                axis /= axisLength;
+                cutoff = 1.f;
+                for (const glm::vec3 &normal : faceNormals)
+                {
+                    cutoff = std::min(cutoff, glm::dot(axis, normal));
+                }
+                if (cutoff <= 0.f)
+                {
+                    cutoff = -1.f;
+                }
+            }
+
+            std::memcpy(meshlet.center, &center.x, sizeof(meshlet.center));
+            meshlet.radius = radius;
+            std::memcpy(meshlet.coneAxis, &axis.x, sizeof(meshlet.coneAxis));
+            meshlet.coneCutoff = cutoff;
+
+            meshlets.push_back(meshlet);
+        };
+
+        uint32_t firstIndex = 0;
+        uint32_t triangleCount = 0;
+        for (uint32_t i = 0; i < indexCount; i += 3)
+        {
+            uint32_t id = static_cast<uint32_t>(meshlets.size());
+
+            uint32_t newVertices = 0;
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                // Counts a vertex repeated within the triangle once
+                if (meshletOf[indices[i + k]] != id && (k == 0 || indices[i + k] != indices[i]) && (k < 2 || indices[i + 2] != indices[i + 1]))
+                {
+                    newVertices++;
+                }
+            }
+
+            if (triangleCount == maxTriangles || meshletVertices.size() + newVertices > maxVertices)
+            {
+                finish(firstIndex, i);
+                firstIndex = i;
+                triangleCount = 0;
+                meshletVertices.clear();
+                id++;
+            }
+
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                if (meshletOf[indices[i + k]] != id)
+                {
+                    meshletOf[indices[i + k]] = id;
+                    meshletVertices.push_back(indices[i + k]);
+                }
+            }
+            triangleCount++;
+        }
+
+        if (triangleCount > 0)
+        {
+            finish(firstIndex, static_cast<uint32_t>(indexCount));
+        }
+
+        return meshlets;
+    }
+}
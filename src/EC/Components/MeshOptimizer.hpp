@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Post import passes over triangle lists. They run in this order:
+// vertex cache reordering, overdraw clustering on top of it, LOD simplification,
+// then vertex fetch reordering of the final index order. Meshlets are built last from the final indices.
+namespace GWIN::MeshOptimizer
+{
+    // Cache size the passes optimize for and the statistics are simulated with
+    constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+    // Meshlet limits of the common mesh shader sizes, so the clusters stay small enough to cull one by one
+    constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+    constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+    // Transform counts of a FIFO post transform cache, adds up over meshes so a whole file can be reported
+    struct VertexCacheStats
+    {
+        size_t triangles{0};
+        size_t vertices{0};
+        size_t transforms{0};
+
+        // Average cache miss ratio, transformed vertices per triangle (0.5 is ideal, 3 is worst)
+        float acmr() const { return triangles ? float(transforms) / float(triangles) : 0.f; }
+        // Average transform to vertex ratio (1 is ideal)
+        float atvr() const { return vertices ? float(transforms) / float(vertices) : 0.f; }
+
+        VertexCacheStats &operator+=(const VertexCacheStats &other)
+        {
+            triangles += other.triangles;
+            vertices += other.vertices;
+            transforms += other.transforms;
+            return *this;
+        }
+    };
+
+    // Contiguous range of triangles with the sphere around them and the cone around their normals.
+    // Every triangle faces away from a viewer when the angle between coneAxis and the view direction is
+    // below 90 degrees minus the cone angle, coneCutoff is the cosine of that angle or negative when it is 90 or more.
+    struct Meshlet
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float center[3];
+        float radius;
+        float coneAxis[3];
+        float coneCutoff;
+    };
+
+    VertexCacheStats analyzeVertexCache(const uint32_t *indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+    // Tipsify (Sander et al. 2007), destination must not alias indices
+    void optimizeVertexCache(uint32_t *destination, const uint32_t *indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+    // Splits cache optimized triangles into clusters wherever that keeps the ACMR within threshold of the input,
+    // then orders the clusters so the ones facing away from the mesh center come first and occlude the rest.
+    // positions points at the first position (3 floats), vertexStride is the distance between vertices in bytes.
+    void optimizeOverdraw(uint32_t *destination, const uint32_t *indices, size_t indexCount,
+                          const float *positions, size_t vertexCount, size_t vertexStride,
+                          float threshold = 1.05f, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+    // Quadric error edge collapse towards targetIndexCount, always collapsing onto existing vertices so the
+    // result indexes the same vertex buffer. Border and seam vertices stay in place.
+    // Stops early when no collapse costs less than maxError (a local space distance).
+    // Returns the new index count and writes the largest collapse error to resultError.
+    size_t simplify(uint32_t *destination, const uint32_t *indices, size_t indexCount,
+                    const float *positions, size_t vertexCount, size_t vertexStride,
+                    size_t targetIndexCount, float maxError, float *resultError = nullptr);
+
+    // Reorders vertices by first use and remaps indices in place, vertices no index refers to are dropped.
+    // Returns the new vertex count, destination must not alias vertices.
+    size_t optimizeVertexFetch(void *destination, uint32_t *indices, size_t indexCount,
+                               const void *vertices, size_t vertexCount, size_t vertexSize);
+
+    // Splits the triangles in their current order into meshlets of at most maxVertices unique vertices and
+    // maxTriangles triangles, so the cache order is kept and every meshlet is a plain index range.
+    // The normals orient the cone, which keeps it independent of the winding order.
+    std::vector<Meshlet> buildMeshlets(const uint32_t *indices, size_t indexCount,
+                                       const float *positions, const float *normals, size_t vertexCount, size_t vertexStride,
+                                       uint32_t maxVertices = MESHLET_MAX_VERTICES, uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+}
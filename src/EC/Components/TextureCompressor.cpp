@@ -0,0 +1,482 @@
+#include "TextureCompressor.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace GWIN::TextureCompressor
+{
+    namespace
+    {
+        // Interpolation weights of 4 bit BC7 indices, out of 64
+        constexpr uint32_t BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+        float srgbToLinear(float value)
+        {
+            return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+        }
+
+        float linearToSrgb(float value)
+        {
+            return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+        }
+
+        uint8_t toByte(float value)
+        {
+            return static_cast<uint8_t>(std::clamp(value, 0.f, 255.f) + 0.5f);
+        }
+
+        // Mean and dominant direction of the texels, the endpoints are picked along that line
+        template <int N>
+        void principalAxis(const float (&points)[16][N], float (&mean)[N], float (&axis)[N])
+        {
+            for (int c = 0; c < N; ++c)
+            {
+                mean[c] = 0.f;
+                for (int i = 0; i < 16; ++i)
+                    mean[c] += points[i][c];
+                mean[c] /= 16.f;
+            }
+
+            float covariance[N][N] = {};
+            for (int i = 0; i < 16; ++i)
+            {
+                for (int a = 0; a < N; ++a)
+                    for (int b = 0; b < N; ++b)
+                        covariance[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+            }
+
+            for (int c = 0; c < N; ++c)
+                axis[c] = 1.f;
+
+            // Power iteration, a handful of steps is plenty for 16 points
+            for (int iteration = 0; iteration < 8; ++iteration)
+            {
+                float next[N] = {};
+                for (int a = 0; a < N; ++a)
+                    for (int b = 0; b < N; ++b)
+                        next[a] += covariance[a][b] * axis[b];
+
+                float length = 0.f;
+                for (int c = 0; c < N; ++c)
+                    length += next[c] * next[c];
+                length = std::sqrt(length);
+
+                if (length < 1e-6f)
+                {
+                    for (int c = 0; c < N; ++c)
+                        axis[c] = 0.f;
+                    return;
+                }
+
+                for (int c = 0; c < N; ++c)
+                    axis[c] = next[c] / length;
+            }
+        }
+
+        // Ends of the texels' extent along the principal axis
+        template <int N>
+        void fitEndpoints(const float (&points)[16][N], float (&low)[N], float (&high)[N])
+        {
+            float mean[N];
+            float axis[N];
+            principalAxis(points, mean, axis);
+
+            float minimum = 0.f;
+            float maximum = 0.f;
+            for (int i = 0; i < 16; ++i)
+            {
+                float t = 0.f;
+                for (int c = 0; c < N; ++c)
+                    t += (points[i][c] - mean[c]) * axis[c];
+                minimum = std::min(minimum, t);
+                maximum = std::max(maximum, t);
+            }
+
+            for (int c = 0; c < N; ++c)
+            {
+                low[c] = std::clamp(mean[c] + axis[c] * minimum, 0.f, 255.f);
+                high[c] = std::clamp(mean[c] + axis[c] * maximum, 0.f, 255.f);
+            }
+        }
+
+        uint16_t packRgb565(const float (&color)[3])
+        {
+            uint32_t r = static_cast<uint32_t>(color[0] * 31.f / 255.f + 0.5f);
+            uint32_t g = static_cast<uint32_t>(color[1] * 63.f / 255.f + 0.5f);
+            uint32_t b = static_cast<uint32_t>(color[2] * 31.f / 255.f + 0.5f);
+            return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+        }
+
+        void unpackRgb565(uint16_t packed, int (&color)[3])
+        {
+            int r = (packed >> 11) & 31;
+            int g = (packed >> 5) & 63;
+            int b = packed & 31;
+            color[0] = (r << 3) | (r >> 2);
+            color[1] = (g << 2) | (g >> 4);
+            color[2] = (b << 3) | (b >> 2);
+        }
+
+        // One BC4 block, the 8 value mode with the maximum first
+        void encodeBC4(uint8_t destination[8], const uint8_t (&values)[16])
+        {
+            uint8_t high = *std::max_element(values, values + 16);
+            uint8_t low = *std::min_element(values, values + 16);
+
+            destination[0] = high;
+            destination[1] = low;
+
+            int palette[8] = {high, low};
+            for (int i = 2; i < 8; ++i)
+            {
+                palette[i] = ((8 - i) * high + (i - 1) * low + 3) / 7;
+            }
+
+            uint64_t bits = 0;
+            if (high != low)
+            {
+                for (int i = 0; i < 16; ++i)
+                {
+                    uint64_t best = 0;
+                    int bestError = 256;
+                    for (int index = 0; index < 8; ++index)
+                    {
+                        int error = std::abs(palette[index] - values[i]);
+                        if (error < bestError)
+                        {
+                            bestError = error;
+                            best = index;
+                        }
+                    }
+                    bits |= best << (3 * i);
+                }
+            }
+
+            for (int i = 0; i < 6; ++i)
+            {
+                destination[2 + i] = static_cast<uint8_t>(bits >> (8 * i));
+            }
+        }
+
+        // Writes a 128 bit block from its lowest bit up
+        struct BitWriter
+        {
+            uint8_t *destination;
+            uint32_t position{0};
+
+            void write(uint32_t value, uint32_t count)
+            {
+                for (uint32_t i = 0; i < count; ++i, ++position)
+                {
+                    if (value & (1u << i))
+                        destination[position / 8] |= static_cast<uint8_t>(1u << (position % 8));
+                }
+            }
+        };
+
+        // 7 bit endpoint with the parity bit that reproduces the color best, both shared by all channels
+        void quantizeBC7Endpoint(const float (&color)[4], uint32_t (&quantized)[4], uint32_t &parity)
+        {
+            float bestError = 0.f;
+            for (uint32_t p = 0; p < 2; ++p)
+            {
+                uint32_t candidate[4];
+                float error = 0.f;
+                for (int c = 0; c < 4; ++c)
+                {
+                    float value = std::clamp((color[c] - float(p)) * 0.5f + 0.5f, 0.f, 127.f);
+                    candidate[c] = static_cast<uint32_t>(value);
+                    float difference = float((candidate[c] << 1) | p) - color[c];
+                    error += difference * difference;
+                }
+
+                if (p == 0 || error < bestError)
+                {
+                    bestError = error;
+                    parity = p;
+                    std::memcpy(quantized, candidate, sizeof(candidate));
+                }
+            }
+        }
+
+        void gatherBlock(uint8_t (&texels)[64], const Level &level, uint32_t blockX, uint32_t blockY)
+        {
+            for (uint32_t y = 0; y < 4; ++y)
+            {
+                uint32_t sourceY = std::min(blockY * 4 + y, level.height - 1);
+                for (uint32_t x = 0; x < 4; ++x)
+                {
+                    uint32_t sourceX = std::min(blockX * 4 + x, level.width - 1);
+                    std::memcpy(&texels[(y * 4 + x) * 4], &level.rgba[(size_t(sourceY) * level.width + sourceX) * 4], 4);
+                }
+            }
+        }
+    }
+
+    size_t blockBytes(BlockFormat format)
+    {
+        return format == BlockFormat::BC1 ? 8 : 16;
+    }
+
+    size_t compressedSize(BlockFormat format, uint32_t width, uint32_t height)
+    {
+        return size_t((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+    }
+
+    Level downsample(const Level &level, MipFilter filter)
+    {
+        Level next{};
+        next.width = std::max(1u, level.width / 2);
+        next.height = std::max(1u, level.height / 2);
+        next.rgba.resize(size_t(next.width) * next.height * 4);
+
+        std::array<float, 256> linear{};
+        if (filter == MipFilter::Srgb)
+        {
+            for (int i = 0; i < 256; ++i)
+                linear[i] = srgbToLinear(i / 255.f);
+        }
+
+        for (uint32_t y = 0; y < next.height; ++y)
+        {
+            for (uint32_t x = 0; x < next.width; ++x)
+            {
+                const uint8_t *texels[4];
+                for (uint32_t i = 0; i < 4; ++i)
+                {
+                    uint32_t sourceX = std::min(x * 2 + (i & 1), level.width - 1);
+                    uint32_t sourceY = std::min(y * 2 + (i >> 1), level.height - 1);
+                    texels[i] = &level.rgba[(size_t(sourceY) * level.width + sourceX) * 4];
+                }
+
+                uint8_t *destination = &next.rgba[(size_t(y) * next.width + x) * 4];
+                destination[3] = static_cast<uint8_t>((texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+
+                if (filter == MipFilter::Linear)
+                {
+                    for (int c = 0; c < 3; ++c)
+                        destination[c] = static_cast<uint8_t>((texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+                }
+                else if (filter == MipFilter::Srgb)
+                {
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        float average = (linear[texels[0][c]] + linear[texels[1][c]] + linear[texels[2][c]] + linear[texels[3][c]]) * 0.25f;
+                        destination[c] = toByte(linearToSrgb(average) * 255.f);
+                    }
+                }
+                else
+                {
+                    float normal[3] = {};
+                    for (uint32_t i = 0; i < 4; ++i)
+                        for (int c = 0; c < 3; ++c)
+                            normal[c] += texels[i][c] / 127.5f - 1.f;
+
+                    float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        float value = length > 1e-6f ? normal[c] / length : (c == 2 ? 1.f : 0.f);
+                        destination[c] = toByte((value + 1.f) * 127.5f);
+                    }
+                }
+            }
+        }
+
+        return next;
+    }
+
+    std::vector<Level> buildMipChain(Level base, MipFilter filter)
+    {
+        std::vector<Level> levels;
+        levels.push_back(std::move(base));
+
+        while (levels.back().width > 1 || levels.back().height > 1)
+        {
+            levels.push_back(downsample(levels.back(), filter));
+        }
+
+        return levels;
+    }
+
+    void compress(uint8_t *destination, const Level &level, BlockFormat format)
+    {
+        uint32_t blocksX = (level.width + 3) / 4;
+        uint32_t blocksY = (level.height + 3) / 4;
+        size_t bytes = blockBytes(format);
+
+        uint8_t texels[64];
+        for (uint32_t blockY = 0; blockY < blocksY; ++blockY)
+        {
+            for (uint32_t blockX = 0; blockX < blocksX; ++blockX)
+            {
+                gatherBlock(texels, level, blockX, blockY);
+
+                switch (format)
+                {
+                case BlockFormat::BC1:
+                    encodeBC1(destination, texels);
+                    break;
+                case BlockFormat::BC5:
+                    encodeBC5(destination, texels);
+                    break;
+                case BlockFormat::BC7:
+                    encodeBC7(destination, texels);
+                    break;
+                }
+
+                destination += bytes;
+            }
+        }
+    }
+
+    void encodeBC1(uint8_t destination[8], const uint8_t texels[64])
+    {
+        float points[16][3];
+        for (int i = 0; i < 16; ++i)
+            for (int c = 0; c < 3; ++c)
+                points[i][c] = texels[i * 4 + c];
+
+        float low[3];
+        float high[3];
+        fitEndpoints(points, low, high);
+
+        uint16_t color0 = packRgb565(high);
+        uint16_t color1 = packRgb565(low);
+
+        // color0 > color1 selects the four color mode, equal endpoints need no indices
+        if (color0 < color1)
+            std::swap(color0, color1);
+
+        uint32_t indices = 0;
+        if (color0 != color1)
+        {
+            int palette[4][3];
+            unpackRgb565(color0, palette[0]);
+            unpackRgb565(color1, palette[1]);
+            for (int c = 0; c < 3; ++c)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+
+            for (int i = 0; i < 16; ++i)
+            {
+                uint32_t best = 0;
+                int bestError = INT32_MAX;
+                for (uint32_t index = 0; index < 4; ++index)
+                {
+                    int error = 0;
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        int difference = palette[index][c] - texels[i * 4 + c];
+                        error += difference * difference;
+                    }
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        best = index;
+                    }
+                }
+                indices |= best << (2 * i);
+            }
+        }
+
+        destination[0] = static_cast<uint8_t>(color0);
+        destination[1] = static_cast<uint8_t>(color0 >> 8);
+        destination[2] = static_cast<uint8_t>(color1);
+        destination[3] = static_cast<uint8_t>(color1 >> 8);
+        for (int i = 0; i < 4; ++i)
+        {
+            destination[4 + i] = static_cast<uint8_t>(indices >> (8 * i));
+        }
+    }
+
+    void encodeBC5(uint8_t destination[16], const uint8_t texels[64])
+    {
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            uint8_t values[16];
+            for (int i = 0; i < 16; ++i)
+                values[i] = texels[i * 4 + channel];
+
+            encodeBC4(destination + channel * 8, values);
+        }
+    }
+
+    void encodeBC7(uint8_t destination[16], const uint8_t texels[64])
+    {
+        float points[16][4];
+        for (int i = 0; i < 16; ++i)
+            for (int c = 0; c < 4; ++c)
+                points[i][c] = texels[i * 4 + c];
+
+        float low[4];
+        float high[4];
+        fitEndpoints(points, low, high);
+
+        uint32_t endpoints[2][4];
+        uint32_t parity[2];
+        quantizeBC7Endpoint(low, endpoints[0], parity[0]);
+        quantizeBC7Endpoint(high, endpoints[1], parity[1]);
+
+        int palette[16][4];
+        for (int index = 0; index < 16; ++index)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                uint32_t e0 = (endpoints[0][c] << 1) | parity[0];
+                uint32_t e1 = (endpoints[1][c] << 1) | parity[1];
+                palette[index][c] = static_cast<int>(((64 - BC7_WEIGHTS[index]) * e0 + BC7_WEIGHTS[index] * e1 + 32) >> 6);
+            }
+        }
+
+        uint32_t indices[16];
+        for (int i = 0; i < 16; ++i)
+        {
+            int bestError = INT32_MAX;
+            for (uint32_t index = 0; index < 16; ++index)
+            {
+                int error = 0;
+                for (int c = 0; c < 4; ++c)
+                {
+                    int difference = palette[index][c] - texels[i * 4 + c];
+                    error += difference * difference;
+                }
+                if (error < bestError)
+                {
+                    bestError = error;
+                    indices[i] = index;
+                }
+            }
+        }
+
+        // The first index drops its top bit, so it has to point at the first half of the palette
+        if (indices[0] & 8)
+        {
+            std::swap(endpoints[0], endpoints[1]);
+            std::swap(parity[0], parity[1]);
+            for (uint32_t &index : indices)
+                index = 15 - index;
+        }
+
+        std::memset(destination, 0, 16);
+        BitWriter writer{destination};
+        writer.write(1u << 6, 7); // mode 6
+
+        for (int c = 0; c < 4; ++c)
+        {
+            writer.write(endpoints[0][c], 7);
+            writer.write(endpoints[1][c], 7);
+        }
+        writer.write(parity[0], 1);
+        writer.write(parity[1], 1);
+
+        writer.write(indices[0], 3);
+        for (int i = 1; i < 16; ++i)
+        {
+            writer.write(indices[i], 4);
+        }
+    }
+}
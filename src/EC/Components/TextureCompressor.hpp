@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// CPU side of texture cooking: mip chains of RGBA8 images and block compression of each level.
+// Images that are not a multiple of 4 repeat their last row and column to fill the edge blocks.
+namespace GWIN::TextureCompressor
+{
+    enum class BlockFormat
+    {
+        BC1, // RGB, 8 bytes per block, 4 bits per texel
+        BC5, // two independent channels (normal map x and y), 16 bytes per block
+        BC7, // RGBA, 16 bytes per block, mode 6 only
+    };
+
+    // How the texels of a level are averaged into the next one
+    enum class MipFilter
+    {
+        Linear,
+        Srgb,   // color channels averaged in linear space, alpha as is
+        Normal, // xyz decoded from [0, 1] to [-1, 1], averaged and normalized again
+    };
+
+    struct Level
+    {
+        uint32_t width{0};
+        uint32_t height{0};
+        std::vector<uint8_t> rgba;
+    };
+
+    size_t blockBytes(BlockFormat format);
+    // Bytes of a width x height level once compressed
+    size_t compressedSize(BlockFormat format, uint32_t width, uint32_t height);
+
+    // Next level down with a 2x2 box filter, odd sizes reuse the last row or column
+    Level downsample(const Level &level, MipFilter filter);
+    // Every level from the given one down to 1x1
+    std::vector<Level> buildMipChain(Level base, MipFilter filter);
+
+    // Writes compressedSize bytes of blocks in row order
+    void compress(uint8_t *destination, const Level &level, BlockFormat format);
+
+    // Single 4x4 blocks, texels are 16 RGBA8 values in row order
+    void encodeBC1(uint8_t destination[8], const uint8_t texels[64]);
+    void encodeBC5(uint8_t destination[16], const uint8_t texels[64]);
+    void encodeBC7(uint8_t destination[16], const uint8_t texels[64]);
+}
@@ -0,0 +1,504 @@
+#include "GWBVH.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace GWIN
+{
+    // Objects without a mesh still get a small box so they can be picked and found by queries
+    static constexpr float EMPTY_OBJECT_EXTENT = 0.25f;
+    // Rebuild once the summed surface area of the tree has grown by this factor since the last build
+    static constexpr float REBUILD_COST_RATIO = 1.5f;
+
+    static GWBVH::AABB merge(const GWBVH::AABB &a, const GWBVH::AABB &b)
+    {
+        return {glm::min(a.min, b.min), glm::max(a.max, b.max)};
+    }
+
+    static float surfaceArea(const GWBVH::AABB &box)
+    {
+        glm::vec3 size = box.max - box.min;
+        return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    static bool equal(const GWBVH::AABB &a, const GWBVH::AABB &b)
+    {
+        return a.min == b.min && a.max == b.max;
+    }
+
+    static GWBVH::AABB worldBounds(const GWModel::Bounds &bounds, const glm::mat4 &world)
+    {
+        glm::vec3 center = glm::vec3(world * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.f));
+        glm::vec3 extent = (bounds.max - bounds.min) * 0.5f;
+        glm::vec3 worldExtent = glm::abs(glm::vec3(world[0])) * extent.x +
+                                glm::abs(glm::vec3(world[1])) * extent.y +
+                                glm::abs(glm::vec3(world[2])) * extent.z;
+
+        return {center - worldExtent, center + worldExtent};
+    }
+
+    void GWBVH::sync(GWEntityStore &gameObjects, const GWModel::map &meshes)
+    {
+        gameObjects.takeChangedIds(changedIds);
+
+        for (id_t id : changedIds)
+        {
+            if (!gameObjects.contains(id))
+            {
+                remove(id);
+                continue;
+            }
+
+            const glm::mat4 &world = gameObjects.worldMatrix(id);
+            int32_t model = gameObjects.model(id);
+
+            AABB box;
+            auto mesh = meshes.find(model);
+            if (model != -1 && mesh != meshes.end())
+            {
+                box = worldBounds(mesh->second->getTotalBounds(), world);
+            }
+            else
+            {
+                glm::vec3 position = glm::vec3(world[3]);
+                box = {position - EMPTY_OBJECT_EXTENT, position + EMPTY_OBJECT_EXTENT};
+            }
+
+            if (contains(id))
+                update(id, box);
+            else
+                insert(id, box);
+        }
+
+        if (changesSinceCheck > leafCount / 4 + 1)
+        {
+            changesSinceCheck = 0;
+            if (treeCost() > builtCost * REBUILD_COST_RATIO)
+                rebuild();
+        }
+    }
+
+    int32_t GWBVH::allocateNode()
+    {
+        if (!freeNodes.empty())
+        {
+            int32_t node = freeNodes.back();
+            freeNodes.pop_back();
+            nodes[node] = Node{};
+            return node;
+        }
+
+        nodes.emplace_back();
+        return static_cast<int32_t>(nodes.size() - 1);
+    }
+
+    void GWBVH::freeNode(int32_t node)
+    {
+        freeNodes.push_back(node);
+    }
+
+    void GWBVH::insert(id_t id, const AABB &box)
+    {
+        assert(!contains(id) && "Object is already in the BVH");
+
+        int32_t leaf = allocateNode();
+        nodes[leaf].box = box;
+        nodes[leaf].id = id;
+
+        if (id >= leafOfId.size())
+            leafOfId.resize(id + 1, NULL_NODE);
+
+        leafOfId[id] = leaf;
+        leafCount++;
+        changesSinceCheck++;
+
+        insertLeaf(leaf);
+    }
+
+    void GWBVH::update(id_t id, const AABB &box)
+    {
+        int32_t leaf = leafOfId[id];
+
+        if (equal(nodes[leaf].box, box))
+            return;
+
+        nodes[leaf].box = box;
+        refitFrom(nodes[leaf].parent);
+        changesSinceCheck++;
+    }
+
+    void GWBVH::remove(id_t id)
+    {
+        if (!contains(id))
+            return;
+
+        int32_t leaf = leafOfId[id];
+        removeLeaf(leaf);
+        freeNode(leaf);
+
+        leafOfId[id] = NULL_NODE;
+        leafCount--;
+    }
+
+    void GWBVH::clear()
+    {
+        nodes.clear();
+        freeNodes.clear();
+        leafOfId.clear();
+        root = NULL_NODE;
+        leafCount = 0;
+        builtCost = 0.f;
+        changesSinceCheck = 0;
+    }
+
+    void GWBVH::insertLeaf(int32_t leaf)
+    {
+        if (root == NULL_NODE)
+        {
+            root = leaf;
+            nodes[root].parent = NULL_NODE;
+            return;
+        }
+
+        // Walk down towards the child whose area grows the least, stop when a new parent here is cheaper
+        const AABB box = nodes[leaf].box;
+        int32_t sibling = root;
+
+        while (!nodes[sibling].isLeaf())
+        {
+            const Node &node = nodes[sibling];
+
+            float area = surfaceArea(node.box);
+            float combinedArea = surfaceArea(merge(node.box, box));
+
+            float cost = 2.f * combinedArea;
+            float inheritanceCost = 2.f * (combinedArea - area);
+
+            auto descendCost = [&](int32_t child)
+            {
+                float childArea = surfaceArea(merge(nodes[child].box, box));
+                if (nodes[child].isLeaf())
+                    return childArea + inheritanceCost;
+
+                return childArea - surfaceArea(nodes[child].box) + inheritanceCost;
+            };
+
+            float leftCost = descendCost(node.left);
+            float rightCost = descendCost(node.right);
+
+            if (cost < leftCost && cost < rightCost)
+                break;
+
+            sibling = leftCost < rightCost ? node.left : node.right;
+        }
+
+        int32_t oldParent = nodes[sibling].parent;
+        int32_t newParent = allocateNode();
+
+        nodes[newParent].parent = oldParent;
+        nodes[newParent].box = merge(box, nodes[sibling].box);
+        nodes[newParent].left = sibling;
+        nodes[newParent].right = leaf;
+        nodes[sibling].parent = newParent;
+        nodes[leaf].parent = newParent;
+
+        if (oldParent == NULL_NODE)
+        {
+            root = newParent;
+        }
+        else
+        {
+            if (nodes[oldParent].left == sibling)
+                nodes[oldParent].left = newParent;
+            else
+                nodes[oldParent].right = newParent;
+
+            refitFrom(oldParent);
+        }
+    }
+
+    void GWBVH::removeLeaf(int32_t leaf)
+    {
+        if (leaf == root)
+        {
+            root = NULL_NODE;
+            return;
+        }
+
+        int32_t parent = nodes[leaf].parent;
+        int32_t grandParent = nodes[parent].parent;
+        int32_t sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+        if (grandParent == NULL_NODE)
+        {
+            root = sibling;
+            nodes[sibling].parent = NULL_NODE;
+        }
+        else
+        {
+            if (nodes[grandParent].left == parent)
+                nodes[grandParent].left = sibling;
+            else
+                nodes[grandParent].right = sibling;
+
+            nodes[sibling].parent = grandParent;
+            refitFrom(grandParent);
+        }
+
+        freeNode(parent);
+    }
+
+    void GWBVH::refitFrom(int32_t node)
+    {
+        while (node != NULL_NODE)
+        {
+            AABB box = merge(nodes[nodes[node].left].box, nodes[nodes[node].right].box);
+
+            if (equal(box, nodes[node].box))
+                return;
+
+            nodes[node].box = box;
+            node = nodes[node].parent;
+        }
+    }
+
+    void GWBVH::rebuild()
+    {
+        if (leafCount == 0)
+            return;
+
+        std::vector<int32_t> leaves;
+        leaves.reserve(leafCount);
+
+        for (int32_t leaf : leafOfId)
+        {
+            if (leaf != NULL_NODE)
+                leaves.push_back(leaf);
+        }
+
+        // Internal nodes are all recreated, leaves keep their slots
+        std::vector<uint8_t> isLeaf(nodes.size(), 0);
+        for (int32_t leaf : leaves)
+        {
+            isLeaf[leaf] = 1;
+        }
+
+        freeNodes.clear();
+        for (int32_t node = static_cast<int32_t>(nodes.size()) - 1; node >= 0; --node)
+        {
+            if (!isLeaf[node])
+                freeNodes.push_back(node);
+        }
+
+        root = buildRange(leaves, 0, leaves.size());
+        nodes[root].parent = NULL_NODE;
+
+        builtCost = treeCost();
+        changesSinceCheck = 0;
+    }
+
+    int32_t GWBVH::buildRange(std::vector<int32_t> &leaves, size_t begin, size_t end)
+    {
+        if (end - begin == 1)
+            return leaves[begin];
+
+        // Median split along the longest axis of the centroids
+        AABB centroids{glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest())};
+        for (size_t i = begin; i < end; ++i)
+        {
+            glm::vec3 centroid = (nodes[leaves[i]].box.min + nodes[leaves[i]].box.max) * 0.5f;
+            centroids.min = glm::min(centroids.min, centroid);
+            centroids.max = glm::max(centroids.max, centroid);
+        }
+
+        glm::vec3 size = centroids.max - centroids.min;
+        int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+
+        size_t middle = begin + (end - begin) / 2;
+        std::nth_element(leaves.begin() + begin, leaves.begin() + middle, leaves.begin() + end, [this, axis](int32_t a, int32_t b)
+        {
+            return nodes[a].box.min[axis] + nodes[a].box.max[axis] < nodes[b].box.min[axis] + nodes[b].box.max[axis];
+        });
+
+        int32_t left = buildRange(leaves, begin, middle);
+        int32_t right = buildRange(leaves, middle, end);
+
+        int32_t node = allocateNode();
+        nodes[node].left = left;
+        nodes[node].right = right;
+        nodes[node].box = merge(nodes[left].box, nodes[right].box);
+        nodes[left].parent = node;
+        nodes[right].parent = node;
+
+        return node;
+    }
+
+    float GWBVH::treeCost() const
+    {
+        if (root == NULL_NODE)
+            return 0.f;
+
+        float cost = 0.f;
+        std::vector<int32_t> stack{root};
+
+        while (!stack.empty())
+        {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+
+            if (node.isLeaf())
+                continue;
+
+            cost += surfaceArea(node.box);
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+
+        return cost;
+    }
+
+    void GWBVH::queryFrustum(const glm::vec4 planes[6], std::vector<id_t> &out) const
+    {
+        if (root == NULL_NODE)
+            return;
+
+        std::vector<int32_t> stack;
+        stack.reserve(64);
+
+        // Nodes fully inside are emitted without testing their children
+        auto emitAll = [this, &out](int32_t first)
+        {
+            std::vector<int32_t> subtree{first};
+            while (!subtree.empty())
+            {
+                const Node &node = nodes[subtree.back()];
+                subtree.pop_back();
+
+                if (node.isLeaf())
+                {
+                    out.push_back(node.id);
+                    continue;
+                }
+
+                subtree.push_back(node.left);
+                subtree.push_back(node.right);
+            }
+        };
+
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            int32_t index = stack.back();
+            stack.pop_back();
+
+            const Node &node = nodes[index];
+            bool inside = true;
+            bool outside = false;
+
+            for (int p = 0; p < 6 && !outside; ++p)
+            {
+                glm::vec3 normal = glm::vec3(planes[p]);
+                glm::vec3 positive = glm::mix(node.box.min, node.box.max, glm::vec3(glm::greaterThanEqual(normal, glm::vec3(0.f))));
+                glm::vec3 negative = glm::mix(node.box.max, node.box.min, glm::vec3(glm::greaterThanEqual(normal, glm::vec3(0.f))));
+
+                outside = glm::dot(normal, positive) + planes[p].w < 0.f;
+                inside = inside && glm::dot(normal, negative) + planes[p].w >= 0.f;
+            }
+
+            if (outside)
+                continue;
+
+            if (inside || node.isLeaf())
+            {
+                emitAll(index);
+                continue;
+            }
+
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+
+    void GWBVH::querySphere(const glm::vec3 &center, float radius, std::vector<id_t> &out) const
+    {
+        if (root == NULL_NODE)
+            return;
+
+        std::vector<int32_t> stack{root};
+        float radiusSquared = radius * radius;
+
+        while (!stack.empty())
+        {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+
+            glm::vec3 closest = glm::clamp(center, node.box.min, node.box.max);
+            glm::vec3 offset = closest - center;
+            if (glm::dot(offset, offset) > radiusSquared)
+                continue;
+
+            if (node.isLeaf())
+            {
+                out.push_back(node.id);
+                continue;
+            }
+
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+
+    std::optional<GWBVH::id_t> GWBVH::raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance) const
+    {
+        if (root == NULL_NODE)
+            return std::nullopt;
+
+        glm::vec3 inverseDirection = 1.f / direction;
+
+        // Returns the entry distance, or a negative value when the ray misses or starts inside
+        auto intersect = [&](const AABB &box, bool allowInside)
+        {
+            glm::vec3 t0 = (box.min - origin) * inverseDirection;
+            glm::vec3 t1 = (box.max - origin) * inverseDirection;
+            glm::vec3 tMin = glm::min(t0, t1);
+            glm::vec3 tMax = glm::max(t0, t1);
+
+            float enter = std::max({tMin.x, tMin.y, tMin.z});
+            float exit = std::min({tMax.x, tMax.y, tMax.z, maxDistance});
+
+            if (enter > exit || exit < 0.f)
+                return -1.f;
+
+            if (enter < 0.f)
+                return allowInside ? 0.f : -1.f;
+
+            return enter;
+        };
+
+        std::optional<id_t> hit;
+        float closest = maxDistance;
+        std::vector<int32_t> stack{root};
+
+        while (!stack.empty())
+        {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+
+            float distance = intersect(node.box, !node.isLeaf());
+            if (distance < 0.f || distance > closest)
+                continue;
+
+            if (node.isLeaf())
+            {
+                closest = distance;
+                hit = node.id;
+                continue;
+            }
+
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+
+        return hit;
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "GWEntityStore.hpp"
+#include "GWModel.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <optional>
+#include <vector>
+
+namespace GWIN
+{
+    // Dynamic AABB tree over the world bounds of a scene's game objects.
+    // Moving objects refit their ancestors, and the whole tree is rebuilt once refits have degraded it too far.
+    class GWBVH
+    {
+    public:
+        using id_t = GWGameObject::id_t;
+
+        struct AABB
+        {
+            glm::vec3 min{0.f};
+            glm::vec3 max{0.f};
+        };
+
+        GWBVH() = default;
+
+        GWBVH(const GWBVH &) = delete;
+        GWBVH &operator=(const GWBVH &) = delete;
+
+        // Applies every insertion, removal and move the store recorded since the last call
+        void sync(GWEntityStore &gameObjects, const GWModel::map &meshes);
+
+        void insert(id_t id, const AABB &box);
+        void update(id_t id, const AABB &box);
+        void remove(id_t id);
+        void clear();
+        void rebuild();
+
+        bool contains(id_t id) const { return id < leafOfId.size() && leafOfId[id] != NULL_NODE; }
+        size_t size() const { return leafCount; }
+
+        // Planes as in Frustum::getPlanes(), results are appended to out
+        void queryFrustum(const glm::vec4 planes[6], std::vector<id_t> &out) const;
+        void querySphere(const glm::vec3 &center, float radius, std::vector<id_t> &out) const;
+
+        // Closest box hit in front of the origin, boxes containing the origin are ignored
+        std::optional<id_t> raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance = 1000.f) const;
+
+    private:
+        static constexpr int32_t NULL_NODE = -1;
+
+        struct Node
+        {
+            AABB box{};
+            int32_t parent{NULL_NODE};
+            int32_t left{NULL_NODE};
+            int32_t right{NULL_NODE};
+            id_t id{0};
+
+            bool isLeaf() const { return left == NULL_NODE; }
+        };
+
+        int32_t allocateNode();
+        void freeNode(int32_t node);
+
+        void insertLeaf(int32_t leaf);
+        void removeLeaf(int32_t leaf);
+        void refitFrom(int32_t node);
+        int32_t buildRange(std::vector<int32_t> &leaves, size_t begin, size_t end);
+        float treeCost() const;
+
+        std::vector<Node> nodes;
+        std::vector<int32_t> freeNodes;
+        std::vector<int32_t> leafOfId; // id -> leaf node
+        int32_t root{NULL_NODE};
+        size_t leafCount{0};
+
+        float builtCost{0.f};
+        size_t changesSinceCheck{0};
+
+        std::vector<id_t> changedIds;
+    };
+}
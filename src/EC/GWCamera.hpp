@@ -35,8 +35,9 @@ namespace GWIN
 
     std::string toJson() const;
 
-    void updateFrustumPlanes() { cameraFrustum.updateFrustumPlanes(viewMatrix * projectionMatrix); }
+    void updateFrustumPlanes() { cameraFrustum.updateFrustumPlanes(projectionMatrix * viewMatrix); }
     bool isPointInFrustum(const glm::vec3 point) { return cameraFrustum.isPointInFrustum(point); }
+    const Frustum &getFrustum() const { return cameraFrustum; }
 
     private:
     
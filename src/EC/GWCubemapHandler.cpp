@@ -5,7 +5,8 @@
 
 namespace GWIN
 {
-    GWCubemapHandler::GWCubemapHandler(GWinDevice& device) : device(device) {};
+    GWCubemapHandler::GWCubemapHandler(GWinDevice& device, GWThreadPool& threadPool, GWUploadManager& uploadManager)
+        : device(device), threadPool(threadPool), uploadManager(uploadManager) {};
 
     CubeMap GWCubemapHandler::createCubeMap(CubeMapInfo& info)
     {
@@ -25,30 +26,37 @@ namespace GWIN
 
     void GWCubemapHandler::generateCubeMap(CubeMap& cubeMap)
     {
-        int texWidth, texHeight, texChannels;
-        VkDeviceSize imageSize;
-        std::vector<stbi_uc *> pixels(6);
+        auto faces = cubeMap.info.getFaces();
 
-        auto& faces = cubeMap.info.getFaces();
+        // The faces decode side by side on the thread pool
+        std::array<DecodedImage, 6> pixels;
+        threadPool.parallelFor(faces.size(), 1, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                pixels[i] = GWImageLoader::decodeImage(faces[i]);
+            }
+        });
 
-        for (uint32_t i = 0; i < faces.size(); ++i)
+        for (size_t i = 0; i < faces.size(); ++i)
         {
-            pixels[i] = stbi_load(faces[i].c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-            if (!pixels[i])
+            if (!pixels[i].pixels || pixels[i].size.width != pixels[0].size.width || pixels[i].size.height != pixels[0].size.height)
             {
                 std::cout << faces[i] << std::endl;
                 throw std::runtime_error("failed to load cubemap texture image!");
             }
         }
 
-        imageSize = texWidth * texHeight * 4;
+        uint32_t texWidth = pixels[0].size.width;
+        uint32_t texHeight = pixels[0].size.height;
+        VkDeviceSize imageSize = pixels[0].byteSize();
 
         VkImageCreateInfo imageInfo{};
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
         imageInfo.imageType = VK_IMAGE_TYPE_2D;
         imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
-        imageInfo.extent.width = static_cast<uint32_t>(texWidth);
-        imageInfo.extent.height = static_cast<uint32_t>(texHeight);
+        imageInfo.extent.width = texWidth;
+        imageInfo.extent.height = texHeight;
         imageInfo.extent.depth = 1;
         imageInfo.mipLevels = 1;
         imageInfo.arrayLayers = 6;
@@ -59,28 +67,22 @@ namespace GWIN
 
         device.createImageWithInfo(imageInfo, VMA_MEMORY_USAGE_GPU_ONLY, cubeMap.Cubeimage.image, cubeMap.Cubeimage.allocation);
 
-        GWBuffer stagingBuffer{
-            device,
-            imageSize * 6,
-            1,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VMA_MEMORY_USAGE_CPU_ONLY};
-
-        stagingBuffer.map();
+        // One upload per face, they all land in the same batch and each one leaves its face ready for sampling
         for (size_t i = 0; i < pixels.size(); ++i)
         {
-            stagingBuffer.writeToBuffer(static_cast<void *>(pixels[i]), imageSize, i * imageSize);
+            VkBufferImageCopy region{};
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = 0;
+            region.imageSubresource.baseArrayLayer = static_cast<uint32_t>(i);
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = {texWidth, texHeight, 1};
+
+            VkImageSubresourceRange face{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, static_cast<uint32_t>(i), 1};
+            cubeMap.Cubeimage.upload = uploadManager.uploadToImage(cubeMap.Cubeimage.image, face, pixels[i].pixels.get(), imageSize, {region},
+                                                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
         }
-        stagingBuffer.unmap();
 
-        for (auto &pixel : pixels)
-        {
-            stbi_image_free(pixel);
-        }
-
-        transitionImageLayout(cubeMap, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        device.copyBufferToImage(stagingBuffer.getBuffer(), cubeMap.Cubeimage.image, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), 6);
-        transitionImageLayout(cubeMap, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        cubeMap.Cubeimage.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
         createImageView(cubeMap);
     }
@@ -111,60 +113,6 @@ namespace GWIN
         }
     }
 
-    void GWCubemapHandler::transitionImageLayout(CubeMap &cubeMap, VkImageLayout newLayout)
-    {
-        VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
-
-        VkImageMemoryBarrier barrier{};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        barrier.newLayout = newLayout;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.image = cubeMap.Cubeimage.image;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = 1;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 6;
-
-        VkPipelineStageFlags sourceStage;
-        VkPipelineStageFlags destinationStage;
-
-        if (newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-        {
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-            sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        }
-        else if (newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-        {
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-        }
-        else
-        {
-            throw std::invalid_argument("unsupported layout transition!");
-        }
-
-        vkCmdPipelineBarrier(
-            commandBuffer,
-            sourceStage, destinationStage,
-            0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
-
-        device.endSingleTimeCommands(commandBuffer);
-
-        cubeMap.Cubeimage.layout = newLayout;
-    }
-
     void GWCubemapHandler::createImageView(CubeMap &cubeMap)
     {
         VkImageViewCreateInfo viewInfo{};
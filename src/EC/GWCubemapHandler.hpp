@@ -1,6 +1,7 @@
 #pragma once
 
 #include "GWImageLoader.hpp" 
+#include "../GWThreadPool.hpp"
 #include <array>
 
 namespace GWIN
@@ -30,7 +31,7 @@ namespace GWIN
     class GWCubemapHandler
     {
     public:
-        GWCubemapHandler(GWinDevice& device);
+        GWCubemapHandler(GWinDevice& device, GWThreadPool& threadPool, GWUploadManager& uploadManager);
         //~GWCubemapHandler();
         
         GWCubemapHandler(const GWCubemapHandler &) = delete;
@@ -40,11 +41,12 @@ namespace GWIN
 
     private:
         GWinDevice& device;
+        GWThreadPool& threadPool;
+        GWUploadManager& uploadManager;
 
         void generateCubeMap(CubeMap &cubeMap);
         void createSampler(VkSampler& sampler);
 
-        void transitionImageLayout(CubeMap &cubeMap, VkImageLayout newLayout);
         void createImageView(CubeMap& cubeMap);
 
         uint32_t lastCubemapId{0};
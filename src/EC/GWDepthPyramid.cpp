@@ -0,0 +1,350 @@
+#include "GWDepthPyramid.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+#define MAX_PYRAMID_MIPS 16
+#define MAX_DEPTH_SETS 8
+
+namespace GWIN
+{
+    struct ReducePushConstant
+    {
+        glm::vec2 outputSize;
+        glm::vec2 uvScale;
+    };
+
+    static uint32_t previousPow2(uint32_t value)
+    {
+        uint32_t result = 1;
+        while (result * 2 <= value)
+        {
+            result *= 2;
+        }
+        return result;
+    }
+
+    GWDepthPyramid::GWDepthPyramid(GWindow &window, GWinDevice &device) : window(window), device(device)
+    {
+        createSampler();
+        createDescriptors();
+        createPipeline();
+        createPyramid();
+    }
+
+    GWDepthPyramid::~GWDepthPyramid()
+    {
+        destroyPyramid();
+
+        vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+        vkDestroySampler(device.device(), reductionSampler, nullptr);
+    }
+
+    void GWDepthPyramid::createSampler()
+    {
+        VkSamplerReductionModeCreateInfo reductionInfo{};
+        reductionInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_REDUCTION_MODE_CREATE_INFO;
+        reductionInfo.reductionMode = VK_SAMPLER_REDUCTION_MODE_MAX;
+
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.pNext = &reductionInfo;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.anisotropyEnable = VK_FALSE;
+        samplerInfo.compareEnable = VK_FALSE;
+        samplerInfo.minLod = 0.0f;
+        samplerInfo.maxLod = static_cast<float>(MAX_PYRAMID_MIPS);
+
+        if (vkCreateSampler(device.device(), &samplerInfo, nullptr, &reductionSampler) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create depth pyramid sampler!");
+        }
+    }
+
+    void GWDepthPyramid::createDescriptors()
+    {
+        descriptorPool = GWDescriptorPool::Builder(device)
+                             .setMaxSets(MAX_PYRAMID_MIPS + MAX_DEPTH_SETS + 1)
+                             .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_PYRAMID_MIPS + MAX_DEPTH_SETS + 1)
+                             .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_PYRAMID_MIPS + MAX_DEPTH_SETS)
+                             .build();
+
+        reduceSetLayout = GWDescriptorSetLayout::Builder(device)
+                              .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+                              .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+                              .build();
+
+        sampleSetLayout = GWDescriptorSetLayout::Builder(device)
+                              .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+                              .build();
+    }
+
+    void GWDepthPyramid::createPipeline()
+    {
+        VkPushConstantRange pushConstant{};
+        pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstant.offset = 0;
+        pushConstant.size = sizeof(ReducePushConstant);
+
+        VkDescriptorSetLayout setLayout = reduceSetLayout->getDescriptorSetLayout();
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &setLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstant;
+
+        if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to Create Depth Pyramid Pipeline Layout!");
+        }
+
+        reducePipeline = std::make_unique<GComputePipeline>(device, "src/shaders/depthreduce.comp.spv", pipelineLayout);
+    }
+
+    void GWDepthPyramid::createPyramid()
+    {
+        renderExtent = window.getExtent();
+
+        // A power of two keeps every reduction step an exact 2x2 footprint
+        extent.width = previousPow2(std::max(renderExtent.width, 1u));
+        extent.height = previousPow2(std::max(renderExtent.height, 1u));
+
+        mipCount = 1;
+        while ((std::max(extent.width, extent.height) >> mipCount) > 0 && mipCount < MAX_PYRAMID_MIPS)
+        {
+            mipCount++;
+        }
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = extent.width;
+        imageInfo.extent.height = extent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = mipCount;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = VK_FORMAT_R32_SFLOAT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        device.createImageWithInfo(imageInfo, VMA_MEMORY_USAGE_GPU_ONLY, image, allocation);
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_R32_SFLOAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = mipCount;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(device.device(), &viewInfo, nullptr, &fullView) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create depth pyramid view!");
+        }
+
+        mipViews.resize(mipCount);
+        for (uint32_t i = 0; i < mipCount; ++i)
+        {
+            viewInfo.subresourceRange.baseMipLevel = i;
+            viewInfo.subresourceRange.levelCount = 1;
+
+            if (vkCreateImageView(device.device(), &viewInfo, nullptr, &mipViews[i]) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create depth pyramid mip view!");
+            }
+        }
+
+        mipSets.resize(mipCount, VK_NULL_HANDLE);
+        for (uint32_t i = 1; i < mipCount; ++i)
+        {
+            VkDescriptorImageInfo inputInfo{reductionSampler, mipViews[i - 1], VK_IMAGE_LAYOUT_GENERAL};
+            VkDescriptorImageInfo outputInfo{VK_NULL_HANDLE, mipViews[i], VK_IMAGE_LAYOUT_GENERAL};
+
+            GWDescriptorWriter(*reduceSetLayout, *descriptorPool)
+                .writeImage(0, &inputInfo)
+                .writeImage(1, &outputInfo)
+                .build(mipSets[i]);
+        }
+
+        VkDescriptorImageInfo sampleInfo{reductionSampler, fullView, VK_IMAGE_LAYOUT_GENERAL};
+        GWDescriptorWriter(*sampleSetLayout, *descriptorPool)
+            .writeImage(0, &sampleInfo)
+            .build(sampleSet);
+
+        // Stays in GENERAL from here on, the sets are bound even when build() never runs (occlusion off)
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = mipCount;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+
+        VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier);
+        device.endSingleTimeCommands(commandBuffer);
+    }
+
+    void GWDepthPyramid::destroyPyramid()
+    {
+        descriptorPool->resetPool();
+        mipSets.clear();
+        depthSets.clear();
+        sampleSet = VK_NULL_HANDLE;
+
+        for (auto view : mipViews)
+        {
+            vkDestroyImageView(device.device(), view, nullptr);
+        }
+        mipViews.clear();
+
+        vkDestroyImageView(device.device(), fullView, nullptr);
+        vmaDestroyImage(device.getAllocator(), image, allocation);
+        fullView = VK_NULL_HANDLE;
+        image = VK_NULL_HANDLE;
+        allocation = VK_NULL_HANDLE;
+    }
+
+    void GWDepthPyramid::checkExtent()
+    {
+        VkExtent2D windowExtent = window.getExtent();
+        if (windowExtent.width == renderExtent.width && windowExtent.height == renderExtent.height)
+            return;
+
+        vkDeviceWaitIdle(device.device());
+        destroyPyramid();
+        createPyramid();
+    }
+
+    VkDescriptorSet GWDepthPyramid::getDepthSet(VkImageView depthView)
+    {
+        auto it = depthSets.find(depthView);
+        if (it != depthSets.end())
+            return it->second;
+
+        VkDescriptorImageInfo inputInfo{reductionSampler, depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+        VkDescriptorImageInfo outputInfo{VK_NULL_HANDLE, mipViews[0], VK_IMAGE_LAYOUT_GENERAL};
+
+        VkDescriptorSet set;
+        if (!GWDescriptorWriter(*reduceSetLayout, *descriptorPool)
+                 .writeImage(0, &inputInfo)
+                 .writeImage(1, &outputInfo)
+                 .build(set))
+        {
+            throw std::runtime_error("failed to allocate depth pyramid set!");
+        }
+
+        depthSets.emplace(depthView, set);
+        return set;
+    }
+
+    void GWDepthPyramid::build(VkCommandBuffer commandBuffer, VkImageView depthView, VkExtent2D depthExtent)
+    {
+        VkDescriptorSet depthSet = getDepthSet(depthView);
+
+        // Every mip is rewritten, only the reads of earlier frames have to be done first
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = mipCount;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier);
+
+        reducePipeline->bind(commandBuffer);
+
+        for (uint32_t i = 0; i < mipCount; ++i)
+        {
+            VkDescriptorSet set = i == 0 ? depthSet : mipSets[i];
+            vkCmdBindDescriptorSets(
+                commandBuffer,
+                VK_PIPELINE_BIND_POINT_COMPUTE,
+                pipelineLayout,
+                0, 1,
+                &set,
+                0,
+                nullptr);
+
+            uint32_t width = std::max(extent.width >> i, 1u);
+            uint32_t height = std::max(extent.height >> i, 1u);
+
+            ReducePushConstant push{};
+            push.outputSize = glm::vec2(width, height);
+            // Only the rendered corner of the depth attachment is reduced
+            push.uvScale = i == 0 ? glm::vec2(static_cast<float>(renderExtent.width) / depthExtent.width,
+                                              static_cast<float>(renderExtent.height) / depthExtent.height)
+                                  : glm::vec2(1.f);
+
+            vkCmdPushConstants(
+                commandBuffer,
+                pipelineLayout,
+                VK_SHADER_STAGE_COMPUTE_BIT,
+                0,
+                sizeof(ReducePushConstant),
+                &push);
+
+            vkCmdDispatch(commandBuffer, (width + 15) / 16, (height + 15) / 16, 1);
+
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.subresourceRange.baseMipLevel = i;
+            barrier.subresourceRange.levelCount = 1;
+
+            vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0,
+                0, nullptr,
+                0, nullptr,
+                1, &barrier);
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "../GWindow.hpp"
+#include "../GWDevice.hpp"
+#include "../GWPipeLine.hpp"
+#include "GWDescriptors.hpp"
+
+// std
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace GWIN
+{
+    // Hierarchical depth (Hi-Z) built by compute from the offscreen depth attachment.
+    // Every texel holds the farthest depth of the texels below it, so a box whose nearest depth is
+    // farther than the texel covering it is hidden.
+    class GWDepthPyramid
+    {
+    public:
+        GWDepthPyramid(GWindow &window, GWinDevice &device);
+        ~GWDepthPyramid();
+
+        GWDepthPyramid(const GWDepthPyramid &) = delete;
+        GWDepthPyramid &operator=(const GWDepthPyramid &) = delete;
+
+        // Recreates the pyramid when the window was resized, must be called before anything of the frame is recorded
+        void checkExtent();
+
+        // depthView has to be in VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, depthExtent is the size of its image
+        void build(VkCommandBuffer commandBuffer, VkImageView depthView, VkExtent2D depthExtent);
+
+        VkDescriptorSetLayout getSetLayout() const { return sampleSetLayout->getDescriptorSetLayout(); }
+        VkDescriptorSet getSampleSet() const { return sampleSet; }
+
+    private:
+        void createSampler();
+        void createDescriptors();
+        void createPipeline();
+
+        void createPyramid();
+        void destroyPyramid();
+
+        VkDescriptorSet getDepthSet(VkImageView depthView);
+
+        GWindow &window;
+        GWinDevice &device;
+
+        VkExtent2D renderExtent{0, 0}; // area of the depth attachment that is rendered to
+        VkExtent2D extent{0, 0};
+        uint32_t mipCount{0};
+
+        VkImage image{VK_NULL_HANDLE};
+        VmaAllocation allocation{VK_NULL_HANDLE};
+        VkImageView fullView{VK_NULL_HANDLE};
+        std::vector<VkImageView> mipViews;
+
+        // Max reduction, so linear filtering returns the farthest depth of the footprint
+        VkSampler reductionSampler;
+
+        std::unique_ptr<GWDescriptorPool> descriptorPool;
+        std::unique_ptr<GWDescriptorSetLayout> reduceSetLayout;
+        std::unique_ptr<GWDescriptorSetLayout> sampleSetLayout;
+
+        std::vector<VkDescriptorSet> mipSets; // mipSets[i] reads mip i - 1 and writes mip i, mip 0 uses depthSets
+        std::unordered_map<VkImageView, VkDescriptorSet> depthSets;
+        VkDescriptorSet sampleSet{VK_NULL_HANDLE};
+
+        VkPipelineLayout pipelineLayout;
+        std::unique_ptr<GComputePipeline> reducePipeline;
+    };
+}
@@ -19,16 +19,20 @@ class GWDescriptorSetLayout {
         uint32_t binding,
         VkDescriptorType descriptorType,
         VkShaderStageFlags stageFlags,
-        uint32_t count = 1);
+        uint32_t count = 1,
+        VkDescriptorBindingFlags bindingFlags = 0);
     std::unique_ptr<GWDescriptorSetLayout> build() const;
  
    private:
     GWinDevice &device;
     std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+    std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags{};
   };
  
   GWDescriptorSetLayout(
-      GWinDevice &device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+      GWinDevice &device,
+      std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+      const std::unordered_map<uint32_t, VkDescriptorBindingFlags> &bindingFlags = {});
   ~GWDescriptorSetLayout();
   GWDescriptorSetLayout(const GWDescriptorSetLayout &) = delete;
   GWDescriptorSetLayout &operator=(const GWDescriptorSetLayout &) = delete;
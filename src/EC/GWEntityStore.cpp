@@ -0,0 +1,452 @@
+#include "GWEntityStore.hpp"
+#include "Components/BatchMath.hpp"
+
+#include <algorithm>
+
+namespace GWIN
+{
+    static constexpr size_t PARALLEL_UPDATE_THRESHOLD = 4096;
+    static constexpr size_t ROOTS_PER_TASK = 64;
+
+    template <typename T>
+    static void applyOrder(std::vector<T> &values, const std::vector<uint32_t> &order)
+    {
+        std::vector<T> sorted;
+        sorted.reserve(values.size());
+
+        for (uint32_t index : order)
+        {
+            sorted.push_back(std::move(values[index]));
+        }
+
+        values.swap(sorted);
+    }
+
+    GWEntityStore::id_t GWEntityStore::insert(GWGameObject &&object)
+    {
+        id_t id = object.getId();
+
+        if (contains(id))
+            erase(id);
+
+        if (id >= sparse.size())
+            sparse.resize(id + 1, INVALID_INDEX);
+
+        sparse[id] = static_cast<uint32_t>(ids.size());
+
+        ids.push_back(id);
+        transforms.push_back(object.transform);
+        worldMatrices.push_back(object.transform.mat4());
+        dirtyFlags.push_back(0);
+        models.push_back(object.model);
+        shadowFlags.push_back(object.castShadow ? 1 : 0);
+        names.push_back(object.getName());
+        parentIds.push_back(NO_PARENT);
+        parentIndices.push_back(INVALID_INDEX);
+
+        hierarchyDirty = true;
+        markChanged(id);
+
+        if (object.light.has_value())
+            addLight(id, object.light.value());
+
+        return id;
+    }
+
+    void GWEntityStore::erase(id_t id)
+    {
+        if (!contains(id))
+            return;
+
+        removeLight(id);
+
+        uint32_t index = sparse[id];
+        id_t newParent = parentIds[index];
+
+        // Children are handed over to the removed object's parent
+        for (size_t i = 0; i < parentIds.size(); ++i)
+        {
+            if (parentIds[i] != id)
+                continue;
+
+            parentIds[i] = newParent;
+            if (!dirtyFlags[i])
+            {
+                dirtyFlags[i] = 1;
+                dirtyCount++;
+            }
+        }
+
+        uint32_t last = static_cast<uint32_t>(ids.size() - 1);
+
+        dirtyCount -= dirtyFlags[index];
+
+        if (index != last)
+        {
+            ids[index] = ids[last];
+            transforms[index] = transforms[last];
+            worldMatrices[index] = worldMatrices[last];
+            dirtyFlags[index] = dirtyFlags[last];
+            models[index] = models[last];
+            shadowFlags[index] = shadowFlags[last];
+            names[index] = std::move(names[last]);
+            parentIds[index] = parentIds[last];
+
+            sparse[ids[index]] = index;
+        }
+
+        ids.pop_back();
+        transforms.pop_back();
+        worldMatrices.pop_back();
+        dirtyFlags.pop_back();
+        models.pop_back();
+        shadowFlags.pop_back();
+        names.pop_back();
+        parentIds.pop_back();
+        parentIndices.pop_back();
+
+        sparse[id] = INVALID_INDEX;
+        hierarchyDirty = true;
+        markChanged(id);
+    }
+
+    void GWEntityStore::clear()
+    {
+        for (id_t id : ids)
+        {
+            markChanged(id);
+        }
+
+        sparse.clear();
+        ids.clear();
+        transforms.clear();
+        worldMatrices.clear();
+        dirtyFlags.clear();
+        dirtyCount = 0;
+        models.clear();
+        shadowFlags.clear();
+        names.clear();
+        parentIds.clear();
+        parentIndices.clear();
+        rootIndices.clear();
+        hierarchyDirty = false;
+
+        lightSparse.clear();
+        lights.clear();
+        lightOwners.clear();
+    }
+
+    TransformComponent &GWEntityStore::editTransform(id_t id)
+    {
+        uint32_t index = indexOf(id);
+
+        if (!dirtyFlags[index])
+        {
+            dirtyFlags[index] = 1;
+            dirtyCount++;
+        }
+
+        return transforms[index];
+    }
+
+    void GWEntityStore::setModel(id_t id, int32_t model)
+    {
+        models[indexOf(id)] = model;
+        markChanged(id);
+    }
+
+    void GWEntityStore::markChanged(id_t id)
+    {
+        if (id >= changedMarks.size())
+            changedMarks.resize(id + 1, 0);
+
+        if (!changedMarks[id])
+        {
+            changedMarks[id] = 1;
+            changedIds.push_back(id);
+        }
+    }
+
+    void GWEntityStore::takeChangedIds(std::vector<id_t> &out)
+    {
+        out.clear();
+        out.swap(changedIds);
+
+        for (id_t id : out)
+        {
+            changedMarks[id] = 0;
+        }
+    }
+
+    bool GWEntityStore::setParent(id_t id, id_t parent)
+    {
+        uint32_t index = indexOf(id);
+
+        for (id_t ancestor = parent; ancestor != NO_PARENT; ancestor = parentIds[indexOf(ancestor)])
+        {
+            if (ancestor == id)
+                return false;
+        }
+
+        if (parentIds[index] == parent)
+            return true;
+
+        parentIds[index] = parent;
+        hierarchyDirty = true;
+        editTransform(id);
+
+        return true;
+    }
+
+    void GWEntityStore::sortHierarchy()
+    {
+        const size_t count = ids.size();
+
+        std::vector<uint32_t> firstChild(count, INVALID_INDEX);
+        std::vector<uint32_t> nextSibling(count, INVALID_INDEX);
+
+        // Walked backwards so siblings keep their current relative order
+        for (size_t i = count; i-- > 0;)
+        {
+            if (parentIds[i] == NO_PARENT)
+                continue;
+
+            uint32_t parentIndex = sparse[parentIds[i]];
+            nextSibling[i] = firstChild[parentIndex];
+            firstChild[parentIndex] = static_cast<uint32_t>(i);
+        }
+
+        std::vector<uint32_t> order;
+        std::vector<uint32_t> stack;
+        order.reserve(count);
+        rootIndices.clear();
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (parentIds[i] != NO_PARENT)
+                continue;
+
+            rootIndices.push_back(static_cast<uint32_t>(order.size()));
+            stack.push_back(static_cast<uint32_t>(i));
+
+            while (!stack.empty())
+            {
+                uint32_t node = stack.back();
+                stack.pop_back();
+                order.push_back(node);
+
+                size_t firstPushed = stack.size();
+                for (uint32_t child = firstChild[node]; child != INVALID_INDEX; child = nextSibling[child])
+                {
+                    stack.push_back(child);
+                }
+                std::reverse(stack.begin() + firstPushed, stack.end());
+            }
+        }
+
+        assert(order.size() == count && "Hierarchy contains a cycle");
+
+        applyOrder(ids, order);
+        applyOrder(transforms, order);
+        applyOrder(worldMatrices, order);
+        applyOrder(dirtyFlags, order);
+        applyOrder(models, order);
+        applyOrder(shadowFlags, order);
+        applyOrder(names, order);
+        applyOrder(parentIds, order);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            sparse[ids[i]] = static_cast<uint32_t>(i);
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            parentIndices[i] = parentIds[i] == NO_PARENT ? INVALID_INDEX : sparse[parentIds[i]];
+        }
+
+        hierarchyDirty = false;
+    }
+
+    // Transforms gathered into separate streams for BatchMath::composeTRS, one set per updating thread
+    struct TRSScratch
+    {
+        std::vector<uint32_t> indices;
+        std::vector<float> tx, ty, tz, qx, qy, qz, qw, sx, sy, sz;
+
+        void resize(size_t count)
+        {
+            for (auto *stream : {&tx, &ty, &tz, &qx, &qy, &qz, &qw, &sx, &sy, &sz})
+            {
+                stream->resize(count);
+            }
+        }
+    };
+
+    void GWEntityStore::updateRange(size_t begin, size_t end)
+    {
+        thread_local TRSScratch scratch;
+        scratch.indices.clear();
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            uint32_t parentIndex = parentIndices[i];
+
+            if (parentIndex != INVALID_INDEX)
+                dirtyFlags[i] |= dirtyFlags[parentIndex];
+
+            if (dirtyFlags[i])
+                scratch.indices.push_back(static_cast<uint32_t>(i));
+        }
+
+        size_t count = scratch.indices.size();
+        scratch.resize(count);
+
+        for (size_t k = 0; k < count; ++k)
+        {
+            const TransformComponent &transform = transforms[scratch.indices[k]];
+            scratch.tx[k] = transform.translation.x;
+            scratch.ty[k] = transform.translation.y;
+            scratch.tz[k] = transform.translation.z;
+            scratch.qx[k] = transform.rotation.x;
+            scratch.qy[k] = transform.rotation.y;
+            scratch.qz[k] = transform.rotation.z;
+            scratch.qw[k] = transform.rotation.w;
+            scratch.sx[k] = transform.scale.x;
+            scratch.sy[k] = transform.scale.y;
+            scratch.sz[k] = transform.scale.z;
+        }
+
+        BatchMath::TRSStreams streams{
+            scratch.tx.data(), scratch.ty.data(), scratch.tz.data(),
+            scratch.qx.data(), scratch.qy.data(), scratch.qz.data(), scratch.qw.data(),
+            scratch.sx.data(), scratch.sy.data(), scratch.sz.data()};
+        BatchMath::composeTRS(streams, count, worldMatrices.data(), scratch.indices.data());
+
+        // Indices are ascending, so a parent is always final before its children read it
+        for (uint32_t index : scratch.indices)
+        {
+            uint32_t parentIndex = parentIndices[index];
+
+            if (parentIndex != INVALID_INDEX)
+                worldMatrices[index] = BatchMath::multiply(worldMatrices[parentIndex], worldMatrices[index]);
+        }
+
+        if (count > 0)
+        {
+            std::lock_guard<std::mutex> lock(changedMutex);
+            for (uint32_t index : scratch.indices)
+            {
+                markChanged(ids[index]);
+            }
+        }
+
+        std::fill(dirtyFlags.begin() + begin, dirtyFlags.begin() + end, 0);
+    }
+
+    void GWEntityStore::updateWorldMatrices(GWThreadPool *threadPool)
+    {
+        if (hierarchyDirty)
+            sortHierarchy();
+
+        if (dirtyCount == 0)
+            return;
+
+        if (threadPool == nullptr || dirtyCount < PARALLEL_UPDATE_THRESHOLD || rootIndices.size() < 2)
+        {
+            updateRange(0, ids.size());
+        }
+        else
+        {
+            threadPool->parallelFor(rootIndices.size(), ROOTS_PER_TASK, [this](size_t firstRoot, size_t lastRoot)
+            {
+                size_t end = lastRoot < rootIndices.size() ? rootIndices[lastRoot] : ids.size();
+                updateRange(rootIndices[firstRoot], end);
+            });
+        }
+
+        dirtyCount = 0;
+    }
+
+    LightComponent *GWEntityStore::light(id_t id)
+    {
+        if (id >= lightSparse.size() || lightSparse[id] == INVALID_INDEX)
+            return nullptr;
+
+        return &lights[lightSparse[id]];
+    }
+
+    void GWEntityStore::addLight(id_t id, const LightComponent &light)
+    {
+        assert(contains(id) && "Cannot add a light to a game object that does not exist");
+
+        if (LightComponent *existing = this->light(id))
+        {
+            *existing = light;
+            return;
+        }
+
+        if (id >= lightSparse.size())
+            lightSparse.resize(id + 1, INVALID_INDEX);
+
+        lightSparse[id] = static_cast<uint32_t>(lights.size());
+        lights.push_back(light);
+        lightOwners.push_back(id);
+    }
+
+    void GWEntityStore::removeLight(id_t id)
+    {
+        if (id >= lightSparse.size() || lightSparse[id] == INVALID_INDEX)
+            return;
+
+        uint32_t index = lightSparse[id];
+        uint32_t last = static_cast<uint32_t>(lights.size() - 1);
+
+        if (index != last)
+        {
+            lights[index] = lights[last];
+            lightOwners[index] = lightOwners[last];
+            lightSparse[lightOwners[index]] = index;
+        }
+
+        lights.pop_back();
+        lightOwners.pop_back();
+        lightSparse[id] = INVALID_INDEX;
+    }
+
+    std::string GWEntityStore::toJson(id_t id) const
+    {
+        nlohmann::json jsonObject;
+
+        uint32_t index = indexOf(id);
+        const TransformComponent &transform = transforms[index];
+
+        jsonObject["id"] = id;
+        jsonObject["name"] = names[index];
+        jsonObject["transform"] = {
+            {"translation", {transform.translation.x, transform.translation.y, transform.translation.z}},
+            {"rotation", {transform.rotation.x, transform.rotation.y, transform.rotation.z}},
+            {"scale", {transform.scale.x, transform.scale.y, transform.scale.z}}};
+
+        if (id < lightSparse.size() && lightSparse[id] != INVALID_INDEX)
+        {
+            const LightComponent &light = lights[lightSparse[id]];
+
+            jsonObject["color"] = {light.color.x, light.color.y, light.color.z};
+
+            jsonObject["light"] = {
+                {"lightIntensity", light.lightIntensity},
+                {"cutOffAngle", light.cutOffAngle}};
+        }
+        if (models[index] != -1)
+        {
+            jsonObject["model"] = models[index];
+        }
+        if (parentIds[index] != NO_PARENT)
+        {
+            jsonObject["parent"] = parentIds[index];
+        }
+
+        return jsonObject.dump();
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "GWGameObject.hpp"
+#include "../GWThreadPool.hpp"
+
+#include <cassert>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace GWIN
+{
+    // Stores every game object of a scene as packed component arrays.
+    // Ids are stable handles, dense indices are not: the arrays are kept in depth-first order,
+    // so a parent always comes before its children and every root owns a contiguous range.
+    // World matrices are cached and only rebuilt for transforms edited through editTransform().
+    class GWEntityStore
+    {
+    public:
+        using id_t = GWGameObject::id_t;
+        static constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+        static constexpr id_t NO_PARENT = std::numeric_limits<id_t>::max();
+
+        GWEntityStore() = default;
+
+        GWEntityStore(const GWEntityStore &) = delete;
+        GWEntityStore &operator=(const GWEntityStore &) = delete;
+
+        id_t insert(GWGameObject &&object);
+        void erase(id_t id);
+        void clear();
+
+        bool contains(id_t id) const { return id < sparse.size() && sparse[id] != INVALID_INDEX; }
+        uint32_t indexOf(id_t id) const
+        {
+            assert(contains(id) && "Game object does not exist");
+            return sparse[id];
+        }
+        size_t size() const { return ids.size(); }
+
+        const TransformComponent &transform(id_t id) const { return transforms[indexOf(id)]; }
+        TransformComponent &editTransform(id_t id);
+        const glm::mat4 &worldMatrix(id_t id) const { return worldMatrices[indexOf(id)]; }
+        int32_t model(id_t id) const { return models[indexOf(id)]; }
+        void setModel(id_t id, int32_t model);
+        bool castShadow(id_t id) const { return shadowFlags[indexOf(id)] != 0; }
+        void setCastShadow(id_t id, bool value) { shadowFlags[indexOf(id)] = value ? 1 : 0; }
+        const std::string &name(id_t id) const { return names[indexOf(id)]; }
+        void setName(id_t id, const std::string &newName) { names[indexOf(id)] = newName; }
+
+        // Returns false if the new parent is the object itself or one of its descendants
+        bool setParent(id_t id, id_t parent);
+        id_t parent(id_t id) const { return parentIds[indexOf(id)]; }
+
+        LightComponent *light(id_t id);
+        void addLight(id_t id, const LightComponent &light);
+        void removeLight(id_t id);
+
+        // Dense arrays, all indexed by the same dense index
+        const std::vector<id_t> &getIds() const { return ids; }
+        const std::vector<TransformComponent> &getTransforms() const { return transforms; }
+        const std::vector<glm::mat4> &getWorldMatrices() const { return worldMatrices; }
+        const std::vector<int32_t> &getModels() const { return models; }
+        const std::vector<uint8_t> &getShadowFlags() const { return shadowFlags; }
+        const std::vector<uint32_t> &getParentIndices() const { return parentIndices; }
+
+        // Lights are packed separately, lightOwners maps a light back to its game object
+        std::vector<LightComponent> &getLights() { return lights; }
+        const std::vector<id_t> &getLightOwners() const { return lightOwners; }
+
+        // Rebuilds the world matrix of every transform edited since the last call, and of their descendants.
+        // Independent root subtrees are spread over the thread pool when enough of them changed.
+        void updateWorldMatrices(GWThreadPool *threadPool = nullptr);
+
+        // Moves out the ids whose world bounds may have changed since the last call: inserted, erased,
+        // moved or given another model. Erased ids are the ones no longer contained.
+        void takeChangedIds(std::vector<id_t> &out);
+
+        std::string toJson(id_t id) const;
+
+    private:
+        void sortHierarchy();
+        void updateRange(size_t begin, size_t end);
+        void markChanged(id_t id);
+
+        std::vector<uint32_t> sparse; // id -> dense index
+        std::vector<id_t> ids;
+        std::vector<TransformComponent> transforms;
+        std::vector<glm::mat4> worldMatrices;
+        std::vector<uint8_t> dirtyFlags;
+        uint32_t dirtyCount{0};
+        std::vector<int32_t> models;
+        std::vector<uint8_t> shadowFlags;
+        std::vector<std::string> names;
+
+        std::vector<id_t> parentIds;
+        std::vector<uint32_t> parentIndices; // dense index of the parent, valid once sorted
+        std::vector<uint32_t> rootIndices;   // first dense index of every root subtree
+        bool hierarchyDirty{false};
+
+        std::vector<uint32_t> lightSparse; // id -> light index
+        std::vector<LightComponent> lights;
+        std::vector<id_t> lightOwners;
+
+        std::vector<id_t> changedIds;
+        std::vector<uint8_t> changedMarks; // by id
+        std::mutex changedMutex;
+    };
+}
@@ -2,7 +2,8 @@
 
 #include <volk/volk.h>
 #include "GWCamera.hpp"
-#include "GWGameObject.hpp"
+#include "GWEntityStore.hpp"
+#include "GWBVH.hpp"
 #include <vector>
 #include <array>
 
@@ -45,6 +46,8 @@ namespace GWIN
         glm::mat4 sunLightSpaceMatrix{0.f};
         DeviceAddress light;
         DeviceAddress material;
+        DeviceAddress instances;
+        DeviceAddress visibleInstances;
         float exposure;
         bool renderShadows;
     };
@@ -52,14 +55,37 @@ namespace GWIN
     struct SceneInfo
     {
         GWCamera &currentCamera;
-        GWGameObject::map &gameObjects;
+        GWEntityStore &gameObjects;
         GWModel::map &meshes;
         VkDescriptorSet& textures;
+        GWGameObject::id_t skybox;
+        GWBVH &bvh;
     };
 
     struct FrameFlags
     {
-        bool frustumCulling{false};
+        bool frustumCulling{true};
+        bool occlusionCulling{true};
+        bool clusterCulling{true}; // cull the meshlets of full detail meshes one by one
+        float lodBias{1.f}; // screen error in pixels a LOD may have, 0 disables LODs
+    };
+
+    // Instance counts written by cull.comp, meshlet counts by clustercull.comp
+    struct CullStats
+    {
+        uint32_t drawnEarly;
+        uint32_t drawnLate;
+        uint32_t frustumCulled;
+        uint32_t occlusionCulled;
+        uint32_t meshletsDrawn;
+        uint32_t meshletsFrustumCulled;
+        uint32_t meshletsBackfaceCulled;
+    };
+
+    struct LodStats
+    {
+        uint32_t instances[MAX_MESH_LODS];
+        uint32_t triangles[MAX_MESH_LODS];
     };
 
     struct FrameInfo
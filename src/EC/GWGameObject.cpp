@@ -2,7 +2,7 @@
 
 namespace GWIN
 {
-    glm::mat4 TransformComponent::mat4()
+    glm::mat4 TransformComponent::mat4() const
     {
         glm::mat4 matrix(1.0f);
 
@@ -16,47 +16,16 @@ namespace GWIN
     GWGameObject GWGameObject::createLight(float intensity, float radius, glm::vec3 color)
     {
         GWGameObject gameObject = GWGameObject::createGameObject("PointLight");
-        gameObject.color = color;
-        gameObject.light = std::make_unique<LightComponent>();
-        gameObject.light->lightIntensity = intensity;
+        gameObject.light = LightComponent{color, intensity};
         return gameObject;
     }
 
     GWGameObject GWGameObject::createLight(float intensity, float radius, glm::vec3 color, float cutOffAngle)
     {
         GWGameObject gameObject = GWGameObject::createGameObject("SpotLight");
-        gameObject.color = color;
-        gameObject.light = std::make_unique<LightComponent>();
-        gameObject.light->lightIntensity = intensity;
+        gameObject.light = LightComponent{color, intensity};
         gameObject.light->cutOffAngle = cutOffAngle;
 
         return gameObject;
     }
-
-    std::string GWGameObject::toJson() const
-    {
-        nlohmann::json jsonObject;
-
-        jsonObject["id"] = id;
-        jsonObject["name"] = getName();
-        jsonObject["transform"] = {
-            {"translation", {transform.translation.x, transform.translation.y, transform.translation.z}},
-            {"rotation", {transform.rotation.x, transform.rotation.y, transform.rotation.z}},
-            {"scale", transform.scale.x, transform.scale.y, transform.scale.z}};
-
-        if (light)
-        {
-            jsonObject["color"] = {color.x, color.y, color.z};
-            
-            jsonObject["light"] = {
-                {"intensity", light->lightIntensity},
-                {"cutOffAngle", light->cutOffAngle}};
-        }
-        if (model != -1)
-        {
-            jsonObject["model"] = model;
-        }
-
-        return jsonObject.dump();
-    }
 }
\ No newline at end of file
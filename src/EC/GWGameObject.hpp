@@ -4,7 +4,7 @@
 #include <array>
 //std 
 #include <memory>
-#include <unordered_map>
+#include <optional>
 #include "../json.hpp"
 
 #define GLM_FORCE_RADIANS
@@ -50,13 +50,14 @@ namespace GWIN
             rotation = glm::normalize(glm::quat(glm::radians(angles)));
         }
 
-        glm::vec3 getRotation() { return glm::degrees(glm::eulerAngles(rotation)); };
+        glm::vec3 getRotation() const { return glm::degrees(glm::eulerAngles(rotation)); };
 
-        glm::mat4 mat4();
+        glm::mat4 mat4() const;
     };
 
     struct LightComponent
     {
+        glm::vec3 color{1.f};
         float lightIntensity = 1.f;
         float cutOffAngle = 0.0f;
     };
@@ -65,7 +66,6 @@ namespace GWIN
     {
         public:
         using id_t = unsigned int;
-        using map = std::unordered_map<id_t, GWGameObject>;
 
         GWGameObject() = default;
 
@@ -92,14 +92,11 @@ namespace GWIN
         std::string getName() const { return Objname; };
         void setName(std::string& newName) { Objname = newName; };
 
-        glm::vec3 color{};
         TransformComponent transform{};
         bool castShadow{true};
 
         int32_t model = -1; //ID of the mesh
-        std::unique_ptr<LightComponent> light = nullptr;
-
-        std::string toJson() const;
+        std::optional<LightComponent> light;
 
     private:
         static id_t currentID;
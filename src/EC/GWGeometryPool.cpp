@@ -0,0 +1,260 @@
+#include "GWGeometryPool.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#define CHUNK_VERTEX_CAPACITY (1u << 20)
+#define CHUNK_INDEX_CAPACITY (1u << 22)
+// A full meshlet holds around a hundred triangles, this leaves room for chunks of poorly connected meshes
+#define CHUNK_MESHLET_CAPACITY (1u << 17)
+
+namespace GWIN
+{
+    uint32_t GWRangeAllocator::allocate(uint32_t count)
+    {
+        if (count == 0)
+            return 0;
+
+        for (size_t i = 0; i < freeRanges.size(); ++i)
+        {
+            Range &range = freeRanges[i];
+            if (range.count < count)
+                continue;
+
+            uint32_t offset = range.offset;
+            range.offset += count;
+            range.count -= count;
+
+            if (range.count == 0)
+            {
+                freeRanges.erase(freeRanges.begin() + i);
+            }
+
+            return offset;
+        }
+
+        return INVALID_OFFSET;
+    }
+
+    void GWRangeAllocator::free(uint32_t offset, uint32_t count)
+    {
+        if (count == 0)
+            return;
+
+        auto next = std::lower_bound(freeRanges.begin(), freeRanges.end(), offset,
+                                     [](const Range &range, uint32_t value) { return range.offset < value; });
+        next = freeRanges.insert(next, {offset, count});
+
+        // Merge with the following range, then with the previous one
+        auto following = next + 1;
+        if (following != freeRanges.end() && next->offset + next->count == following->offset)
+        {
+            next->count += following->count;
+            freeRanges.erase(following);
+        }
+
+        if (next != freeRanges.begin())
+        {
+            auto previous = next - 1;
+            if (previous->offset + previous->count == next->offset)
+            {
+                previous->count += next->count;
+                freeRanges.erase(next);
+            }
+        }
+    }
+
+    GWGeometryPool::GWGeometryPool(GWinDevice &device, GWUploadManager &uploadManager, GWDeletionQueue &deletionQueue, VkDeviceSize vertexSize)
+        : device(device), uploadManager(uploadManager), deletionQueue(deletionQueue), vertexSize(vertexSize)
+    {
+        createChunk(CHUNK_VERTEX_CAPACITY, CHUNK_INDEX_CAPACITY, CHUNK_MESHLET_CAPACITY);
+    }
+
+    GWGeometryPool::~GWGeometryPool()
+    {
+        // The ranges go away with the buffers
+        deletionQueue.drop(this);
+    }
+
+    void GWGeometryPool::createChunk(uint32_t vertexCapacity, uint32_t indexCapacity, uint32_t meshletCapacity)
+    {
+        Chunk chunk{
+            std::make_unique<GWBuffer>(
+                device,
+                vertexSize,
+                vertexCapacity,
+                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VMA_MEMORY_USAGE_GPU_ONLY),
+            nullptr,
+            nullptr,
+            GWRangeAllocator{vertexCapacity},
+            IndexStream{nullptr, GWRangeAllocator{indexCapacity}},
+            IndexStream{nullptr, GWRangeAllocator{indexCapacity}},
+            GWRangeAllocator{meshletCapacity}};
+
+        chunks.push_back(std::move(chunk));
+    }
+
+    GWBuffer &GWGeometryPool::getIndexBuffer(Chunk &chunk, VkIndexType indexType)
+    {
+        IndexStream &stream = chunk.indices(indexType);
+
+        if (!stream.buffer)
+        {
+            stream.buffer = std::make_unique<GWBuffer>(
+                device,
+                indexSize(indexType),
+                stream.allocator.getCapacity(),
+                VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VMA_MEMORY_USAGE_GPU_ONLY);
+        }
+
+        return *stream.buffer;
+    }
+
+    GWGeometryPool::Allocation GWGeometryPool::allocate(uint32_t vertexCount, uint32_t indexCount, VkIndexType indexType, uint32_t meshletCount)
+    {
+        Allocation allocation{};
+        allocation.vertexCount = vertexCount;
+        allocation.indexCount = indexCount;
+        allocation.indexType = indexType;
+        allocation.meshletCount = meshletCount;
+
+        for (uint32_t i = 0; i <= chunks.size(); ++i)
+        {
+            if (i == chunks.size())
+            {
+                // Meshes larger than a whole chunk get a chunk of their own
+                createChunk(std::max(CHUNK_VERTEX_CAPACITY, vertexCount), std::max(CHUNK_INDEX_CAPACITY, indexCount),
+                            std::max(CHUNK_MESHLET_CAPACITY, meshletCount));
+            }
+
+            Chunk &chunk = chunks[i];
+
+            uint32_t vertexOffset = chunk.vertices.allocate(vertexCount);
+            if (vertexOffset == GWRangeAllocator::INVALID_OFFSET)
+                continue;
+
+            uint32_t firstIndex = chunk.indices(indexType).allocator.allocate(indexCount);
+            if (firstIndex == GWRangeAllocator::INVALID_OFFSET)
+            {
+                chunk.vertices.free(vertexOffset, vertexCount);
+                continue;
+            }
+
+            uint32_t firstMeshlet = chunk.meshlets.allocate(meshletCount);
+            if (firstMeshlet == GWRangeAllocator::INVALID_OFFSET)
+            {
+                chunk.vertices.free(vertexOffset, vertexCount);
+                chunk.indices(indexType).allocator.free(firstIndex, indexCount);
+                continue;
+            }
+
+            allocation.chunk = i;
+            allocation.vertexOffset = vertexOffset;
+            allocation.firstIndex = firstIndex;
+            allocation.firstMeshlet = firstMeshlet;
+            return allocation;
+        }
+
+        throw std::runtime_error("failed to allocate geometry!");
+    }
+
+    void GWGeometryPool::free(const Allocation &allocation)
+    {
+        deletionQueue.defer([this, allocation]()
+        {
+            Chunk &chunk = chunks[allocation.chunk];
+            chunk.vertices.free(allocation.vertexOffset, allocation.vertexCount);
+            chunk.indices(allocation.indexType).allocator.free(allocation.firstIndex, allocation.indexCount);
+            chunk.meshlets.free(allocation.firstMeshlet, allocation.meshletCount);
+        }, this);
+    }
+
+    UploadToken GWGeometryPool::upload(const Allocation &allocation, const void *vertices, const void *indices)
+    {
+        Chunk &chunk = chunks[allocation.chunk];
+
+        VkDeviceSize vertexBytes = vertexSize * allocation.vertexCount;
+        VkDeviceSize indexBytes = indexSize(allocation.indexType) * allocation.indexCount;
+
+        UploadToken token = uploadManager.uploadToBuffer(chunk.vertexBuffer->getBuffer(), vertexSize * allocation.vertexOffset, vertices, vertexBytes);
+        if (indexBytes > 0)
+        {
+            GWBuffer &indexBuffer = getIndexBuffer(chunk, allocation.indexType);
+            token = uploadManager.uploadToBuffer(indexBuffer.getBuffer(), indexSize(allocation.indexType) * allocation.firstIndex, indices, indexBytes);
+        }
+
+        return token;
+    }
+
+    UploadToken GWGeometryPool::uploadColors(const Allocation &allocation, const uint32_t *colors)
+    {
+        Chunk &chunk = chunks[allocation.chunk];
+
+        if (!chunk.colorBuffer)
+        {
+            chunk.colorBuffer = std::make_unique<GWBuffer>(
+                device,
+                sizeof(uint32_t),
+                chunk.vertices.getCapacity(),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                VMA_MEMORY_USAGE_GPU_ONLY);
+        }
+
+        VkDeviceSize colorBytes = sizeof(uint32_t) * allocation.vertexCount;
+
+        return uploadManager.uploadToBuffer(chunk.colorBuffer->getBuffer(), sizeof(uint32_t) * allocation.vertexOffset, colors, colorBytes);
+    }
+
+    UploadToken GWGeometryPool::uploadMeshlets(const Allocation &allocation, const Meshlet *meshlets)
+    {
+        if (allocation.meshletCount == 0)
+            return UploadToken::Complete;
+
+        Chunk &chunk = chunks[allocation.chunk];
+
+        if (!chunk.meshletBuffer)
+        {
+            chunk.meshletBuffer = std::make_unique<GWBuffer>(
+                device,
+                sizeof(Meshlet),
+                chunk.meshlets.getCapacity(),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                VMA_MEMORY_USAGE_GPU_ONLY);
+        }
+
+        VkDeviceSize meshletBytes = sizeof(Meshlet) * allocation.meshletCount;
+
+        return uploadManager.uploadToBuffer(chunk.meshletBuffer->getBuffer(), sizeof(Meshlet) * allocation.firstMeshlet, meshlets, meshletBytes);
+    }
+
+    DeviceAddress GWGeometryPool::getColorAddress(uint32_t chunk) const
+    {
+        auto &colorBuffer = chunks[chunk].colorBuffer;
+        return colorBuffer ? colorBuffer->getBufferDeviceAddress() : DeviceAddress::Invalid;
+    }
+
+    DeviceAddress GWGeometryPool::getMeshletAddress(const Allocation &allocation) const
+    {
+        auto &meshletBuffer = chunks[allocation.chunk].meshletBuffer;
+        if (!meshletBuffer || allocation.meshletCount == 0)
+            return DeviceAddress::Invalid;
+
+        return static_cast<DeviceAddress>(static_cast<uint64_t>(meshletBuffer->getBufferDeviceAddress()) + sizeof(Meshlet) * allocation.firstMeshlet);
+    }
+
+    void GWGeometryPool::bind(VkCommandBuffer commandBuffer, uint32_t chunk, VkIndexType indexType)
+    {
+        VkBuffer buffers[] = {chunks[chunk].vertexBuffer->getBuffer()};
+        VkDeviceSize offsets[] = {0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+
+        // Meshes without indices may be the only ones of their type in the chunk
+        auto &indexBuffer = chunks[chunk].indices(indexType).buffer;
+        if (indexBuffer)
+        {
+            vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, indexType);
+        }
+    }
+}
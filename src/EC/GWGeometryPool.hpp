@@ -0,0 +1,132 @@
+#pragma once
+
+#include "../GWDevice.hpp"
+#include "../GWBuffer.hpp"
+#include "../GWUploadManager.hpp"
+#include "../GWDeletionQueue.hpp"
+
+#include <glm/glm.hpp>
+
+// std
+#include <memory>
+#include <vector>
+
+namespace GWIN
+{
+    // First fit allocator over a range of elements, free ranges are kept sorted and merged
+    class GWRangeAllocator
+    {
+    public:
+        static constexpr uint32_t INVALID_OFFSET = UINT32_MAX;
+
+        explicit GWRangeAllocator(uint32_t capacity) : capacity(capacity), freeRanges{{0, capacity}} {}
+
+        // Returns INVALID_OFFSET when no free range is large enough
+        uint32_t allocate(uint32_t count);
+        void free(uint32_t offset, uint32_t count);
+
+        uint32_t getCapacity() const { return capacity; }
+
+    private:
+        struct Range
+        {
+            uint32_t offset;
+            uint32_t count;
+        };
+
+        uint32_t capacity;
+        std::vector<Range> freeRanges;
+    };
+
+    // Shared device local vertex and index buffers that every GWModel suballocates from.
+    // Geometry lives in chunks, each with one vertex buffer and a 16 and a 32 bit index buffer, so a renderer binds
+    // once per chunk and index type and draws with firstIndex and vertexOffset. A new chunk is only created when
+    // the existing ones are full. Meshes split into meshlets keep their descriptions in a storage stream of the chunk.
+    class GWGeometryPool
+    {
+    public:
+        struct Allocation
+        {
+            uint32_t chunk{0};
+            uint32_t vertexOffset{0};
+            uint32_t vertexCount{0};
+            uint32_t firstIndex{0}; // in elements of indexType
+            uint32_t indexCount{0};
+            VkIndexType indexType{VK_INDEX_TYPE_UINT32};
+            uint32_t firstMeshlet{0};
+            uint32_t meshletCount{0};
+        };
+
+        // Matches Meshlet in clustercull.comp (std430), bounds are local space and the range is absolute in the chunk
+        struct Meshlet
+        {
+            glm::vec4 sphere; // center and radius
+            glm::vec4 cone;   // axis and cosine cutoff, negative when the meshlet can't be back facing as a whole
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            int32_t vertexOffset;
+            uint32_t padding;
+        };
+
+        static VkDeviceSize indexSize(VkIndexType indexType) { return indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t); }
+
+        GWGeometryPool(GWinDevice &device, GWUploadManager &uploadManager, GWDeletionQueue &deletionQueue, VkDeviceSize vertexSize);
+        ~GWGeometryPool();
+
+        GWGeometryPool(const GWGeometryPool &) = delete;
+        GWGeometryPool &operator=(const GWGeometryPool &) = delete;
+
+        Allocation allocate(uint32_t vertexCount, uint32_t indexCount, VkIndexType indexType, uint32_t meshletCount = 0);
+        // The ranges are handed out again once the frames in flight are done drawing from them
+        void free(const Allocation &allocation);
+
+        // Uploads are staged right away and reach the GPU with the upload manager's next flush.
+        // indices are uint16_t or uint32_t depending on the index type of the allocation
+        UploadToken upload(const Allocation &allocation, const void *vertices, const void *indices);
+        // Optional per vertex RGBA8 stream next to the vertex buffer, created the first time a chunk needs it
+        UploadToken uploadColors(const Allocation &allocation, const uint32_t *colors);
+        // Stream of the chunk's meshlets, also created the first time a chunk needs it
+        UploadToken uploadMeshlets(const Allocation &allocation, const Meshlet *meshlets);
+
+        DeviceAddress getColorAddress(uint32_t chunk) const;
+        // Address of the first meshlet of the allocation, Invalid when it has none
+        DeviceAddress getMeshletAddress(const Allocation &allocation) const;
+
+        void bind(VkCommandBuffer commandBuffer, uint32_t chunk, VkIndexType indexType);
+
+        uint32_t getChunkCount() const { return static_cast<uint32_t>(chunks.size()); }
+
+    private:
+        // Index buffer of one type, created the first time a mesh of that type lands in the chunk
+        struct IndexStream
+        {
+            std::unique_ptr<GWBuffer> buffer;
+            GWRangeAllocator allocator;
+        };
+
+        struct Chunk
+        {
+            std::unique_ptr<GWBuffer> vertexBuffer;
+            std::unique_ptr<GWBuffer> colorBuffer;
+            std::unique_ptr<GWBuffer> meshletBuffer;
+            GWRangeAllocator vertices;
+            IndexStream indices16;
+            IndexStream indices32;
+            GWRangeAllocator meshlets;
+
+            IndexStream &indices(VkIndexType indexType) { return indexType == VK_INDEX_TYPE_UINT16 ? indices16 : indices32; }
+        };
+
+        void createChunk(uint32_t vertexCapacity, uint32_t indexCapacity, uint32_t meshletCapacity);
+        GWBuffer &getIndexBuffer(Chunk &chunk, VkIndexType indexType);
+
+        GWinDevice &device;
+        GWUploadManager &uploadManager;
+        GWDeletionQueue &deletionQueue;
+        VkDeviceSize vertexSize;
+
+        std::vector<Chunk> chunks;
+    };
+
+    static_assert(sizeof(GWGeometryPool::Meshlet) == 48, "Meshlet must match the std430 layout in clustercull.comp");
+}
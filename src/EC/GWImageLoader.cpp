@@ -1,5 +1,6 @@
 #define NOMINMAX
 #include "GWImageLoader.hpp"
+#include "Components/TextureCompressor.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/std_image.hpp"
@@ -11,35 +12,114 @@
 
 namespace GWIN
 {
-    GWImageLoader::GWImageLoader(GWinDevice &device) : device(device) {}
+    GWImageLoader::GWImageLoader(GWinDevice &device, GWUploadManager &uploadManager, GWDeletionQueue &deletionQueue)
+        : device(device), uploadManager(uploadManager), deletionQueue(deletionQueue) {}
 
     GWImageLoader::~GWImageLoader() 
     {
-        for (const auto &image : imagesForDeletion)
+        for (const auto &[id, image] : imagesForDeletion)
         {
+            uploadManager.wait(image.upload);
             vkDestroyImageView(device.device(), image.imageView, nullptr);
             vmaDestroyImage(device.getAllocator(), image.image, image.allocation);
         }
     }
 
-    Image GWImageLoader::loadImage(const std::string &filepath, bool isMipMapped, VkFormat imageFormat)
+    DecodedImage GWImageLoader::decodeImage(const std::string &filepath)
     {
         int texWidth, texHeight, texChannels;
-        Image newImage{};
-        stbi_uc *pixels = stbi_load(filepath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-        if (!pixels)
+        DecodedImage decoded{};
+
+        decoded.pixels.reset(stbi_load(filepath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha));
+        if (!decoded.pixels)
         {
-            std::cout << "Failed to load Image!";
-            return newImage;
+            std::cout << "Failed to load Image " << filepath << std::endl;
+            return decoded;
+        }
+
+        decoded.size = {static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight)};
+        return decoded;
+    }
+
+    DecodedImage GWImageLoader::compressImage(const DecodedImage &decoded, VkFormat blockFormat)
+    {
+        TextureCompressor::BlockFormat format;
+        TextureCompressor::MipFilter filter;
+
+        switch (blockFormat)
+        {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            format = TextureCompressor::BlockFormat::BC1;
+            filter = TextureCompressor::MipFilter::Linear;
+            break;
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            format = TextureCompressor::BlockFormat::BC1;
+            filter = TextureCompressor::MipFilter::Srgb;
+            break;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            format = TextureCompressor::BlockFormat::BC5;
+            filter = TextureCompressor::MipFilter::Normal;
+            break;
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+            format = TextureCompressor::BlockFormat::BC7;
+            filter = TextureCompressor::MipFilter::Linear;
+            break;
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            format = TextureCompressor::BlockFormat::BC7;
+            filter = TextureCompressor::MipFilter::Srgb;
+            break;
+        default:
+            throw std::runtime_error("unsupported block format for texture compression!");
         }
 
-        VkDeviceSize imageSize = texWidth * texHeight * 4;
+        DecodedImage compressed{};
+        if (!decoded.pixels)
+            return compressed;
 
-        newImage.size = {static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight)};
+        TextureCompressor::Level base{decoded.size.width, decoded.size.height, {}};
+        base.rgba.assign(decoded.pixels.get(), decoded.pixels.get() + decoded.byteSize());
+
+        std::vector<TextureCompressor::Level> levels = TextureCompressor::buildMipChain(std::move(base), filter);
+
+        size_t totalSize = 0;
+        for (const TextureCompressor::Level &level : levels)
+        {
+            compressed.levelOffsets.push_back(totalSize);
+            totalSize += TextureCompressor::compressedSize(format, level.width, level.height);
+        }
+
+        compressed.blocks.resize(totalSize);
+        for (size_t i = 0; i < levels.size(); ++i)
+        {
+            TextureCompressor::compress(compressed.blocks.data() + compressed.levelOffsets[i], levels[i], format);
+        }
+
+        compressed.size = decoded.size;
+        compressed.blockFormat = blockFormat;
+        return compressed;
+    }
+
+    Image GWImageLoader::loadImage(const std::string &filepath, bool isMipMapped, VkFormat imageFormat)
+    {
+        return uploadImage(decodeImage(filepath), isMipMapped, imageFormat);
+    }
+
+    Image GWImageLoader::uploadImage(const DecodedImage &decoded, bool isMipMapped, VkFormat imageFormat)
+    {
+        if (decoded.isCompressed())
+            return uploadCompressedImage(decoded);
+
+        Image newImage{};
+        if (!decoded.pixels)
+            return newImage;
+
+        VkDeviceSize imageSize = decoded.byteSize();
+
+        newImage.size = decoded.size;
         newImage.format = imageFormat;
         newImage.layout = VK_IMAGE_LAYOUT_UNDEFINED;
         newImage.mipLevels = 
-        isMipMapped ? newImage.mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1 : 1;
+        isMipMapped ? static_cast<uint32_t>(std::floor(std::log2(std::max(decoded.size.width, decoded.size.height)))) + 1 : 1;
 
         VkImage image;
         VmaAllocation allocation;
@@ -49,54 +129,96 @@ namespace GWIN
         newImage.allocation = allocation;
         newImage.image = image;
 
-        GWBuffer stagingBuffer{
-            device,
-            imageSize,
-            1,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VMA_MEMORY_USAGE_CPU_ONLY};
-
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer(pixels, imageSize);
-        stagingBuffer.unmap();
-
         createImageView(newImage);
 
-        stbi_image_free(pixels);
+        VkBufferImageCopy region{};
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = {newImage.size.width, newImage.size.height, 1};
 
-        transitionImageLayout(newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        // Only the base level is copied, the blits that fill the rest run on the graphics queue
+        VkImageSubresourceRange baseLevel{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        VkImageLayout copiedLayout = newImage.mipLevels > 1 ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-        device.copyBufferToImage(stagingBuffer.getBuffer(), image, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), 1);
+        newImage.upload = uploadManager.uploadToImage(image, baseLevel, decoded.pixels.get(), imageSize, {region}, copiedLayout);
+        newImage.layout = copiedLayout;
 
-        if (isMipMapped)
+        if (newImage.mipLevels > 1)
             generateMipMaps(newImage);
 
-        transitionImageLayout(newImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
         newImage.id = ++lastImageID;
 
-        imagesForDeletion.push_back(newImage);
+        imagesForDeletion.emplace(newImage.id, newImage);
 
         return newImage;
     }
 
-    void GWImageLoader::destroyImage(uint32_t id)
+    Image GWImageLoader::uploadCompressedImage(const DecodedImage &decoded)
     {
-        auto &image = imagesForDeletion.at(id - 1);
+        Image newImage{};
+        if (decoded.blocks.empty())
+            return newImage;
+
+        VkDeviceSize imageSize = decoded.byteSize();
+
+        newImage.size = decoded.size;
+        newImage.format = decoded.blockFormat;
+        newImage.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        newImage.mipLevels = static_cast<uint32_t>(decoded.levelOffsets.size());
+
+        createImage(newImage.size, imageSize, newImage.format, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VMA_MEMORY_USAGE_GPU_ONLY, newImage.image, newImage.allocation, newImage.mipLevels);
+
+        createImageView(newImage);
 
-        if (image.imageView != VK_NULL_HANDLE)
+        // Every level is already cooked, so they all go over in one copy and no blits are needed
+        std::vector<VkBufferImageCopy> regions(newImage.mipLevels);
+        for (uint32_t level = 0; level < newImage.mipLevels; ++level)
         {
-            vkDestroyImageView(device.device(), image.imageView, nullptr);
-            image.imageView = VK_NULL_HANDLE;
+            VkBufferImageCopy &region = regions[level];
+            region.bufferOffset = decoded.levelOffsets[level];
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = level;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = {std::max(newImage.size.width >> level, 1u), std::max(newImage.size.height >> level, 1u), 1};
         }
 
-        if (image.image != VK_NULL_HANDLE)
+        VkImageSubresourceRange levels{VK_IMAGE_ASPECT_COLOR_BIT, 0, newImage.mipLevels, 0, 1};
+        newImage.upload = uploadManager.uploadToImage(newImage.image, levels, decoded.blocks.data(), imageSize, regions, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        newImage.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        newImage.id = ++lastImageID;
+
+        imagesForDeletion.emplace(newImage.id, newImage);
+
+        return newImage;
+    }
+
+    void GWImageLoader::destroyImage(uint32_t id)
+    {
+        // Images that failed to load were never registered
+        auto it = imagesForDeletion.find(id);
+        if (it == imagesForDeletion.end())
+            return;
+
+        Image &image = it->second;
+
+        // A batch that was never submitted may still copy into it
+        uploadManager.wait(image.upload);
+
+        // The loader may be gone by the time the frames are done, so only the handles are kept
+        deletionQueue.defer([&device = device, imageView = image.imageView, handle = image.image, allocation = image.allocation]()
         {
-            vmaDestroyImage(device.getAllocator(), image.image, image.allocation);
-            image.image = VK_NULL_HANDLE;
-        }
+            if (imageView != VK_NULL_HANDLE)
+                vkDestroyImageView(device.device(), imageView, nullptr);
+
+            if (handle != VK_NULL_HANDLE)
+                vmaDestroyImage(device.getAllocator(), handle, allocation);
+        });
 
-        imagesForDeletion.erase(imagesForDeletion.begin() + id);
+        imagesForDeletion.erase(it);
     }
 
     void GWImageLoader::createImage(
@@ -142,6 +264,12 @@ namespace GWIN
         viewInfo.subresourceRange.baseArrayLayer = 0;
         viewInfo.subresourceRange.layerCount = 1;
 
+        // BC5 only stores the normal's x and y, the shader rebuilds z for instances flagged as having such a normal map
+        if (image.format == VK_FORMAT_BC5_UNORM_BLOCK)
+        {
+            viewInfo.components = {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_ONE, VK_COMPONENT_SWIZZLE_ONE};
+        }
+
         if (vkCreateImageView(device.device(), &viewInfo, nullptr, &image.imageView) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to create texture image view!");
@@ -150,8 +278,6 @@ namespace GWIN
 
     void GWImageLoader::transitionImageLayout(Image &image, VkImageLayout newLayout)
     {
-        VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
-
         VkImageMemoryBarrier barrier{};
         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
         barrier.oldLayout = image.layout;
@@ -189,73 +315,110 @@ namespace GWIN
             throw std::invalid_argument("unsupported layout transition!");
         }
 
-        vkCmdPipelineBarrier(
-            commandBuffer,
-            sourceStage, destinationStage,
-            0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
-
-        device.endSingleTimeCommands(commandBuffer);
+        image.upload = uploadManager.recordGraphics([=](VkCommandBuffer commandBuffer)
+        {
+            vkCmdPipelineBarrier(
+                commandBuffer,
+                sourceStage, destinationStage,
+                0,
+                0, nullptr,
+                0, nullptr,
+                1, &barrier);
+        });
 
         image.layout = newLayout;
     }
 
     void GWImageLoader::generateMipMaps(Image &image)
     {
-        VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
-
-        VkImageMemoryBarrier barrier{};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.image = image.image;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-        barrier.subresourceRange.levelCount = 1;
-
-        int32_t mipWidth = static_cast<int32_t>(image.size.width);
-        int32_t mipHeight = static_cast<int32_t>(image.size.height);
+        // Runs after the base level is acquired, the other levels have not been touched yet
+        VkImage target = image.image;
+        VkExtent2D size = image.size;
+        uint32_t mipLevels = image.mipLevels;
 
-        for (uint32_t i = 1; i < image.mipLevels; i++)
+        image.upload = uploadManager.recordGraphics([target, size, mipLevels](VkCommandBuffer commandBuffer)
         {
-            barrier.subresourceRange.baseMipLevel = i - 1;
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.image = target;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = 1;
+            barrier.subresourceRange.baseMipLevel = 1;
+            barrier.subresourceRange.levelCount = mipLevels - 1;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 
             vkCmdPipelineBarrier(commandBuffer,
-                                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                 VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
                                  0, nullptr,
                                  0, nullptr,
                                  1, &barrier);
 
-            VkImageBlit blit{};
-            blit.srcOffsets[0] = {0, 0, 0};
-            blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
-            blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.srcSubresource.mipLevel = i - 1;
-            blit.srcSubresource.baseArrayLayer = 0;
-            blit.srcSubresource.layerCount = 1;
-            blit.dstOffsets[0] = {0, 0, 0};
-            blit.dstOffsets[1] = {mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1};
-            blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.dstSubresource.mipLevel = i;
-            blit.dstSubresource.baseArrayLayer = 0;
-            blit.dstSubresource.layerCount = 1;
-
-            vkCmdBlitImage(commandBuffer,
-                           image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                           image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                           1, &blit,
-                           VK_FILTER_LINEAR);
-
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barrier.subresourceRange.levelCount = 1;
+
+            int32_t mipWidth = static_cast<int32_t>(size.width);
+            int32_t mipHeight = static_cast<int32_t>(size.height);
+
+            for (uint32_t i = 1; i < mipLevels; i++)
+            {
+                barrier.subresourceRange.baseMipLevel = i - 1;
+                barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+                barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+                vkCmdPipelineBarrier(commandBuffer,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                     0, nullptr,
+                                     0, nullptr,
+                                     1, &barrier);
+
+                VkImageBlit blit{};
+                blit.srcOffsets[0] = {0, 0, 0};
+                blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
+                blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                blit.srcSubresource.mipLevel = i - 1;
+                blit.srcSubresource.baseArrayLayer = 0;
+                blit.srcSubresource.layerCount = 1;
+                blit.dstOffsets[0] = {0, 0, 0};
+                blit.dstOffsets[1] = {mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1};
+                blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                blit.dstSubresource.mipLevel = i;
+                blit.dstSubresource.baseArrayLayer = 0;
+                blit.dstSubresource.layerCount = 1;
+
+                vkCmdBlitImage(commandBuffer,
+                               target, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               1, &blit,
+                               VK_FILTER_LINEAR);
+
+                barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+                barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+                vkCmdPipelineBarrier(commandBuffer,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                                     0, nullptr,
+                                     0, nullptr,
+                                     1, &barrier);
+
+                if (mipWidth > 1)
+                    mipWidth /= 2;
+                if (mipHeight > 1)
+                    mipHeight /= 2;
+            }
+
+            barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
             barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
             barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
             vkCmdPipelineBarrier(commandBuffer,
@@ -263,25 +426,9 @@ namespace GWIN
                                  0, nullptr,
                                  0, nullptr,
                                  1, &barrier);
+        });
 
-            if (mipWidth > 1)
-                mipWidth /= 2;
-            if (mipHeight > 1)
-                mipHeight /= 2;
-        }
-
-        barrier.subresourceRange.baseMipLevel = image.mipLevels - 1;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(commandBuffer,
-                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-                             0, nullptr,
-                             0, nullptr,
-                             1, &barrier);
-
-        device.endSingleTimeCommands(commandBuffer);
+        // The blits leave every level ready for sampling
+        image.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     }
 }
@@ -3,10 +3,15 @@
 #include "stb/std_image.hpp"
 #include "stb/stb_image_write.h"
 
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "../GWDevice.hpp"
 #include "../GWBuffer.hpp"
+#include "../GWUploadManager.hpp"
+#include "../GWDeletionQueue.hpp"
 #include "vma/vk_mem_alloc.h"
 
 namespace GWIN
@@ -21,21 +26,50 @@ namespace GWIN
         VkImageView imageView;
         VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED};
         uint32_t id;
+        UploadToken upload{UploadToken::Complete}; // last upload work recorded for the image
+    };
+
+    // Pixels of an image file as RGBA8, empty when the file could not be decoded.
+    // Cooked images hold every mip level block compressed instead, base level first, and upload as they are.
+    struct DecodedImage
+    {
+        std::unique_ptr<stbi_uc, void (*)(void *)> pixels{nullptr, stbi_image_free};
+        VkExtent2D size{0, 0};
+
+        VkFormat blockFormat{VK_FORMAT_UNDEFINED};
+        std::vector<uint8_t> blocks;
+        std::vector<VkDeviceSize> levelOffsets; // start of each level in blocks
+
+        bool isCompressed() const { return blockFormat != VK_FORMAT_UNDEFINED; }
+        bool isEmpty() const { return !pixels && blocks.empty(); }
+        VkDeviceSize byteSize() const { return isCompressed() ? blocks.size() : VkDeviceSize(size.width) * size.height * 4; }
     };
 
     class GWImageLoader
     {
     public:
-        GWImageLoader(GWinDevice &device);
+        GWImageLoader(GWinDevice &device, GWUploadManager &uploadManager, GWDeletionQueue &deletionQueue);
         ~GWImageLoader();
 
+        // Touches no loader or device state, so files can be decoded on any thread
+        static DecodedImage decodeImage(const std::string &filepath);
+        // Full mip chain of decoded pixels compressed to a BC1, BC5 or BC7 format, also free of loader state
+        static DecodedImage compressImage(const DecodedImage &decoded, VkFormat blockFormat);
+
         Image loadImage(const std::string &filepath, bool isMipMapped, VkFormat imageFormat = VK_FORMAT_R8G8B8A8_SRGB);
+        // Records the upload into the upload manager's open batch, the image is ready for sampling once the batch is ready
+        Image uploadImage(const DecodedImage &decoded, bool isMipMapped, VkFormat imageFormat = VK_FORMAT_R8G8B8A8_SRGB);
 
         void transitionImageLayout(Image &image, VkImageLayout newLayout);
+        // An image shared with a load still streaming in is needed by the next frame after all
+        void requireImage(const Image &image) { uploadManager.require(image.upload); }
+        // The image itself is destroyed once the frames in flight are done with it
         void destroyImage(uint32_t id);
 
     private:
         GWinDevice& device;
+        GWUploadManager& uploadManager;
+        GWDeletionQueue& deletionQueue;
 
         void createImage(
             VkExtent2D imageProps,
@@ -47,10 +81,12 @@ namespace GWIN
             VmaAllocation &allocation,
             uint32_t mipLevels);
 
+        Image uploadCompressedImage(const DecodedImage &decoded);
+
         void createImageView(Image& image);
         void generateMipMaps(Image& image);
 
-        std::vector<Image> imagesForDeletion;
+        std::unordered_map<uint32_t, Image> imagesForDeletion;
 
         uint32_t lastImageID = 0;
     };
@@ -0,0 +1,396 @@
+#include "GWMeshCache.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// std
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// Every section starts on this boundary so the mapped arrays can be used in place
+#define MESH_CACHE_ALIGNMENT 16
+
+namespace GWIN
+{
+    namespace
+    {
+        // Followed by the length of each dependency path, then the paths
+        struct FileHeader
+        {
+            char magic[4];
+            uint32_t version;
+            uint64_t sourceHash;
+            uint32_t meshCount;
+            uint32_t dependencyCount;
+            uint64_t dependencyHash;
+        };
+
+        // Followed by vertices, colors when hasColors, indices, levels, meshlets and the texture paths
+        struct MeshRecord
+        {
+            GWModel::Bounds bounds;
+            uint32_t vertexCount;
+            uint32_t indexCount;
+            uint32_t lodCount;
+            uint32_t meshletCount;
+            uint32_t hasColors;
+            uint32_t textureLengths[6];
+        };
+
+        constexpr char MAGIC[4] = {'G', 'W', 'M', 'C'};
+
+        constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+
+        size_t alignUp(size_t offset) { return (offset + MESH_CACHE_ALIGNMENT - 1) & ~size_t(MESH_CACHE_ALIGNMENT - 1); }
+
+        void mixHash(uint64_t &hash, const void *data, size_t count)
+        {
+            const uint8_t *bytes = static_cast<const uint8_t *>(data);
+            for (size_t i = 0; i < count; ++i)
+            {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+        }
+
+        // Index ranges of levels and meshlets are used for draws as they are, so they have to stay inside the mesh
+        bool rangeFits(uint32_t first, uint32_t count, uint32_t total)
+        {
+            return static_cast<uint64_t>(first) + count <= total;
+        }
+
+        // Walks the mapped file, every take fails once the file is shorter than its records claim
+        struct Reader
+        {
+            const char *data;
+            size_t size;
+            size_t offset{0};
+
+            template <typename T>
+            const T *take(size_t count)
+            {
+                offset = alignUp(offset);
+                if (offset > size || count * sizeof(T) > size - offset)
+                    return nullptr;
+
+                const T *result = reinterpret_cast<const T *>(data + offset);
+                offset += count * sizeof(T);
+                return result;
+            }
+        };
+
+        void writeSection(std::ofstream &file, const void *data, size_t bytes)
+        {
+            static const char zeros[MESH_CACHE_ALIGNMENT] = {};
+
+            size_t position = static_cast<size_t>(file.tellp());
+            file.write(zeros, alignUp(position) - position);
+            file.write(static_cast<const char *>(data), bytes);
+        }
+    }
+
+    GWMeshCache::CachedFile &GWMeshCache::CachedFile::operator=(CachedFile &&other) noexcept
+    {
+        if (this != &other)
+        {
+            unmap();
+            meshes = std::move(other.meshes);
+            std::swap(mappedData, other.mappedData);
+            std::swap(mappedSize, other.mappedSize);
+            std::swap(mappingHandle, other.mappingHandle);
+        }
+        return *this;
+    }
+
+    uint64_t GWMeshCache::hashSource(const std::string &source)
+    {
+        std::ifstream file{source, std::ios::binary};
+        if (!file.is_open())
+            return 0;
+
+        uint64_t hash = FNV_OFFSET;
+
+        // Texture paths are resolved relative to the source, so the same file elsewhere cooks differently
+        mixHash(hash, source.data(), source.size());
+
+        std::vector<char> buffer(1 << 16);
+        while (file)
+        {
+            file.read(buffer.data(), buffer.size());
+            mixHash(hash, buffer.data(), static_cast<size_t>(file.gcount()));
+        }
+
+        return hash;
+    }
+
+    uint64_t GWMeshCache::hashDependencies(const std::vector<std::string> &dependencies)
+    {
+        uint64_t hash = FNV_OFFSET;
+        for (const std::string &dependency : dependencies)
+        {
+            uint64_t dependencyHash = hashSource(dependency);
+            mixHash(hash, &dependencyHash, sizeof(dependencyHash));
+        }
+        return hash;
+    }
+
+    std::string GWMeshCache::pathOf(uint64_t sourceHash) const
+    {
+        std::ostringstream name;
+        name << directory << '/' << std::hex << std::setw(16) << std::setfill('0') << sourceHash << ".gwmesh";
+        return name.str();
+    }
+
+    void GWMeshCache::CachedFile::unmap()
+    {
+        if (!mappedData)
+            return;
+
+#ifdef _WIN32
+        UnmapViewOfFile(mappedData);
+        CloseHandle(static_cast<HANDLE>(mappingHandle));
+        mappingHandle = nullptr;
+#else
+        munmap(const_cast<char *>(mappedData), mappedSize);
+#endif
+
+        mappedData = nullptr;
+        mappedSize = 0;
+    }
+
+    bool GWMeshCache::load(uint64_t sourceHash, CachedFile &cachedFile) const
+    {
+        cachedFile = CachedFile{};
+
+        if (sourceHash == 0)
+            return false;
+
+        std::string path = pathOf(sourceHash);
+
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER fileSize{};
+        GetFileSizeEx(file, &fileSize);
+
+        HANDLE mapping = fileSize.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+        CloseHandle(file);
+        if (!mapping)
+            return false;
+
+        cachedFile.mappedData = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!cachedFile.mappedData)
+        {
+            CloseHandle(mapping);
+            return false;
+        }
+
+        cachedFile.mappingHandle = mapping;
+        cachedFile.mappedSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+        int file = open(path.c_str(), O_RDONLY);
+        if (file < 0)
+            return false;
+
+        struct stat fileStat{};
+        void *data = fstat(file, &fileStat) == 0 && fileStat.st_size > 0
+                         ? mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0)
+                         : MAP_FAILED;
+        close(file);
+        if (data == MAP_FAILED)
+            return false;
+
+        cachedFile.mappedData = static_cast<const char *>(data);
+        cachedFile.mappedSize = static_cast<size_t>(fileStat.st_size);
+#endif
+
+        Reader reader{cachedFile.mappedData, cachedFile.mappedSize};
+        std::vector<Entry> &meshes = cachedFile.meshes;
+
+        const FileHeader *header = reader.take<FileHeader>(1);
+        if (!header || std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+            header->version != MESH_CACHE_VERSION || header->sourceHash != sourceHash ||
+            header->meshCount > cachedFile.mappedSize / sizeof(MeshRecord))
+        {
+            cachedFile = CachedFile{};
+            return false;
+        }
+
+        const uint32_t *dependencyLengths = reader.take<uint32_t>(header->dependencyCount);
+        std::vector<std::string> dependencies(dependencyLengths ? header->dependencyCount : 0);
+        bool dependenciesRead = dependencyLengths != nullptr;
+        for (size_t i = 0; i < dependencies.size() && dependenciesRead; ++i)
+        {
+            const char *characters = reader.take<char>(dependencyLengths[i]);
+            dependenciesRead = characters != nullptr;
+            if (dependenciesRead)
+            {
+                dependencies[i].assign(characters, dependencyLengths[i]);
+            }
+        }
+
+        if (!dependenciesRead || hashDependencies(dependencies) != header->dependencyHash)
+        {
+            cachedFile = CachedFile{};
+            return false;
+        }
+
+        meshes.resize(header->meshCount);
+        for (Entry &entry : meshes)
+        {
+            const MeshRecord *record = reader.take<MeshRecord>(1);
+            if (!record || record->lodCount == 0 || record->lodCount > MAX_MESH_LODS)
+            {
+                cachedFile = CachedFile{};
+                return false;
+            }
+
+            GWModel::CookedMesh &mesh = entry.mesh;
+            mesh.bounds = record->bounds;
+            mesh.vertexCount = record->vertexCount;
+            mesh.indexCount = record->indexCount;
+            mesh.lodCount = record->lodCount;
+            mesh.meshletCount = record->meshletCount;
+
+            mesh.vertices = reader.take<GWModel::PackedVertex>(mesh.vertexCount);
+            mesh.colors = record->hasColors ? reader.take<uint32_t>(mesh.vertexCount) : nullptr;
+            mesh.indices = mesh.indexType() == VK_INDEX_TYPE_UINT16 ? static_cast<const void *>(reader.take<uint16_t>(mesh.indexCount))
+                                                                    : static_cast<const void *>(reader.take<uint32_t>(mesh.indexCount));
+            mesh.lods = reader.take<GWModel::Lod>(mesh.lodCount);
+            mesh.meshlets = reader.take<GWGeometryPool::Meshlet>(mesh.meshletCount);
+
+            bool complete = mesh.vertices && (mesh.colors || !record->hasColors) && mesh.indices && mesh.lods && mesh.meshlets;
+            for (uint32_t level = 0; level < mesh.lodCount && complete; ++level)
+            {
+                complete = rangeFits(mesh.lods[level].firstIndex, mesh.lods[level].indexCount, mesh.indexCount);
+            }
+            for (uint32_t meshlet = 0; meshlet < mesh.meshletCount && complete; ++meshlet)
+            {
+                complete = rangeFits(mesh.meshlets[meshlet].firstIndex, mesh.meshlets[meshlet].indexCount, mesh.indexCount);
+            }
+            for (size_t slot = 0; slot < entry.textures.size() && complete; ++slot)
+            {
+                const char *characters = reader.take<char>(record->textureLengths[slot]);
+                complete = characters != nullptr;
+                if (complete)
+                {
+                    entry.textures[slot].assign(characters, record->textureLengths[slot]);
+                }
+            }
+
+            if (!complete)
+            {
+                cachedFile = CachedFile{};
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void GWMeshCache::store(uint64_t sourceHash, const std::vector<std::string> &dependencies, const std::vector<Entry> &meshes) const
+    {
+        if (sourceHash == 0)
+            return;
+
+        // Two imports of the same file may store at the same time, each writes its own temporary file
+        static std::atomic<uint32_t> storeCount{0};
+
+        std::string path = pathOf(sourceHash);
+        std::string temporaryPath = path + "." + std::to_string(storeCount.fetch_add(1)) + ".tmp";
+
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+
+        {
+            std::ofstream file{temporaryPath, std::ios::binary | std::ios::trunc};
+            if (!file.is_open())
+            {
+                std::cout << "Failed to write mesh cache " << path << std::endl;
+                return;
+            }
+
+            FileHeader header{};
+            std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+            header.version = MESH_CACHE_VERSION;
+            header.sourceHash = sourceHash;
+            header.meshCount = static_cast<uint32_t>(meshes.size());
+            header.dependencyCount = static_cast<uint32_t>(dependencies.size());
+            header.dependencyHash = hashDependencies(dependencies);
+            writeSection(file, &header, sizeof(header));
+
+            std::vector<uint32_t> dependencyLengths;
+            for (const std::string &dependency : dependencies)
+            {
+                dependencyLengths.push_back(static_cast<uint32_t>(dependency.size()));
+            }
+            writeSection(file, dependencyLengths.data(), sizeof(uint32_t) * dependencyLengths.size());
+            for (const std::string &dependency : dependencies)
+            {
+                writeSection(file, dependency.data(), dependency.size());
+            }
+
+            for (const Entry &entry : meshes)
+            {
+                const GWModel::CookedMesh &mesh = entry.mesh;
+
+                MeshRecord record{};
+                record.bounds = mesh.bounds;
+                record.vertexCount = mesh.vertexCount;
+                record.indexCount = mesh.indexCount;
+                record.lodCount = mesh.lodCount;
+                record.meshletCount = mesh.meshletCount;
+                record.hasColors = mesh.colors ? 1 : 0;
+                for (size_t slot = 0; slot < entry.textures.size(); ++slot)
+                {
+                    record.textureLengths[slot] = static_cast<uint32_t>(entry.textures[slot].size());
+                }
+                writeSection(file, &record, sizeof(record));
+
+                writeSection(file, mesh.vertices, sizeof(GWModel::PackedVertex) * mesh.vertexCount);
+                if (mesh.colors)
+                {
+                    writeSection(file, mesh.colors, sizeof(uint32_t) * mesh.vertexCount);
+                }
+                writeSection(file, mesh.indices, GWGeometryPool::indexSize(mesh.indexType()) * mesh.indexCount);
+                writeSection(file, mesh.lods, sizeof(GWModel::Lod) * mesh.lodCount);
+                writeSection(file, mesh.meshlets, sizeof(GWGeometryPool::Meshlet) * mesh.meshletCount);
+                for (const std::string &texture : entry.textures)
+                {
+                    writeSection(file, texture.data(), texture.size());
+                }
+            }
+
+            if (!file)
+            {
+                std::cout << "Failed to write mesh cache " << path << std::endl;
+                file.close();
+                std::filesystem::remove(temporaryPath, error);
+                return;
+            }
+        }
+
+        // Readers only ever see complete files
+        std::filesystem::rename(temporaryPath, path, error);
+        if (error)
+        {
+            std::cout << "Failed to write mesh cache " << path << ": " << error.message() << std::endl;
+            std::filesystem::remove(temporaryPath, error);
+        }
+    }
+}
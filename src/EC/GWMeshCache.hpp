@@ -0,0 +1,72 @@
+#pragma once
+
+#include "GWModel.hpp"
+
+// std
+#include <array>
+#include <string>
+#include <vector>
+
+namespace GWIN
+{
+    // Cooked meshes of imported files on disk, so a file only goes through Assimp and the mesh optimizer once.
+    // Files are named after a hash of the source path and contents and hold every mesh of the source in upload
+    // layout. They also list the other files the import read (.mtl, .bin, ...) with a hash over their contents, a
+    // cooked file whose dependencies changed since is outdated. Loading maps the file and the meshes point straight
+    // into it, so loading is mostly reading.
+    // The cache holds no state besides its directory, so imports on several threads can use it at once.
+    // Bump MESH_CACHE_VERSION whenever the import or the cooked layout changes, older files are then ignored.
+    class GWMeshCache
+    {
+    public:
+        static constexpr uint32_t MESH_CACHE_VERSION = 2;
+
+        struct Entry
+        {
+            GWModel::CookedMesh mesh{};
+            std::array<std::string, 6> textures{}; // full path per texture slot of GWModel::Textures, empty when unused
+        };
+
+        // Mapped cooked file, its meshes point into the mapping and stay valid as long as it is alive
+        class CachedFile
+        {
+        public:
+            CachedFile() = default;
+            ~CachedFile() { unmap(); }
+
+            CachedFile(CachedFile &&other) noexcept { *this = std::move(other); }
+            CachedFile &operator=(CachedFile &&other) noexcept;
+
+            CachedFile(const CachedFile &) = delete;
+            CachedFile &operator=(const CachedFile &) = delete;
+
+            std::vector<Entry> meshes;
+
+        private:
+            friend class GWMeshCache;
+
+            void unmap();
+
+            const char *mappedData{nullptr};
+            size_t mappedSize{0};
+            void *mappingHandle{nullptr}; // file mapping object on Windows
+        };
+
+        explicit GWMeshCache(std::string directory = "cache/meshes") : directory(std::move(directory)) {}
+
+        // 64 bit FNV-1a of the path and the file's bytes, 0 when the file can't be read
+        static uint64_t hashSource(const std::string &source);
+
+        // False when there is no cooked file for the hash or it is outdated or damaged
+        bool load(uint64_t sourceHash, CachedFile &file) const;
+        // Failing to write only costs the next load its speed, so it is reported and otherwise ignored
+        void store(uint64_t sourceHash, const std::vector<std::string> &dependencies, const std::vector<Entry> &meshes) const;
+
+    private:
+        std::string pathOf(uint64_t sourceHash) const;
+        // Combined hashSource of every dependency, a missing one changes it as well
+        static uint64_t hashDependencies(const std::vector<std::string> &dependencies);
+
+        std::string directory;
+    };
+}
@@ -1,124 +1,236 @@
 #include "GWModel.hpp"
+#include "GWTextureHandler.hpp"
 
 // std
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstring>
 #include <iostream>
 
+#include <glm/gtc/packing.hpp>
+
 namespace GWIN
 {
-    GWModel::GWModel(GWinDevice &device, const Builder &builder) : device(device)
+    // Maps a unit vector onto the octahedron and unfolds it into [-1, 1]^2
+    static glm::vec2 encodeOctahedral(glm::vec3 v)
     {
-        createVertexBuffers(builder.vertices);
-        createIndexBuffers(builder.indices);
+        float sum = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+        if (sum == 0.f)
+            return glm::vec2(0.f);
+
+        glm::vec2 p = glm::vec2(v) / sum;
+        if (v.z < 0.f)
+        {
+            glm::vec2 sign{p.x >= 0.f ? 1.f : -1.f, p.y >= 0.f ? 1.f : -1.f};
+            p = (1.f - glm::abs(glm::vec2(p.y, p.x))) * sign;
+        }
+
+        return p;
     }
 
-    GWModel::~GWModel() {}
+    GWModel::PackedVertex GWModel::PackedVertex::pack(const Vertex &vertex)
+    {
+        PackedVertex packed{};
+        packed.position = vertex.position;
+        packed.normal = glm::packSnorm2x16(encodeOctahedral(vertex.normal));
+        packed.tangent = glm::packSnorm2x16(encodeOctahedral(vertex.tangent));
+        packed.uv = glm::packHalf2x16(vertex.uv);
+        return packed;
+    }
 
-    void GWModel::createVertexBuffers(const std::vector<Vertex> &vertices)
+    void GWModel::Bounds::merge(const Bounds &other)
     {
-        vertexCount = static_cast<uint32_t>(vertices.size());
-        assert(vertexCount >= 3 && "Number of vertices has to be atleast 3!");
-        uint32_t vertexSize = sizeof(vertices[0]);
-        VkDeviceSize bufferSize = vertexSize * vertexCount;
-
-        GWBuffer stagingBuffer{
-            device,
-            vertexSize,
-            vertexCount,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VMA_MEMORY_USAGE_CPU_TO_GPU,
-        };
-
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void*)vertices.data());
-
-        vertexBuffer = std::make_unique<GWBuffer>(
-            device,
-            vertexSize,
-            vertexCount,
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
-            VMA_MEMORY_USAGE_GPU_ONLY 
-        );
-
-        device.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+
+        // Keep the sphere enclosing both spheres, which is tighter than the merged box for long thin parts
+        glm::vec3 newCenter = (min + max) * 0.5f;
+        radius = std::max(glm::length(center - newCenter) + radius, glm::length(other.center - newCenter) + other.radius);
+        center = newCenter;
     }
 
-    void GWModel::createIndexBuffers(const std::vector<uint32_t> &indices)
+    GWModel::CookedStorage GWModel::CookedStorage::cook(const Builder &builder)
     {
-        indexCount = static_cast<uint32_t>(indices.size());
-        hasIndexBuffers = indexCount > 0;
+        CookedStorage cooked{};
+        cooked.bounds = builder.bounds;
+
+        uint32_t vertexCount = static_cast<uint32_t>(builder.vertices.size());
+        cooked.vertices.resize(vertexCount);
+        for (uint32_t i = 0; i < vertexCount; ++i)
+        {
+            cooked.vertices[i] = PackedVertex::pack(builder.vertices[i]);
+        }
+
+        if (builder.hasVertexColors)
+        {
+            cooked.colors.resize(vertexCount);
+            for (uint32_t i = 0; i < vertexCount; ++i)
+            {
+                cooked.colors[i] = glm::packUnorm4x8(glm::vec4(builder.vertices[i].color, 1.f));
+            }
+        }
+
+        // Every level goes into the same index range after the full mesh and shares its vertices
+        std::vector<uint32_t> indices = builder.indices;
+        cooked.lods.push_back({0, static_cast<uint32_t>(builder.indices.size()), 0.f});
+        for (const LodBuilder &lod : builder.lods)
+        {
+            cooked.lods.push_back({static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lod.indices.size()), lod.error});
+            indices.insert(indices.end(), lod.indices.begin(), lod.indices.end());
+        }
+
+        if (cooked.view().indexType() == VK_INDEX_TYPE_UINT16)
+        {
+            cooked.indices16.assign(indices.begin(), indices.end());
+        }
+        else
+        {
+            cooked.indices32 = std::move(indices);
+        }
 
-        if (!hasIndexBuffers)
+        cooked.meshlets.resize(builder.meshlets.size());
+        for (size_t i = 0; i < builder.meshlets.size(); ++i)
         {
-            return;
+            const MeshOptimizer::Meshlet &meshlet = builder.meshlets[i];
+            cooked.meshlets[i].sphere = glm::vec4(meshlet.center[0], meshlet.center[1], meshlet.center[2], meshlet.radius);
+            cooked.meshlets[i].cone = glm::vec4(meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2], meshlet.coneCutoff);
+            cooked.meshlets[i].firstIndex = meshlet.firstIndex;
+            cooked.meshlets[i].indexCount = meshlet.indexCount;
         }
 
-        uint32_t indexSize = sizeof(indices[0]);
-        VkDeviceSize bufferSize = indexSize * indexCount;
-
-        GWBuffer stagingBuffer{
-            device,
-            indexSize,
-            indexCount,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-            VMA_MEMORY_USAGE_CPU_TO_GPU,
-        };
-
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void*)indices.data());
-
-        indexBuffer = std::make_unique<GWBuffer>(
-            device,
-            indexSize,
-            indexCount,
-            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VMA_MEMORY_USAGE_GPU_ONLY 
-        );
-
-        device.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+        return cooked;
     }
 
+    GWModel::CookedMesh GWModel::CookedStorage::view() const
+    {
+        CookedMesh mesh{};
+        mesh.bounds = bounds;
+        mesh.vertices = vertices.data();
+        mesh.colors = colors.empty() ? nullptr : colors.data();
+        mesh.indices = indices16.empty() ? static_cast<const void *>(indices32.data()) : static_cast<const void *>(indices16.data());
+        mesh.lods = lods.data();
+        mesh.meshlets = meshlets.data();
+        mesh.vertexCount = static_cast<uint32_t>(vertices.size());
+        mesh.indexCount = static_cast<uint32_t>(indices16.size() + indices32.size());
+        mesh.lodCount = static_cast<uint32_t>(lods.size());
+        mesh.meshletCount = static_cast<uint32_t>(meshlets.size());
+        return mesh;
+    }
 
-    void GWModel::bind(VkCommandBuffer commandBuffer)
+    GWModel::GWModel(GWGeometryPool &geometryPool, const Builder &builder) : GWModel(geometryPool, CookedStorage::cook(builder).view())
+    {
+    }
+
+    GWModel::GWModel(GWGeometryPool &geometryPool, const CookedMesh &mesh) : geometryPool(geometryPool), bounds(mesh.bounds), totalBounds(mesh.bounds)
+    {
+        assert(mesh.vertexCount >= 3 && "Number of vertices has to be atleast 3!");
+        assert(mesh.lodCount >= 1 && mesh.lodCount <= MAX_MESH_LODS && "A mesh has between 1 and MAX_MESH_LODS levels!");
+
+        geometry = geometryPool.allocate(mesh.vertexCount, mesh.indexCount, mesh.indexType(), mesh.meshletCount);
+        geometryPool.upload(geometry, mesh.vertices, mesh.indices);
+
+        lods.assign(mesh.lods, mesh.lods + mesh.lodCount);
+        for (Lod &lod : lods)
+        {
+            lod.firstIndex += geometry.firstIndex;
+        }
+
+        if (mesh.meshletCount > 0)
+        {
+            std::vector<GWGeometryPool::Meshlet> meshlets(mesh.meshlets, mesh.meshlets + mesh.meshletCount);
+            for (GWGeometryPool::Meshlet &meshlet : meshlets)
+            {
+                meshlet.firstIndex += geometry.firstIndex;
+                meshlet.vertexOffset = static_cast<int32_t>(geometry.vertexOffset);
+            }
+
+            geometryPool.uploadMeshlets(geometry, meshlets.data());
+        }
+
+        hasVertexColors = mesh.colors != nullptr;
+        if (hasVertexColors)
+        {
+            geometryPool.uploadColors(geometry, mesh.colors);
+        }
+    }
+
+    GWModel::~GWModel()
+    {
+        geometryPool.free(geometry);
+    }
+
+    DeviceAddress GWModel::getVertexColorAddress() const
+    {
+        return hasVertexColors ? geometryPool.getColorAddress(geometry.chunk) : DeviceAddress::Invalid;
+    }
+
+    bool GWModel::hasTwoChannelNormals() const
+    {
+        const std::shared_ptr<const Texture> &normalMap = textureHandles[TEXTURE_TYPE_NORMAL];
+        return normalMap && normalMap->textureImage.format == VK_FORMAT_BC5_UNORM_BLOCK;
+    }
+
+    uint32_t GWModel::selectLod(const glm::mat4 &world, const glm::vec3 &cameraPosition, float projectionScale, float lodBias) const
     {
-        VkBuffer buffers[] = {vertexBuffer->getBuffer()};
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
-        if (hasIndexBuffers)
+        if (lods.size() == 1 || lodBias <= 0.f)
+            return 0;
+
+        float scale = std::max({glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))});
+        glm::vec3 center = glm::vec3(world * glm::vec4(bounds.center, 1.f));
+
+        // Distance to the nearest point of the bounding sphere, inside it the full mesh is used
+        float distance = glm::length(center - cameraPosition) - bounds.radius * scale;
+        if (distance <= 0.f)
+            return 0;
+
+        float pixelsPerUnit = scale * projectionScale / distance;
+
+        uint32_t selected = 0;
+        for (uint32_t lod = 1; lod < lods.size(); ++lod)
         {
-            vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+            if (lods[lod].error * pixelsPerUnit > lodBias)
+                break;
+
+            selected = lod;
         }
+
+        return selected;
+    }
+
+    void GWModel::bind(VkCommandBuffer commandBuffer)
+    {
+        geometryPool.bind(commandBuffer, geometry.chunk, geometry.indexType);
     }
 
-    void GWModel::draw(VkCommandBuffer commandBuffer)
+    void GWModel::draw(VkCommandBuffer commandBuffer, uint32_t lod)
     {
-        if (hasIndexBuffers)
+        if (geometry.indexCount > 0)
         {
-            vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+            vkCmdDrawIndexed(commandBuffer, lods[lod].indexCount, 1, lods[lod].firstIndex, static_cast<int32_t>(geometry.vertexOffset), 0);
         } else {
-            vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+            vkCmdDraw(commandBuffer, geometry.vertexCount, 1, geometry.vertexOffset, 0);
         }
     }
 
-    std::vector<VkVertexInputBindingDescription> GWModel::Vertex::getBindingDescriptions()
+    std::vector<VkVertexInputBindingDescription> GWModel::PackedVertex::getBindingDescriptions()
     {
         std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
         bindingDescriptions[0].binding = 0;
-        bindingDescriptions[0].stride = sizeof(Vertex);
+        bindingDescriptions[0].stride = sizeof(PackedVertex);
         bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
         return bindingDescriptions;
     }
 
-    std::vector<VkVertexInputAttributeDescription> GWModel::Vertex::getAttributeDescriptions()
+    std::vector<VkVertexInputAttributeDescription> GWModel::PackedVertex::getAttributeDescriptions()
     {
+        // Location 1 used to be the color, it now comes from the color stream
         std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
-        attributeDescriptions.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position)});
-        attributeDescriptions.push_back({1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color)});
-        attributeDescriptions.push_back({2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)});
-        attributeDescriptions.push_back({3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv)});
-        attributeDescriptions.push_back({4, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, tangent)});
+        attributeDescriptions.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(PackedVertex, position)});
+        attributeDescriptions.push_back({2, 0, VK_FORMAT_R16G16_SNORM, offsetof(PackedVertex, normal)});
+        attributeDescriptions.push_back({3, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedVertex, uv)});
+        attributeDescriptions.push_back({4, 0, VK_FORMAT_R16G16_SNORM, offsetof(PackedVertex, tangent)});
 
         return attributeDescriptions;
     }
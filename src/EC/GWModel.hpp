@@ -1,11 +1,13 @@
 #pragma once
 
 #include "../GWDevice.hpp"
-#include "../GWBuffer.hpp"
+#include "GWGeometryPool.hpp"
+#include "Components/MeshOptimizer.hpp"
 
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include <cmath>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -15,9 +17,16 @@
 
 namespace GWIN
 {
+    struct Texture;
+
+    #define MAX_MESH_LODS 4
+    // Screen height LOD errors are measured against, the bias scales the error allowed at this height
+    #define LOD_REFERENCE_HEIGHT 1080.f
+
     class GWModel
     {
     public:
+        // Full precision vertex the loader builds meshes from, packed into PackedVertex on upload
         struct Vertex
         {
             glm::vec3 position;
@@ -25,35 +34,118 @@ namespace GWIN
             glm::vec3 normal;
             glm::vec2 uv;
             glm::vec3 tangent;
+        };
+
+        // Vertex as stored in the geometry pool, 24 bytes instead of 56.
+        // Normal and tangent are octahedral encoded, colors live in a separate stream only meshes with vertex colors fill.
+        struct PackedVertex
+        {
+            glm::vec3 position;
+            uint32_t normal;  // 2x snorm16
+            uint32_t tangent; // 2x snorm16
+            uint32_t uv;      // 2x half
+
+            static PackedVertex pack(const Vertex &vertex);
 
             static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
             static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
         };
 
+        // Local space bounds, the sphere is centered on the box
+        struct Bounds
+        {
+            glm::vec3 min{0.f};
+            glm::vec3 max{0.f};
+            glm::vec3 center{0.f};
+            float radius{0.f};
+
+            void merge(const Bounds &other);
+        };
+
+        // Range of the mesh's indices drawing one level of detail, error is the local space distance it deviates by
+        struct Lod
+        {
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            float error;
+        };
+
+        struct LodBuilder
+        {
+            std::vector<uint32_t> indices{};
+            float error{0.f};
+        };
+
         struct Builder
         {
             std::vector<Vertex> vertices{};
             std::vector<uint32_t> indices{};
+            Bounds bounds{};
+            bool hasVertexColors{false};
+            std::vector<LodBuilder> lods{}; // simplified levels after indices, coarser each
+            std::vector<MeshOptimizer::Meshlet> meshlets{}; // ranges of indices, empty when the mesh isn't split
+        };
+
+        // Mesh in the layout it is uploaded in. The arrays may point straight into a mapped mesh cache file.
+        struct CookedMesh
+        {
+            Bounds bounds{};
+            const PackedVertex *vertices{nullptr};
+            const uint32_t *colors{nullptr};  // RGBA8, nullptr when the mesh has no vertex colors
+            const void *indices{nullptr};     // every level after the full mesh, uint16_t or uint32_t as indexType() says
+            const Lod *lods{nullptr};         // first indices relative to the mesh
+            const GWGeometryPool::Meshlet *meshlets{nullptr}; // index ranges relative to the mesh, vertexOffset 0
+            uint32_t vertexCount{0};
+            uint32_t indexCount{0};
+            uint32_t lodCount{0};
+            uint32_t meshletCount{0};
+
+            // Indices are relative to vertexOffset, so only the vertex count of the mesh limits the index type
+            VkIndexType indexType() const { return vertexCount <= UINT16_MAX + 1u ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32; }
+        };
+
+        // Owns the arrays of a CookedMesh made from a Builder
+        struct CookedStorage
+        {
+            Bounds bounds{};
+            std::vector<PackedVertex> vertices{};
+            std::vector<uint32_t> colors{};
+            std::vector<uint16_t> indices16{};
+            std::vector<uint32_t> indices32{};
+            std::vector<Lod> lods{};
+            std::vector<GWGeometryPool::Meshlet> meshlets{};
+
+            static CookedStorage cook(const Builder &builder);
+            CookedMesh view() const;
         };
 
         using map = std::unordered_map<uint32_t, std::shared_ptr<GWModel>>;
 
-        GWModel(GWinDevice &device, const GWModel::Builder &builder);
+        GWModel(GWGeometryPool &geometryPool, const GWModel::Builder &builder);
+        GWModel(GWGeometryPool &geometryPool, const GWModel::CookedMesh &mesh);
         ~GWModel();
 
         GWModel(const GWModel &) = delete;
         GWModel &operator=(const GWModel &) = delete;
 
         void bind(VkCommandBuffer commandBuffer);
-        void draw(VkCommandBuffer commandBuffer);
+        void draw(VkCommandBuffer commandBuffer, uint32_t lod = 0);
         
-        void addSubModel(std::shared_ptr<GWModel>& model) { subModels.push_back(std::move(model)); }
+        void addSubModel(std::shared_ptr<GWModel>& model)
+        {
+            totalBounds.merge(model->getBounds());
+            subModels.push_back(std::move(model));
+        }
         bool hasSubModels() { return subModels.size() > 0; }
 
         std::vector<std::shared_ptr<GWModel>>& getSubModels() { return subModels; }
 
         std::string getPath() const { return pathToModel; }
 
+        const Bounds &getBounds() const { return bounds; }
+        // Bounds of this mesh together with all of its submodels
+        const Bounds &getTotalBounds() const { return totalBounds; }
+
         std::string toJson() const
         {
             nlohmann::json jsonObject;
@@ -68,26 +160,48 @@ namespace GWIN
 
         void setPath(const std::string path) { pathToModel = path; }
 
-        uint32_t numVertices() { return vertexCount; }
+        uint32_t numVertices() { return geometry.vertexCount; }
+        uint32_t numIndices() const { return lods[0].indexCount; }
+
+        uint32_t getLodCount() const { return static_cast<uint32_t>(lods.size()); }
+        const Lod &getLod(uint32_t lod) const { return lods[lod]; }
+
+        // Pixels one local unit covers per unit of distance, for projection at LOD_REFERENCE_HEIGHT
+        static float lodProjectionScale(const glm::mat4 &projection) { return std::abs(projection[1][1]) * 0.5f * LOD_REFERENCE_HEIGHT; }
+        // Coarsest level whose error projects to at most lodBias pixels, a bias of 0 always picks the full mesh
+        uint32_t selectLod(const glm::mat4 &world, const glm::vec3 &cameraPosition, float projectionScale, float lodBias) const;
+
+        // Location of the mesh inside the geometry pool, used to build indirect draws
+        uint32_t getGeometryChunk() const { return geometry.chunk; }
+        uint32_t getFirstIndex(uint32_t lod = 0) const { return lods[lod].firstIndex; }
+        // 16 bit whenever every vertex of the mesh can be addressed with it
+        VkIndexType getIndexType() const { return geometry.indexType; }
+        int32_t getVertexOffset() const { return static_cast<int32_t>(geometry.vertexOffset); }
+        // Color stream indexed by gl_VertexIndex, Invalid when the mesh has no vertex colors
+        DeviceAddress getVertexColorAddress() const;
+        // Normal map only stores x and y (BC5), the shader rebuilds z
+        bool hasTwoChannelNormals() const;
+        // Meshlets covering the full mesh, the coarser levels are drawn whole
+        uint32_t getMeshletCount() const { return geometry.meshletCount; }
+        DeviceAddress getMeshletAddress() const { return geometryPool.getMeshletAddress(geometry); }
 
         std::array<uint32_t, 6> Textures{1, 0, 1, 1, 1, 1}; // ID of the textures
+        std::array<std::shared_ptr<const Texture>, 6> textureHandles{}; // keeps the textures above alive, empty for the shared defaults
         uint32_t Material = 0; //ID of the material
     private:
-        void createVertexBuffers(const std::vector<Vertex> &vertices);
-        void createIndexBuffers(const std::vector<uint32_t> &indices);
-
-        GWinDevice &device;
+        GWGeometryPool &geometryPool;
 
         std::string pathToModel = "";
 
         std::vector<std::shared_ptr<GWModel>> subModels;
 
-        std::unique_ptr<GWBuffer> vertexBuffer;
-        uint32_t vertexCount;
-
-        std::unique_ptr<GWBuffer> indexBuffer;
-        uint32_t indexCount;
+        Bounds bounds{};
+        Bounds totalBounds{};
 
-        bool hasIndexBuffers{false};
+        GWGeometryPool::Allocation geometry{};
+        std::vector<Lod> lods;
+        bool hasVertexColors{false};
     };
-}
\ No newline at end of file
+
+    static_assert(sizeof(GWModel::PackedVertex) == 24, "PackedVertex must stay tightly packed");
+}
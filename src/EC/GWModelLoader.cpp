@@ -1,28 +1,127 @@
 #include "GWModelLoader.hpp"
 
+#include <assimp/DefaultIOSystem.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 
 namespace GWIN
 {
+    namespace
+    {
+        // Notes every file the importer reads besides the source (.mtl, .bin, ...), the mesh cache checks them on load
+        class RecordingIOSystem : public Assimp::DefaultIOSystem
+        {
+        public:
+            explicit RecordingIOSystem(std::string source) : source(std::move(source)) {}
+
+            Assimp::IOStream *Open(const char *file, const char *mode) override
+            {
+                Assimp::IOStream *stream = Assimp::DefaultIOSystem::Open(file, mode);
+                if (stream && file != source && std::find(opened.begin(), opened.end(), file) == opened.end())
+                {
+                    opened.emplace_back(file);
+                }
+                return stream;
+            }
+
+            std::vector<std::string> opened;
+
+        private:
+            std::string source;
+        };
+    }
+
     bool GWModelLoader::importFile(const std::string& pfile, std::shared_ptr<GWModel>& model)
     {
-        const aiScene *scene = importer.ReadFile(pfile,
-        aiProcess_CalcTangentSpace |
-        aiProcess_JoinIdenticalVertices |
-        aiProcess_Triangulate);
+        PendingImport pending = cookFile(pfile);
+        return finishImport(pending, model);
+    }
+
+    std::future<GWModelLoader::PendingImport> GWModelLoader::importFileAsync(const std::string &pfile)
+    {
+        return threadPool.submit([this, pfile]() { return cookFile(pfile); });
+    }
 
-        if (nullptr == scene)
+    GWModelLoader::PendingImport GWModelLoader::cookFile(const std::string &pfile) const
+    {
+        PendingImport pending{};
+        pending.path = pfile;
+
+        uint64_t sourceHash = GWMeshCache::hashSource(pfile);
+        if (!meshCache.load(sourceHash, pending.cached))
         {
-            std::cout << importer.GetErrorString();
+            // Importers keep the scene they read, so every import gets its own
+            Assimp::Importer importer;
+            RecordingIOSystem *ioSystem = new RecordingIOSystem(pfile); // owned by the importer
+            importer.SetIOHandler(ioSystem);
+
+            const aiScene *scene = importer.ReadFile(pfile,
+            aiProcess_CalcTangentSpace |
+            aiProcess_JoinIdenticalVertices |
+            aiProcess_Triangulate);
+
+            if (nullptr == scene)
+            {
+                std::cout << importer.GetErrorString();
+                return pending;
+            }
+
+            OptimizationStats stats{};
+            pending.imported = processScene(scene, pfile, stats);
+            importer.FreeScene();
+
+            reportOptimization(pfile, stats);
+
+            std::vector<GWMeshCache::Entry> entries(pending.imported.size());
+            for (size_t i = 0; i < pending.imported.size(); ++i)
+            {
+                entries[i].mesh = pending.imported[i].geometry.view();
+                entries[i].textures = pending.imported[i].textures;
+            }
+            meshCache.store(sourceHash, ioSystem->opened, entries);
+        }
+
+        // Decoding and compressing happen here as well, finishImport only uploads
+        pending.textures = textureHandler->prepareTextures(textureRequests(texturePathsOf(pending)));
+
+        pending.succeeded = true;
+        return pending;
+    }
+
+    bool GWModelLoader::finishImport(PendingImport &pending, std::shared_ptr<GWModel> &model)
+    {
+        if (!pending.succeeded)
             return false;
+
+        std::vector<std::shared_ptr<GWModel>> objects;
+
+        for (const GWMeshCache::Entry &entry : pending.cached.meshes)
+        {
+            objects.push_back(std::make_shared<GWModel>(geometryPool, entry.mesh));
+        }
+
+        for (const ImportedMesh &mesh : pending.imported)
+        {
+            objects.push_back(std::make_shared<GWModel>(geometryPool, mesh.geometry.view()));
         }
 
-        std::vector<std::shared_ptr<GWModel>> objects = processScene(scene, pfile);
+        applyTextures(objects, texturePathsOf(pending), pending.textures);
+
+        // The cooked data is in the geometry pool now
+        pending.cached = GWMeshCache::CachedFile{};
+        pending.imported.clear();
+
+        if (objects.empty())
+            return false;
 
         if (objects.size() > 1)
         {
             model = objects.at(0); 
-            model->setPath(pfile);
+            model->setPath(pending.path);
 
             objects.erase(objects.begin());
 
@@ -32,72 +131,150 @@ namespace GWIN
             }
         } else {
             model = objects[0];
-            model->setPath(pfile);
+            model->setPath(pending.path);
         }
 
         return true;
     }
 
-    std::vector<std::shared_ptr<GWModel>> GWModelLoader::processScene(const aiScene *scene, const std::string &pfile)
+    std::shared_ptr<GWModel> GWModelLoader::createPlaceholder()
+    {
+        GWModel::Builder builder{};
+
+        // Each face is a quad wound counter clockwise around its normal, flipped in y like imported meshes
+        const glm::vec3 normals[6] = {{1.f, 0.f, 0.f}, {-1.f, 0.f, 0.f}, {0.f, 1.f, 0.f}, {0.f, -1.f, 0.f}, {0.f, 0.f, 1.f}, {0.f, 0.f, -1.f}};
+        const glm::vec2 corners[4] = {{-1.f, -1.f}, {1.f, -1.f}, {1.f, 1.f}, {-1.f, 1.f}};
+        const glm::vec3 flip{1.f, -1.f, 1.f};
+
+        for (const glm::vec3 &normal : normals)
+        {
+            glm::vec3 u = glm::abs(normal.x) > 0.f ? glm::vec3{0.f, 1.f, 0.f} : glm::vec3{1.f, 0.f, 0.f};
+            glm::vec3 v = glm::cross(normal, u);
+            u = glm::cross(v, normal);
+
+            uint32_t first = static_cast<uint32_t>(builder.vertices.size());
+            for (const glm::vec2 &corner : corners)
+            {
+                GWModel::Vertex vertex{};
+                vertex.position = (normal + u * corner.x + v * corner.y) * 0.5f * flip;
+                vertex.color = {.5f, .5f, .5f};
+                vertex.normal = normal * flip;
+                vertex.tangent = u * flip;
+                vertex.uv = (corner + 1.f) * 0.5f;
+                builder.vertices.push_back(vertex);
+            }
+
+            for (uint32_t index : {0u, 1u, 2u, 0u, 2u, 3u})
+            {
+                builder.indices.push_back(first + index);
+            }
+        }
+
+        builder.bounds.min = glm::vec3{-0.5f};
+        builder.bounds.max = glm::vec3{0.5f};
+        builder.bounds.center = glm::vec3{0.f};
+        builder.bounds.radius = glm::length(builder.bounds.max);
+
+        return std::make_shared<GWModel>(geometryPool, builder);
+    }
+
+    std::vector<GWModelLoader::ImportedMesh> GWModelLoader::processScene(const aiScene *scene, const std::string &pfile, OptimizationStats &stats) const
     {
         assert(scene->HasMeshes() && "Scene needs Meshes!");
 
-        std::vector<std::shared_ptr<GWModel>> processedModels;
+        // Meshes convert independently, each into its own slot with its own statistics
+        std::vector<ImportedMesh> processedModels(scene->mNumMeshes);
+        std::vector<OptimizationStats> meshStats(scene->mNumMeshes);
 
-        for (unsigned short i = 0; i < scene->mNumMeshes; ++i)
+        threadPool.parallelFor(scene->mNumMeshes, 1, [&](size_t begin, size_t end)
         {
-            aiMesh *mesh = scene->mMeshes[i];
-            aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
-            processedModels.push_back(processMesh(mesh, material, pfile));
+            for (size_t i = begin; i < end; ++i)
+            {
+                aiMesh *mesh = scene->mMeshes[i];
+                aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
+                processedModels[i] = processMesh(mesh, material, pfile, meshStats[i]);
+            }
+        });
+
+        for (const OptimizationStats &meshStat : meshStats)
+        {
+            stats += meshStat;
         }
 
         return processedModels;
     }
 
-    std::shared_ptr<GWModel> GWModelLoader::processMesh(aiMesh *mesh, aiMaterial *material, const std::string &pfile)
+    GWModelLoader::ImportedMesh GWModelLoader::processMesh(aiMesh *mesh, aiMaterial *material, const std::string &pfile, OptimizationStats &stats) const
     {
         assert(mesh->mNumVertices >= 3 && "Mesh needs at least 3 Vertices!");
 
-        // Process Vertices
-        std::vector<GWModel::Vertex> vertices{mesh->mNumVertices};
-        for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
+        // Process Vertices, one pass per attribute so the loops carry no branches and vectorize
+        const unsigned int vertexCount = mesh->mNumVertices;
+        std::vector<GWModel::Vertex> vertices(vertexCount);
+        bool hasVertexColors = mesh->HasVertexColors(0);
+
+        for (unsigned int i = 0; i < vertexCount; ++i)
+        {
+            vertices[i].position = {mesh->mVertices[i].x, -mesh->mVertices[i].y, mesh->mVertices[i].z};
+        }
+
+        if (hasVertexColors)
         {
-            glm::vec2 vertexUv = {0.0f, 0.0f};
-            glm::vec3 vertexTangent = {0.0f, 0.0f, 0.0f};
-            if (mesh->mTextureCoords[0])
+            for (unsigned int i = 0; i < vertexCount; ++i)
             {
-                vertexUv.x = mesh->mTextureCoords[0][i].x;
-                vertexUv.y = 1 - mesh->mTextureCoords[0][i].y;
+                vertices[i].color = {mesh->mColors[0][i].r, mesh->mColors[0][i].g, mesh->mColors[0][i].b};
             }
-
-            GWModel::Vertex vertex;
-            vertex.position = {mesh->mVertices[i].x, -mesh->mVertices[i].y, mesh->mVertices[i].z};
-            if (mesh->HasVertexColors(i))
+        }
+        else
+        {
+            for (unsigned int i = 0; i < vertexCount; ++i)
             {
-                glm::vec3 vertexColor = {mesh->mColors[0][i].r, mesh->mColors[0][i].g, mesh->mColors[0][i].b};
-                vertex.color = vertexColor;
+                vertices[i].color = {.5f, .5f, .5f};
             }
-            else
+        }
+
+        if (mesh->HasNormals())
+        {
+            for (unsigned int i = 0; i < vertexCount; ++i)
             {
-                vertex.color = {.5f, .5f, .5f};
+                vertices[i].normal = {mesh->mNormals[i].x, -mesh->mNormals[i].y, mesh->mNormals[i].z};
             }
-            if (mesh->HasNormals())
+        }
+
+        if (mesh->mTextureCoords[0])
+        {
+            for (unsigned int i = 0; i < vertexCount; ++i)
             {
-                glm::vec3 vertexNormal = {mesh->mNormals[i].x, -mesh->mNormals[i].y, mesh->mNormals[i].z};
-                vertex.normal = vertexNormal;
+                vertices[i].uv = {mesh->mTextureCoords[0][i].x, 1 - mesh->mTextureCoords[0][i].y};
             }
-            if (mesh->HasTangentsAndBitangents())
+        }
+
+        if (mesh->HasTangentsAndBitangents())
+        {
+            for (unsigned int i = 0; i < vertexCount; ++i)
             {
-                vertexTangent = {mesh->mTangents[i].x, -mesh->mTangents->y, mesh->mTangents->z};
+                vertices[i].tangent = {mesh->mTangents[i].x, -mesh->mTangents[i].y, mesh->mTangents[i].z};
             }
-            vertex.uv = vertexUv;
-            vertex.tangent = vertexTangent;
+        }
+
+        // Bounds are computed here once, culling only transforms them
+        GWModel::Bounds bounds{};
+        bounds.min = bounds.max = vertices[0].position;
+        for (const auto &vertex : vertices)
+        {
+            bounds.min = glm::min(bounds.min, vertex.position);
+            bounds.max = glm::max(bounds.max, vertex.position);
+        }
 
-            vertices[i] = vertex;
+        bounds.center = (bounds.min + bounds.max) * 0.5f;
+        for (const auto &vertex : vertices)
+        {
+            bounds.radius = std::max(bounds.radius, glm::length(vertex.position - bounds.center));
         }
 
         // Process Indices
-        std::vector<unsigned int> indices;
+        std::vector<uint32_t> indices;
+        indices.reserve(size_t(mesh->mNumFaces) * 3);
         for (unsigned int i = 0; i < mesh->mNumFaces; ++i)
         {
             const aiFace &face = mesh->mFaces[i];
@@ -109,50 +286,209 @@ namespace GWIN
             }
         }
 
-        const GWModel::Builder builder{vertices, indices};
+        std::vector<GWModel::LodBuilder> lods;
+        optimizeMesh(vertices, indices, lods, stats);
 
-        std::shared_ptr<GWModel> model = std::make_shared<GWModel>(device, builder);
+        // A single meshlet culls no better than the whole mesh, so only larger meshes are split
+        std::vector<MeshOptimizer::Meshlet> meshlets;
+        if (!indices.empty())
+        {
+            meshlets = MeshOptimizer::buildMeshlets(indices.data(), indices.size(), &vertices[0].position.x, &vertices[0].normal.x,
+                                                    vertices.size(), sizeof(GWModel::Vertex));
+            if (meshlets.size() < 2)
+            {
+                meshlets.clear();
+            }
+            stats.meshlets += meshlets.size();
+        }
 
-        processMaterialTextures(model, material, pfile);
+        const GWModel::Builder builder{vertices, indices, bounds, hasVertexColors, lods, meshlets};
 
-        return model;
+        return {GWModel::CookedStorage::cook(builder), collectTexturePaths(material, pfile)};
     }
 
-    std::unordered_map<std::string, Texture> textureCache;
+    void GWModelLoader::optimizeMesh(std::vector<GWModel::Vertex> &vertices, std::vector<uint32_t> &indices, std::vector<GWModel::LodBuilder> &lods, OptimizationStats &stats)
+    {
+        if (indices.empty())
+            return;
+
+        size_t vertexCount = vertices.size();
+        std::vector<uint32_t> reordered(indices.size());
+
+        stats.imported += MeshOptimizer::analyzeVertexCache(indices.data(), indices.size(), vertexCount);
+
+        MeshOptimizer::optimizeVertexCache(reordered.data(), indices.data(), indices.size(), vertexCount);
+        stats.vertexCache += MeshOptimizer::analyzeVertexCache(reordered.data(), reordered.size(), vertexCount);
+
+        MeshOptimizer::optimizeOverdraw(indices.data(), reordered.data(), reordered.size(),
+                                        &vertices[0].position.x, vertexCount, sizeof(GWModel::Vertex));
+        stats.overdraw += MeshOptimizer::analyzeVertexCache(indices.data(), indices.size(), vertexCount);
+
+        // Each level halves the previous one until the simplifier stops making progress
+        lods.reserve(MAX_MESH_LODS - 1);
+        const std::vector<uint32_t> *previous = &indices;
+        float error = 0.f;
+        for (uint32_t level = 1; level < MAX_MESH_LODS; ++level)
+        {
+            size_t targetCount = previous->size() / 6 * 3;
+            float levelError = 0.f;
+
+            std::vector<uint32_t> simplified(previous->size());
+            size_t count = MeshOptimizer::simplify(simplified.data(), previous->data(), previous->size(),
+                                                   &vertices[0].position.x, vertexCount, sizeof(GWModel::Vertex),
+                                                   targetCount, FLT_MAX, &levelError);
+
+            if (count == 0 || count > previous->size() * 3 / 4)
+                break;
+
+            GWModel::LodBuilder lod{};
+            lod.indices.resize(count);
+            lod.error = error = std::max(error, levelError);
+            MeshOptimizer::optimizeVertexCache(lod.indices.data(), simplified.data(), count, vertexCount);
+
+            lods.push_back(std::move(lod));
+            previous = &lods.back().indices;
+        }
+
+        // Fetch order follows the full mesh, the levels only reuse a subset of its vertices
+        std::vector<uint32_t> allIndices = indices;
+        for (auto &lod : lods)
+        {
+            allIndices.insert(allIndices.end(), lod.indices.begin(), lod.indices.end());
+        }
+
+        std::vector<GWModel::Vertex> fetchOrdered(vertexCount);
+        size_t usedVertices = MeshOptimizer::optimizeVertexFetch(fetchOrdered.data(), allIndices.data(), allIndices.size(),
+                                                                 vertices.data(), vertexCount, sizeof(GWModel::Vertex));
+        fetchOrdered.resize(usedVertices);
+        vertices.swap(fetchOrdered);
+
+        size_t offset = 0;
+        std::copy(allIndices.begin(), allIndices.begin() + indices.size(), indices.begin());
+        offset += indices.size();
+        stats.lodTriangles[0] += indices.size() / 3;
+
+        for (size_t level = 0; level < lods.size(); ++level)
+        {
+            auto &lod = lods[level];
+            std::copy(allIndices.begin() + offset, allIndices.begin() + offset + lod.indices.size(), lod.indices.begin());
+            offset += lod.indices.size();
+            stats.lodTriangles[level + 1] += lod.indices.size() / 3;
+        }
+
+        stats.vertexFetch += MeshOptimizer::analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+    }
+
+    void GWModelLoader::reportOptimization(const std::string &pfile, const OptimizationStats &stats)
+    {
+        if (stats.imported.triangles == 0)
+            return;
+
+        // Imports finish on several threads, the report is printed in one piece
+        std::ostringstream report;
+        auto print = [&report](const char *step, const MeshOptimizer::VertexCacheStats &cacheStats)
+        {
+            report << "  " << std::left << std::setw(14) << step
+                   << "ACMR " << cacheStats.acmr() << "  ATVR " << cacheStats.atvr() << std::endl;
+        };
+
+        report << std::fixed << std::setprecision(3)
+               << "Mesh optimization of " << pfile << " (" << stats.imported.triangles << " triangles)" << std::endl;
+        print("imported", stats.imported);
+        print("vertex cache", stats.vertexCache);
+        print("overdraw", stats.overdraw);
+        print("vertex fetch", stats.vertexFetch);
+
+        for (size_t level = 0; level < MAX_MESH_LODS; ++level)
+        {
+            if (stats.lodTriangles[level] > 0)
+            {
+                report << "  LOD " << level << "         " << stats.lodTriangles[level] << " triangles" << std::endl;
+            }
+        }
+        if (stats.meshlets > 0)
+        {
+            report << "  meshlets      " << stats.meshlets << std::endl;
+        }
+        std::cout << report.str();
+    }
 
-    void GWModelLoader::processMaterialTextures(std::shared_ptr<GWModel> &model, aiMaterial *material, const std::string &pfile)
+    GWModelLoader::TexturePaths GWModelLoader::collectTexturePaths(aiMaterial *material, const std::string &pfile)
     {
-        auto loadTexture = [&](aiTextureType type, const TextureType textureType)
+        TexturePaths paths{};
+
+        auto collect = [&](aiTextureType type, const TextureType textureType)
         {
             if (material->GetTextureCount(type) > 0)
             {
                 aiString path;
                 if (material->GetTexture(type, 0, &path) == AI_SUCCESS)
                 {
-                    std::string texturePath = std::string(path.C_Str());
-
                     std::string baseDir = pfile.substr(0, pfile.find_last_of('/') + 1);
-                    std::string fullPath = baseDir + texturePath;
-
-                    if (textureCache.find(fullPath) != textureCache.end())
-                    {
-                        Texture& cachedTexture = textureCache[fullPath];
-                        model->Textures[textureType] = cachedTexture.id;
-                    }
-                    else
-                    {
-                        Texture tex = textureHandler->createTexture(fullPath, true, textureType);
-                        model->Textures[textureType] = tex.id;
-
-                        textureCache[fullPath] = tex;
-
-                        createTextureCallback(tex);
-                    }
+                    paths[textureType] = baseDir + std::string(path.C_Str());
                 }
             }
         };
 
-        loadTexture(aiTextureType_DIFFUSE, TEXTURE_TYPE_DIFFUSE);
-        loadTexture(aiTextureType_DISPLACEMENT, TEXTURE_TYPE_NORMAL);
+        collect(aiTextureType_DIFFUSE, TEXTURE_TYPE_DIFFUSE);
+        collect(aiTextureType_DISPLACEMENT, TEXTURE_TYPE_NORMAL);
+
+        return paths;
+    }
+
+    std::vector<const GWModelLoader::TexturePaths *> GWModelLoader::texturePathsOf(const PendingImport &pending)
+    {
+        std::vector<const TexturePaths *> paths;
+
+        for (const GWMeshCache::Entry &entry : pending.cached.meshes)
+        {
+            paths.push_back(&entry.textures);
+        }
+
+        for (const ImportedMesh &mesh : pending.imported)
+        {
+            paths.push_back(&mesh.textures);
+        }
+
+        return paths;
+    }
+
+    std::vector<GWTextureHandler::TextureRequest> GWModelLoader::textureRequests(const std::vector<const TexturePaths *> &paths)
+    {
+        // Every texture of the file is requested at once, so the files decode in parallel
+        std::vector<GWTextureHandler::TextureRequest> requests;
+        for (const TexturePaths *modelPaths : paths)
+        {
+            for (size_t slot = 0; slot < modelPaths->size(); ++slot)
+            {
+                if (!(*modelPaths)[slot].empty())
+                {
+                    requests.push_back({(*modelPaths)[slot], true, static_cast<TextureType>(slot)});
+                }
+            }
+        }
+        return requests;
+    }
+
+    void GWModelLoader::applyTextures(std::vector<std::shared_ptr<GWModel>> &models, const std::vector<const TexturePaths *> &paths, GWTextureHandler::PreparedTextures &prepared)
+    {
+        std::vector<TextureHandle> textures = textureHandler->finishTextures(prepared);
+
+        size_t next = 0;
+        for (size_t i = 0; i < models.size(); ++i)
+        {
+            for (size_t slot = 0; slot < paths[i]->size(); ++slot)
+            {
+                if ((*paths[i])[slot].empty())
+                    continue;
+
+                const TextureHandle &texture = textures[next++];
+                models[i]->Textures[slot] = texture->id;
+                models[i]->textureHandles[slot] = texture;
+
+                // Ids are reused once a texture is freed, so the slot is written even for textures that were loaded already
+                createTextureCallback(*texture);
+            }
+        }
     }
 }
\ No newline at end of file
@@ -7,9 +7,13 @@
 #include "GWGameObject.hpp"
 #include "GWModel.hpp"
 #include "GWTextureHandler.hpp"
+#include "GWMeshCache.hpp"
+#include "Components/MeshOptimizer.hpp"
+#include "../GWThreadPool.hpp"
 
 #include <string>
 #include <vector>
+#include <future>
 #include <cassert>
 
 namespace GWIN
@@ -17,23 +21,86 @@ namespace GWIN
     class GWModelLoader
     {
     public:
-        GWModelLoader(GWinDevice& device, std::unique_ptr<GWTextureHandler>& textureHandler) : device(device), textureHandler(textureHandler) {};
+        // Full path per texture slot of GWModel::Textures, empty when the material has none
+        using TexturePaths = std::array<std::string, 6>;
+
+        // A mesh of the imported file, cooked for upload and not yet in the geometry pool
+        struct ImportedMesh
+        {
+            GWModel::CookedStorage geometry;
+            TexturePaths textures;
+        };
+
+        // CPU side of an import, either freshly cooked meshes or a mapped cache file
+        struct PendingImport
+        {
+            std::string path;
+            std::vector<ImportedMesh> imported;
+            GWMeshCache::CachedFile cached;
+            GWTextureHandler::PreparedTextures textures; // of the cached meshes first, then of the imported ones
+            bool succeeded{false};
+        };
+
+        GWModelLoader(GWGeometryPool& geometryPool, std::unique_ptr<GWTextureHandler>& textureHandler, GWThreadPool& threadPool)
+            : geometryPool(geometryPool), threadPool(threadPool), textureHandler(textureHandler) {};
         bool importFile(const std::string &pfile, std::shared_ptr<GWModel> &model);
 
-        void setCreateTextureCallback(std::function<void(Texture &texture)> callback)
+        // Reads and cooks the file on the thread pool, hand the result to finishImport once it is ready
+        std::future<PendingImport> importFileAsync(const std::string &pfile);
+        // Uploads the meshes and their decoded textures, has to run on the render thread
+        bool finishImport(PendingImport &pending, std::shared_ptr<GWModel> &model);
+
+        // Unit cube shown in place of meshes that are still importing
+        std::shared_ptr<GWModel> createPlaceholder();
+
+        void setCreateTextureCallback(std::function<void(const Texture &texture)> callback)
         {
             this->createTextureCallback = callback;
         }
 
     private:
-        Assimp::Importer importer;
-        GWinDevice& device;
+        // Vertex cache statistics of the file being imported, after each optimization step
+        struct OptimizationStats
+        {
+            MeshOptimizer::VertexCacheStats imported;
+            MeshOptimizer::VertexCacheStats vertexCache;
+            MeshOptimizer::VertexCacheStats overdraw;
+            MeshOptimizer::VertexCacheStats vertexFetch;
+            std::array<size_t, MAX_MESH_LODS> lodTriangles{};
+            size_t meshlets{0};
+
+            OptimizationStats &operator+=(const OptimizationStats &other)
+            {
+                imported += other.imported;
+                vertexCache += other.vertexCache;
+                overdraw += other.overdraw;
+                vertexFetch += other.vertexFetch;
+                for (size_t level = 0; level < MAX_MESH_LODS; ++level)
+                {
+                    lodTriangles[level] += other.lodTriangles[level];
+                }
+                meshlets += other.meshlets;
+                return *this;
+            }
+        };
+
+        GWGeometryPool& geometryPool;
+        GWThreadPool& threadPool;
+        GWMeshCache meshCache{};
 
-        std::vector<std::shared_ptr<GWModel>> processScene(const aiScene *scene, const std::string &pfile);
-        std::shared_ptr<GWModel> processMesh(aiMesh *mesh, aiMaterial *material, const std::string &pfile);
-        void processMaterialTextures(std::shared_ptr<GWModel>& model, aiMaterial* material, const std::string& pfile);
+        // Everything up to here touches no loader state, so any thread may cook any file
+        PendingImport cookFile(const std::string &pfile) const;
+        std::vector<ImportedMesh> processScene(const aiScene *scene, const std::string &pfile, OptimizationStats &stats) const;
+        ImportedMesh processMesh(aiMesh *mesh, aiMaterial *material, const std::string &pfile, OptimizationStats &stats) const;
+        static void optimizeMesh(std::vector<GWModel::Vertex> &vertices, std::vector<uint32_t> &indices, std::vector<GWModel::LodBuilder> &lods, OptimizationStats &stats);
+        static void reportOptimization(const std::string &pfile, const OptimizationStats &stats);
+        static TexturePaths collectTexturePaths(aiMaterial* material, const std::string& pfile);
+        // Paths of every mesh in the order finishImport creates the models
+        static std::vector<const TexturePaths*> texturePathsOf(const PendingImport &pending);
+        static std::vector<GWTextureHandler::TextureRequest> textureRequests(const std::vector<const TexturePaths*>& paths);
+        void applyTextures(std::vector<std::shared_ptr<GWModel>>& models, const std::vector<const TexturePaths*>& paths, GWTextureHandler::PreparedTextures& prepared);
 
-        std::function<void(Texture &texture)> createTextureCallback;
+        std::function<void(const Texture &texture)> createTextureCallback;
         std::unique_ptr<GWTextureHandler>& textureHandler;
     };
 }
\ No newline at end of file
@@ -5,109 +5,60 @@
 
 namespace GWIN
 {
-    GWOffscreenRenderer::GWOffscreenRenderer(GWindow &window, GWinDevice &device, size_t imageCount, VkFormat depthFormat, VkFormat colorFormat) : window(window), device(device), depthFormat(depthFormat), colorFormat(colorFormat)
+    GWOffscreenRenderer::GWOffscreenRenderer(GWindow &window, GWinDevice &device, GWDeletionQueue &deletionQueue, size_t frameCount, VkFormat depthFormat, VkFormat colorFormat)
+        : window(window), device(device), deletionQueue(deletionQueue), depthFormat(depthFormat), colorFormat(colorFormat)
     {
-        init(imageCount);
+        init(frameCount);
     }
 
     GWOffscreenRenderer::~GWOffscreenRenderer()
     {
         vkDestroySampler(device.device(), imageSampler, nullptr);
 
-        for (auto imageView : imageViews)
-        {
-            vkDestroyImageView(device.device(), imageView, nullptr);
-        }
-        imageViews.clear();
+        destroyImages();
 
         for (size_t i = 0; i < depthImages.size(); i++)
         {
             vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
-            vkDestroyImage(device.device(), depthImages[i], nullptr);
-            vmaFreeMemory(device.getAllocator(), imageAllocations[i]);
-            vmaFreeMemory(device.getAllocator(), depthImagesAllocation[i]);
+            vmaDestroyImage(device.getAllocator(), depthImages[i], depthImagesAllocation[i]);
         }
     }
 
-    void GWOffscreenRenderer::init(size_t imageCount)
+    void GWOffscreenRenderer::init(size_t frameCount)
     {
+        images.resize(frameCount);
+        imageAllocations.resize(frameCount);
+        imageViews.resize(frameCount);
+
         createImageSampler();
-        createImages(imageCount);
+        createImages();
         createImageViews();
-        createDepthResources(imageCount);
+        createDepthResources(frameCount);
     }
 
-    void GWOffscreenRenderer::createNextImage()
+    void GWOffscreenRenderer::beginFrame(uint32_t frameIndex)
     {
-        if (imageIndex >= images.size() - 1)
-        {
-            vkDeviceWaitIdle(device.device());
-            for (size_t i = 0; i < images.size(); ++i)
-            {
-                if (imageViews[i] != VK_NULL_HANDLE)
-                {
-                    vkDestroyImageView(device.device(), imageViews[i], nullptr);
-                    imageViews[i] = VK_NULL_HANDLE;
-                }
-
-                if (images[i] != VK_NULL_HANDLE)
-                {
-                    vmaDestroyImage(device.getAllocator(), images[i], imageAllocations[i]);
-                    images[i] = VK_NULL_HANDLE;
-                    imageAllocations[i] = VK_NULL_HANDLE;
-                }
-            }
+        assert(frameIndex < images.size() && "Frame index out of range");
+        imageIndex = frameIndex;
+
+        VkExtent2D windowExtent = window.getExtent();
+        if (windowExtent.width == extent.width && windowExtent.height == extent.height)
+            return;
 
-            for (size_t i = 0; i < images.size(); ++i)
+        // The frames in flight may still draw to or sample the old targets
+        deletionQueue.defer([&device = device, oldImages = images, oldAllocations = imageAllocations, oldViews = imageViews]()
+        {
+            for (size_t i = 0; i < oldImages.size(); i++)
             {
-                VkImageCreateInfo imageInfo{};
-                imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-                imageInfo.imageType = VK_IMAGE_TYPE_2D;
-                imageInfo.extent.width = window.getExtent().width;
-                imageInfo.extent.height = window.getExtent().height;
-                imageInfo.extent.depth = 1;
-                imageInfo.mipLevels = 1;
-                imageInfo.arrayLayers = 1;
-                imageInfo.format = colorFormat;
-                imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-                imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-                imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-                imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-                imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-                VmaAllocationCreateInfo allocInfo{};
-                allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-
-                if (vmaCreateImage(device.getAllocator(), &imageInfo, &allocInfo, &images[i], &imageAllocations[i], nullptr) != VK_SUCCESS)
-                {
-                    throw std::runtime_error("Failed to create offscreen images!");
-                }
-
-                VkImageViewCreateInfo viewInfo{};
-                viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-                viewInfo.image = images[i];
-                viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-                viewInfo.format = colorFormat;
-                viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                viewInfo.subresourceRange.baseMipLevel = 0;
-                viewInfo.subresourceRange.levelCount = 1;
-                viewInfo.subresourceRange.baseArrayLayer = 0;
-                viewInfo.subresourceRange.layerCount = 1;
-
-                if (vkCreateImageView(device.device(), &viewInfo, nullptr, &imageViews[i]) != VK_SUCCESS)
-                {
-                    throw std::runtime_error("Failed to create offscreen image views!");
-                }
+                vkDestroyImageView(device.device(), oldViews[i], nullptr);
+                vmaDestroyImage(device.getAllocator(), oldImages[i], oldAllocations[i]);
             }
+        });
 
-            imageIndex = 0;
-            return;
-        }
-
-        imageIndex++;
+        createImages();
+        createImageViews();
     }
 
-
     void GWOffscreenRenderer::createImageSampler()
     {
         VkSamplerCreateInfo samplerInfo{};
@@ -134,18 +85,17 @@ namespace GWIN
         }
     }
 
-    void GWOffscreenRenderer::createImages(size_t imageCount)
+    void GWOffscreenRenderer::createImages()
     {
-        images.resize(imageCount);
-        imageAllocations.resize(imageCount);
+        extent = window.getExtent();
 
         for (size_t i = 0; i < images.size(); ++i)
         {
             VkImageCreateInfo imageInfo{};
             imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
             imageInfo.imageType = VK_IMAGE_TYPE_2D;
-            imageInfo.extent.width = window.getExtent().width;
-            imageInfo.extent.height = window.getExtent().height;
+            imageInfo.extent.width = extent.width;
+            imageInfo.extent.height = extent.height;
             imageInfo.extent.depth = 1;
             imageInfo.mipLevels = 1;
             imageInfo.arrayLayers = 1;
@@ -168,8 +118,6 @@ namespace GWIN
 
     void GWOffscreenRenderer::createImageViews()
     {
-        imageViews.resize(images.size());
-
         for (size_t i = 0; i < imageViews.size(); i++)
         {
             VkImageViewCreateInfo viewInfo{};
@@ -190,26 +138,35 @@ namespace GWIN
         }
     }
 
-    void GWOffscreenRenderer::createDepthResources(size_t imageCount)
+    void GWOffscreenRenderer::destroyImages()
     {
-        depthImages.resize(imageCount);
-        depthImagesAllocation.resize(imageCount);
-        depthImageViews.resize(imageCount);
+        for (size_t i = 0; i < images.size(); i++)
+        {
+            vkDestroyImageView(device.device(), imageViews[i], nullptr);
+            vmaDestroyImage(device.getAllocator(), images[i], imageAllocations[i]);
+        }
+    }
+
+    void GWOffscreenRenderer::createDepthResources(size_t frameCount)
+    {
+        depthImages.resize(frameCount);
+        depthImagesAllocation.resize(frameCount);
+        depthImageViews.resize(frameCount);
 
         for (size_t i = 0; i < depthImages.size(); i++)
         {
             VkImageCreateInfo imageInfo{};
             imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
             imageInfo.imageType = VK_IMAGE_TYPE_2D;
-            imageInfo.extent.width = 2000;
-            imageInfo.extent.height = 2000;
+            imageInfo.extent.width = depthExtent.width;
+            imageInfo.extent.height = depthExtent.height;
             imageInfo.extent.depth = 1;
             imageInfo.mipLevels = 1;
             imageInfo.arrayLayers = 1;
             imageInfo.format = depthFormat;
             imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
             imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
             imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
             imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
@@ -233,12 +190,20 @@ namespace GWIN
         }
     }
 
-    void transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image)
+    static void transitionColorLayout(
+        VkCommandBuffer commandBuffer,
+        VkImage image,
+        VkImageLayout oldLayout,
+        VkImageLayout newLayout,
+        VkAccessFlags srcAccessMask,
+        VkAccessFlags dstAccessMask,
+        VkPipelineStageFlags srcStage,
+        VkPipelineStageFlags dstStage)
     {
         VkImageMemoryBarrier barrier{};
         barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
         barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
         barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
         barrier.image = image;
@@ -247,27 +212,61 @@ namespace GWIN
         barrier.subresourceRange.levelCount = 1;
         barrier.subresourceRange.baseArrayLayer = 0;
         barrier.subresourceRange.layerCount = 1;
+        barrier.srcAccessMask = srcAccessMask;
+        barrier.dstAccessMask = dstAccessMask;
 
-        barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT; 
-        barrier.dstAccessMask = 0;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            srcStage,
+            dstStage,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier);
+    }
+
+    static void transitionDepthLayout(
+        VkCommandBuffer commandBuffer,
+        VkImage image,
+        VkImageLayout oldLayout,
+        VkImageLayout newLayout,
+        VkAccessFlags srcAccessMask,
+        VkAccessFlags dstAccessMask,
+        VkPipelineStageFlags srcStage,
+        VkPipelineStageFlags dstStage)
+    {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.srcAccessMask = srcAccessMask;
+        barrier.dstAccessMask = dstAccessMask;
 
         vkCmdPipelineBarrier(
             commandBuffer,
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // Source stage
-            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,          // Destination stage
+            srcStage,
+            dstStage,
             0,
             0, nullptr,
             0, nullptr,
             1, &barrier);
     }
 
-    void GWOffscreenRenderer::startOffscreenRenderPass(VkCommandBuffer commandBuffer)
+    void GWOffscreenRenderer::beginRendering(VkCommandBuffer commandBuffer, VkAttachmentLoadOp loadOp)
     {
         VkRenderingAttachmentInfoKHR colorAttachment{};
         colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
         colorAttachment.imageView = imageViews[imageIndex];
         colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.loadOp = loadOp;
         colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         VkClearValue clearColor = {{{0.01f, 0.0f, 0.0f, 1.0f}}};
         colorAttachment.clearValue = clearColor;
@@ -276,15 +275,15 @@ namespace GWIN
         depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
         depthAttachment.imageView = depthImageViews[imageIndex];
         depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.loadOp = loadOp;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; // read by the depth pyramid
         VkClearValue depthClear = {{1.0f, 0}};
         depthAttachment.clearValue = depthClear;
 
         VkRenderingInfoKHR renderingInfo{};
         renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
         renderingInfo.renderArea.offset = {0, 0};
-        renderingInfo.renderArea.extent = window.getExtent();
+        renderingInfo.renderArea.extent = extent;
         renderingInfo.layerCount = 1;
         renderingInfo.colorAttachmentCount = 1;
         renderingInfo.pColorAttachments = &colorAttachment;
@@ -300,15 +299,81 @@ namespace GWIN
         viewport.minDepth = 0.0f;
         viewport.maxDepth = 1.0f;
 
-        VkRect2D scissor{{0, 0}, window.getExtent()};
+        VkRect2D scissor{{0, 0}, extent};
         vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
         vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
     }
 
+    void GWOffscreenRenderer::startOffscreenRenderPass(VkCommandBuffer commandBuffer)
+    {
+        // Cleared as well, the fence of the frame already covers the sampling of the last frame that used the target
+        transitionColorLayout(
+            commandBuffer,
+            images[imageIndex],
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            0,
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+        // The depth is cleared anyway, so whatever the last frame left in it can be discarded
+        transitionDepthLayout(
+            commandBuffer,
+            depthImages[imageIndex],
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            0,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
+
+        beginRendering(commandBuffer, VK_ATTACHMENT_LOAD_OP_CLEAR);
+    }
+
+    void GWOffscreenRenderer::pauseOffscreenRenderPass(VkCommandBuffer commandBuffer)
+    {
+        vkCmdEndRenderingKHR(commandBuffer);
+
+        transitionDepthLayout(
+            commandBuffer,
+            depthImages[imageIndex],
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+
+    void GWOffscreenRenderer::resumeOffscreenRenderPass(VkCommandBuffer commandBuffer)
+    {
+        transitionDepthLayout(
+            commandBuffer,
+            depthImages[imageIndex],
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            0,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
+
+        beginRendering(commandBuffer, VK_ATTACHMENT_LOAD_OP_LOAD);
+    }
+
     void GWOffscreenRenderer::endOffscreenRenderPass(VkCommandBuffer commandBuffer)
     {
         vkCmdEndRenderingKHR(commandBuffer);
 
-        transitionImageLayout(commandBuffer, getCurrentImage());
+        // Sampled by the interface pass of the same frame
+        transitionColorLayout(
+            commandBuffer,
+            images[imageIndex],
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
     }
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../GWDevice.hpp"
+#include "../GWDeletionQueue.hpp"
 
 // std
 #include <array>
@@ -10,31 +11,48 @@
 
 namespace GWIN
 {
+    // Keeps one set of render targets per frame in flight and reuses them every frame. The color targets follow the
+    // window extent, when it changes they are reallocated and the old ones go through the deletion queue, so frames
+    // still rendering to or sampling them are never waited for.
     class GWOffscreenRenderer
     {
     public:
-        GWOffscreenRenderer(GWindow &window, GWinDevice &device, size_t imageCount, VkFormat depthFormat, VkFormat colorFormat);
+        GWOffscreenRenderer(GWindow &window, GWinDevice &device, GWDeletionQueue &deletionQueue, size_t frameCount, VkFormat depthFormat, VkFormat colorFormat);
         ~GWOffscreenRenderer();
 
+        GWOffscreenRenderer(const GWOffscreenRenderer &) = delete;
+        GWOffscreenRenderer &operator=(const GWOffscreenRenderer &) = delete;
+
+        // Selects the targets of the frame, must be called before anything of the frame is recorded
+        void beginFrame(uint32_t frameIndex);
+
         VkImage getCurrentImage() const { return images[imageIndex];}
         VkImageView getCurrentImageView() const { return imageViews[imageIndex]; }
+        VkImageView getCurrentDepthImageView() const { return depthImageViews[imageIndex]; }
+        VkExtent2D getDepthExtent() const { return depthExtent; }
 
         void startOffscreenRenderPass(VkCommandBuffer commandBuffer);
         void endOffscreenRenderPass(VkCommandBuffer commandBuffer);
 
-        void createNextImage();
+        // Ends rendering with the depth attachment left readable by compute, resume continues on the same attachments
+        void pauseOffscreenRenderPass(VkCommandBuffer commandBuffer);
+        void resumeOffscreenRenderPass(VkCommandBuffer commandBuffer);
 
         VkSampler getImageSampler() { return imageSampler; }
     private:
         GWindow &window;
         GWinDevice &device;
+        GWDeletionQueue &deletionQueue;
 
-        void init(size_t imageCount);
+        void init(size_t frameCount);
         void createImageSampler();
 
-        void createImages(size_t imageCount);
+        void createImages();
         void createImageViews();
-        void createDepthResources(size_t imageCount);
+        void destroyImages();
+        void createDepthResources(size_t frameCount);
+
+        void beginRendering(VkCommandBuffer commandBuffer, VkAttachmentLoadOp loadOp);
 
         std::vector<VkImage> images;
         std::vector<VmaAllocation> imageAllocations;
@@ -46,6 +64,8 @@ namespace GWIN
 
         VkFormat colorFormat = VK_FORMAT_UNDEFINED;
         VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent{0, 0}; // of the color targets
+        VkExtent2D depthExtent{2000, 2000};
         
         VkSampler imageSampler;
 
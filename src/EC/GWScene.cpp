@@ -1,5 +1,6 @@
 #include "GWScene.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include "../systems/interface/Console.hpp"
 
@@ -13,8 +14,12 @@ namespace GWIN
           materialHandler(createInfo.materialHandler),
           name(createInfo.name),
           textureLayout(createInfo.textureLayout),
-          texturePool(createInfo.texturePool)
+          texturePool(createInfo.texturePool),
+          threadPool(createInfo.threadPool),
+          uploadManager(createInfo.uploadManager)
     {
+        placeholder = modelLoader.createPlaceholder();
+
         if (createInfo.sceneJson == "")
         {
             auto skybox = GWGameObject::createGameObject("Skybox");
@@ -24,8 +29,8 @@ namespace GWIN
             auto directionalLight = GWGameObject::createGameObject("Directional Light");
             directionalLight.transform.rotateEuler({4.f, -5.f, 0.f});
 
-            gameObjects.emplace(skybox.getId(), std::move(skybox));
-            gameObjects.emplace(directionalLight.getId(), std::move(directionalLight));
+            this->skybox = gameObjects.insert(std::move(skybox));
+            gameObjects.insert(std::move(directionalLight));
         } else {
             loadScene(createInfo.sceneJson);
         }
@@ -41,6 +46,7 @@ namespace GWIN
             {
                 gameObjects.clear();
                 std::shared_ptr<GWModel> model;
+                std::vector<std::pair<GWGameObject::id_t, GWGameObject::id_t>> parents;
                 for (const auto &obj : jsonData["gameObjects"])
                 {
                     auto gameObject = GWGameObject::createGameObject(obj["name"].get<std::string>(), obj["id"].get<uint32_t>());
@@ -70,14 +76,39 @@ namespace GWIN
 
                     if (obj.contains("light"))
                     {
-                        auto light = std::make_unique<LightComponent>();
-                        light->lightIntensity = obj["light"]["lightIntensity"].get<float>();
-                        light->cutOffAngle = obj["light"]["cutOffAngle"].get<float>();
-                        gameObject.light = std::move(light);
+                        LightComponent light{};
+                        light.lightIntensity = obj["light"]["lightIntensity"].get<float>();
+                        light.cutOffAngle = obj["light"]["cutOffAngle"].get<float>();
+
+                        if (obj.contains("color"))
+                        {
+                            light.color = {
+                                obj["color"][0].get<float>(),
+                                obj["color"][1].get<float>(),
+                                obj["color"][2].get<float>()};
+                        }
+
+                        gameObject.light = light;
+                    }
+
+                    if (gameObject.getName() == "Skybox")
+                    {
+                        skybox = gameObject.getId();
+                    }
+
+                    if (obj.contains("parent"))
+                    {
+                        parents.emplace_back(gameObject.getId(), obj["parent"].get<uint32_t>());
                     }
                     
-                    gameObjects.emplace(gameObject.getId(), std::move(gameObject));
+                    gameObjects.insert(std::move(gameObject));
                 } 
+
+                for (const auto &[child, parent] : parents)
+                {
+                    if (gameObjects.contains(parent))
+                        gameObjects.setParent(child, parent);
+                }
             }
 
             if (jsonData.contains("meshes"))
@@ -96,23 +127,29 @@ namespace GWIN
 
                     camera.setViewerObject(cam["viewerobject"]);
 
-                    auto& viewerObject = gameObjects.at(camera.getViewerObject());
-                    camera.setViewYXZ(viewerObject.transform.translation, glm::eulerAngles(viewerObject.transform.rotation));
+                    auto& viewerTransform = gameObjects.transform(camera.getViewerObject());
+                    camera.setViewYXZ(viewerTransform.translation, glm::eulerAngles(viewerTransform.rotation));
 
-                    cameras.emplace(viewerObject.getId(), camera);
+                    cameras.emplace(camera.getViewerObject(), camera);
                 } 
             }
 
             if (jsonData.contains("texturesinfo"))
             {
                 texturePool->resetPool();
-                textureHandler->resetTextures();
 
+                // Acquired before the old list is dropped, textures both scenes use stay loaded
+                std::vector<GWTextureHandler::TextureRequest> requests;
                 for (const auto &textureData : jsonData["texturesinfo"])
                 {
-                    Texture texture = textureHandler->createTexture(textureData["path"].get<std::string>(), true);
+                    requests.push_back({textureData["path"].get<std::string>()});
+                }
+                sceneTextures = textureHandler->acquireTextures(requests);
 
-                    createSet(texture);
+                // The pool reset dropped the set, every texture still alive goes back in
+                for (const TextureHandle &texture : textureHandler->getTextures())
+                {
+                    createSet(*texture);
                 }
             }
 
@@ -141,9 +178,19 @@ namespace GWIN
         }
     }
 
-    GWScene::~GWScene() {};
+    GWScene::~GWScene()
+    {
+        // The imports still read through the loader, let them finish before anything goes away
+        for (auto &pending : pendingMeshes)
+        {
+            if (pending.import.valid())
+                pending.import.wait();
+        }
 
-    void GWScene::createSet(Texture &texture, bool replace)
+        collectDroppedImports(true);
+    }
+
+    void GWScene::createSet(const Texture &texture, bool replace)
     {
         VkDescriptorImageInfo imageInfo{};
         imageInfo.imageLayout = texture.textureImage.layout;
@@ -183,6 +230,13 @@ namespace GWIN
         return set;
     }
 
+    void GWScene::update()
+    {
+        finishPendingMeshes();
+        gameObjects.updateWorldMatrices(&threadPool);
+        bvh.sync(gameObjects, meshes);
+    }
+
     void GWScene::createCamera()
     {
         GWCamera newCamera{};
@@ -190,15 +244,15 @@ namespace GWIN
         
         newCamera.setViewerObject(viewerObject.getId());
 
-        gameObjects.emplace(viewerObject.getId(), std::move(viewerObject));
+        gameObjects.insert(std::move(viewerObject));
         cameras.emplace(newCamera.getId(), newCamera);
     }
 
     void GWScene::createGameObject(GameObjectType type)
     {
-        auto &camera = gameObjects.at(cameras.at(currentCamera).getViewerObject());
+        auto &cameraTransform = gameObjects.transform(cameras.at(currentCamera).getViewerObject());
 
-        const glm::vec3 dPos = camera.transform.translation + glm::vec3(-.5f, 1.f, -.5f);
+        const glm::vec3 dPos = cameraTransform.translation + glm::vec3(-.5f, 1.f, -.5f);
         GWGameObject obj;
 
         switch (type)
@@ -221,7 +275,7 @@ namespace GWIN
         case GameObjectType::Camera:
         {
             createCamera();
-            break;
+            return;
         }
         default:
             throw std::invalid_argument("Unknown GameObjectType");
@@ -232,10 +286,10 @@ namespace GWIN
         createGameObject(obj);
     }
 
-     void GWScene::createGameObject(GWGameObject& obj)
-     {
-        gameObjects.emplace(obj.getId(), std::move(obj)); 
-     }
+    GWGameObject::id_t GWScene::createGameObject(GWGameObject& obj)
+    {
+        return gameObjects.insert(std::move(obj));
+    }
 
     void GWScene::removeGameObject(uint32_t id)
     {
@@ -244,40 +298,137 @@ namespace GWIN
 
     uint32_t GWScene::createMesh(const std::string &pathToFile, std::optional<uint32_t> replaceId, std::optional<std::string> info)
     {
-        modelLoader.importFile(pathToFile, model);
+        uint32_t id = replaceId.has_value() ? replaceId.value() : ++lastMeshID;
 
-        if (replaceId.has_value())
-        {
-            meshes[replaceId.value()] = std::move(model);
+        // Only the newest import of an id may land, older ones are dropped unfinished
+        dropPendingMeshes(id);
 
-            return replaceId.value();
+        // A replaced mesh stays visible until its successor is ready, unless it was removed already
+        if (meshes.find(id) == meshes.end())
+        {
+            meshes[id] = placeholder;
         }
-        else
+
+        pendingMeshes.push_back({id, pathToFile, info, modelLoader.importFileAsync(pathToFile)});
+
+        return id;
+    }
+
+    void GWScene::finishPendingMeshes()
+    {
+        collectDroppedImports(false);
+
+        for (size_t i = 0; i < pendingMeshes.size();)
         {
-            uint32_t newMeshID = ++lastMeshID;
+            PendingMesh &entry = pendingMeshes[i];
 
-            if (info.has_value())
+            // The import's uploads go out as a batch of their own, the frames keep drawing while it copies
+            if (entry.import.valid() && entry.import.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
             {
-                nlohmann::json jsonData = nlohmann::json::parse(info.value());
+                GWModelLoader::PendingImport import = entry.import.get();
 
-                if (jsonData.contains("material"))
+                // Removed while it was importing
+                bool imported = meshes.find(entry.id) != meshes.end();
+                if (imported)
                 {
-                    uint32_t materialId = jsonData["material"].get<uint32_t>();
-                    model->Material = materialId;
+                    entry.upload = uploadManager.stream([&]() { imported = modelLoader.finishImport(import, entry.model); });
                 }
+
+                if (!imported)
+                {
+                    if (meshes.find(entry.id) != meshes.end())
+                        GWConsole::addError("Failed to import " + entry.path);
+
+                    uploadManager.wait(entry.upload);
+                    pendingMeshes.erase(pendingMeshes.begin() + i);
+                    continue;
+                }
+            }
+
+            if (entry.import.valid() || !uploadManager.isReady(entry.upload))
+            {
+                ++i;
+                continue;
             }
 
-            meshes[newMeshID] = std::move(model);
+            PendingMesh pending = std::move(entry);
+            pendingMeshes.erase(pendingMeshes.begin() + i);
+
+            std::shared_ptr<GWModel> model = std::move(pending.model);
+
+            if (pending.info.has_value())
+            {
+                applyMeshInfo(*model, pending.info.value());
+            }
 
-            return lastMeshID;
+            meshes[pending.id] = std::move(model);
+            refreshMeshUsers(pending.id);
+        }
+    }
+
+    void GWScene::applyMeshInfo(GWModel &model, const std::string &info)
+    {
+        nlohmann::json jsonData = nlohmann::json::parse(info);
+
+        if (jsonData.contains("material"))
+        {
+            uint32_t materialId = jsonData["material"].get<uint32_t>();
+            model.Material = materialId;
+        }
+    }
+
+    void GWScene::refreshMeshUsers(uint32_t id)
+    {
+        // Objects using the mesh need new bounds
+        auto &ids = gameObjects.getIds();
+        auto &models = gameObjects.getModels();
+        for (size_t i = 0; i < ids.size(); ++i)
+        {
+            if (models[i] == static_cast<int32_t>(id))
+                gameObjects.setModel(ids[i], models[i]);
         }
     }
 
     void GWScene::removeMesh(uint32_t id)
     {
+        dropPendingMeshes(id);
         meshes.erase(id);
     }
 
+    void GWScene::dropPendingMeshes(uint32_t id)
+    {
+        // Geometry still being copied into goes back to the pool only after the copies, imports still cooking are
+        // collected later
+        for (PendingMesh &pending : pendingMeshes)
+        {
+            if (pending.id != id)
+                continue;
+
+            uploadManager.wait(pending.upload);
+            if (pending.import.valid())
+                droppedImports.push_back(std::move(pending.import));
+        }
+
+        pendingMeshes.erase(std::remove_if(pendingMeshes.begin(), pendingMeshes.end(), [id](const PendingMesh &pending) { return pending.id == id; }),
+                            pendingMeshes.end());
+    }
+
+    void GWScene::collectDroppedImports(bool wait)
+    {
+        for (size_t i = 0; i < droppedImports.size();)
+        {
+            if (!wait && droppedImports[i].wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                ++i;
+                continue;
+            }
+
+            // The cooked meshes and prepared textures are released right here
+            droppedImports[i].get();
+            droppedImports.erase(droppedImports.begin() + i);
+        }
+    }
+
     void GWScene::saveScene(const std::string path)
     {
         nlohmann::json jsonObject;
@@ -285,13 +436,20 @@ namespace GWIN
         jsonObject["scene"]["sceneName"] = name;
         jsonObject["scene"]["skybox"] = 1;
 
-        for (const auto &gameObjectPair : gameObjects)
+        for (auto id : gameObjects.getIds())
         {
-            jsonObject["gameObjects"].push_back(nlohmann::json::parse(gameObjectPair.second.toJson()));
+            jsonObject["gameObjects"].push_back(nlohmann::json::parse(gameObjects.toJson(id)));
         }
 
         for (const auto& mesh : meshes)
         {
+            auto pending = std::find_if(pendingMeshes.begin(), pendingMeshes.end(), [&mesh](const PendingMesh &entry) { return entry.id == mesh.first; });
+            if (mesh.second == placeholder && pending != pendingMeshes.end())
+            {
+                jsonObject["meshes"].push_back({{"pathToModel", pending->path}});
+                continue;
+            }
+
             jsonObject["meshes"].push_back(nlohmann::json::parse(mesh.second->toJson()));
         }
 
@@ -300,13 +458,11 @@ namespace GWIN
             jsonObject["cameras"].push_back(nlohmann::json::parse(camera.second.toJson()));
         }
 
-        auto& texturesToSerialize = textureHandler->getTextures();
-
-        for (const auto& texture : texturesToSerialize)
+        for (const TextureHandle &texture : textureHandler->getTextures())
         {
             nlohmann::json textureObject;
-            textureObject["id"] = texture.id;
-            textureObject["path"] = texture.pathToTexture;
+            textureObject["id"] = texture->id;
+            textureObject["path"] = texture->pathToTexture;
 
             jsonObject["texturesinfo"].push_back(nlohmann::json::parse(textureObject.dump()));
         }
@@ -5,10 +5,12 @@
 #include "GWTextureHandler.hpp"
 #include "GWCubemapHandler.hpp"
 #include "GWMaterialHandler.hpp"
+#include "GWBVH.hpp"
 #include "../JSONHandler.hpp"
 
 #include <optional>
 #include <array>
+#include <future>
 
 namespace GWIN
 {
@@ -22,6 +24,8 @@ namespace GWIN
             JSONHandler& jsonHandler, 
             std::unique_ptr<GWTextureHandler>& textureHandler,
             std::unique_ptr<GWMaterialHandler>& materialHandler,
+            GWThreadPool& threadPool,
+            GWUploadManager& uploadManager,
             std::string name = "DefaultName", 
             std::string sceneJson = ""
         ) : 
@@ -32,6 +36,8 @@ namespace GWIN
             jsonHandler(jsonHandler), 
             textureHandler(textureHandler),
             materialHandler(materialHandler),
+            threadPool(threadPool),
+            uploadManager(uploadManager),
             name(name), 
             sceneJson(sceneJson) 
         {}
@@ -43,6 +49,8 @@ namespace GWIN
         std::unique_ptr<GWTextureHandler>& textureHandler;
         std::unique_ptr<GWMaterialHandler>& materialHandler;
         JSONHandler& jsonHandler;
+        GWThreadPool& threadPool;
+        GWUploadManager& uploadManager;
         std::string name;
         std::string sceneJson;
     };
@@ -58,14 +66,15 @@ namespace GWIN
         ~GWScene();
 
         void createCamera();
+        void update();
         void createGameObject(GameObjectType type);
-        void createGameObject(GWGameObject& obj);
+        GWGameObject::id_t createGameObject(GWGameObject& obj);
         void removeGameObject(uint32_t id);
 
         uint32_t createMesh(const std::string &pathToFile, std::optional<uint32_t> replaceId = std::nullopt, std::optional<std::string> info = std::nullopt);
         void removeMesh(uint32_t id);
 
-        void createSet(Texture &texture, bool replace = false);
+        void createSet(const Texture &texture, bool replace = false);
         void createSet(VkImageLayout layout, VkImageView &imageView, VkSampler &sampler, uint32_t id);
         VkDescriptorSet retcreateSet(VkImageLayout layout, VkImageView &imageView, VkSampler &sampler, uint32_t binding);
 
@@ -75,19 +84,45 @@ namespace GWIN
         void setNewCamera(uint32_t newCamera) { currentCamera = newCamera; }
         void loadScene(const std::string &sceneJson);
 
-        GWGameObject::map& getGameObjects() { return gameObjects; }
+        GWEntityStore& getGameObjects() { return gameObjects; }
+        GWGameObject::id_t getSkybox() const { return skybox; }
+        GWBVH& getBVH() { return bvh; }
         GWModel::map& getMeshes() { return meshes; }
         std::unordered_map<uint32_t, GWCamera>& getCameras() { return cameras; }
         VkDescriptorSet& getTextures() { return textures; }
 
     private:
+        // Mesh still importing on the thread pool or uploading, its id shows the placeholder or the mesh it replaces meanwhile
+        struct PendingMesh
+        {
+            uint32_t id;
+            std::string path;
+            std::optional<std::string> info;
+            std::future<GWModelLoader::PendingImport> import;
+            std::shared_ptr<GWModel> model; // set once imported, swapped in when its upload is ready
+            UploadToken upload{UploadToken::Complete};
+        };
+
+        void finishPendingMeshes();
+        void dropPendingMeshes(uint32_t id);
+        // Takes the results of dropped imports that are done, or of all of them when wait is set
+        void collectDroppedImports(bool wait);
+        void applyMeshInfo(GWModel &model, const std::string &info);
+        void refreshMeshUsers(uint32_t id);
+
         uint32_t currentCamera{0};
         uint32_t lastMeshID{0};
 
-        std::shared_ptr<GWModel> model; //Where meshes will be loaded
+        std::shared_ptr<GWModel> placeholder;
+        std::vector<TextureHandle> sceneTextures; // textures listed by the scene file
+        std::vector<PendingMesh> pendingMeshes;
+        // Dropped while cooking, the results are still taken here so they are freed on the render thread
+        std::vector<std::future<GWModelLoader::PendingImport>> droppedImports;
 
         std::string name = "DefaultScene";
-        GWGameObject::map gameObjects;
+        GWEntityStore gameObjects;
+        GWBVH bvh;
+        GWGameObject::id_t skybox{0};
         GWModel::map meshes;
         std::vector<VkDescriptorImageInfo> texturesInfo;
         VkDescriptorSet textures = VK_NULL_HANDLE;
@@ -102,5 +137,7 @@ namespace GWIN
         std::unique_ptr<GWTextureHandler>& textureHandler;        
         JSONHandler& jsonHandler;
         GWModelLoader& modelLoader;
+        GWThreadPool& threadPool;
+        GWUploadManager& uploadManager;
     };
 }
\ No newline at end of file
@@ -11,39 +11,37 @@
 
 namespace GWIN
 {
+    // One shadow map, rendered and sampled in place every frame. The render pass waits for the fragment shaders of the
+    // frames before it to finish reading and leaves the map in DEPTH_STENCIL_READ_ONLY_OPTIMAL, so its descriptor never changes.
     class GWShadowRenderer
     {
     public:
-        GWShadowRenderer(GWindow &window, GWinDevice &device, VkFormat depthFormat, float imageCount);
+        GWShadowRenderer(GWindow &window, GWinDevice &device, VkFormat depthFormat);
         ~GWShadowRenderer();
 
-        VkImage getCurrentImage() const { return depthImages[imageIndex]; }
-        VkImageView getCurrentImageView() const { return depthImageViews[imageIndex]; }
+        VkImage getImage() const { return depthImage; }
+        VkImageView getImageView() const { return depthImageView; }
 
         void startOffscreenRenderPass(VkCommandBuffer commandBuffer);
         void endOffscreenRenderPass(VkCommandBuffer commandBuffer);
 
-        void createNextImage();
-
         VkSampler getImageSampler() { return imageSampler; }
 
     private:
         GWindow &window;
         GWinDevice &device;
 
-        void init(float imageCount);
+        void init();
         void createImageSampler();
 
-        void createDepthResources(float imageCount);
+        void createDepthResources();
 
-        std::vector<VkImage> depthImages;
-        std::vector<VmaAllocation> depthImagesAllocation;
-        std::vector<VkImageView> depthImageViews;
+        VkImage depthImage;
+        VmaAllocation depthImageAllocation;
+        VkImageView depthImageView;
         
-        VkFormat &depthFormat;
+        VkFormat depthFormat;
 
         VkSampler imageSampler;
-
-        uint32_t imageIndex{0};
     };
 }
\ No newline at end of file
@@ -0,0 +1,293 @@
+#include "GWTextureCache.hpp"
+#include "GWMeshCache.hpp"
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// Level data starts on this boundary, a multiple of every block size and of 4 as KTX2 asks
+#define TEXTURE_CACHE_ALIGNMENT 16
+
+namespace GWIN
+{
+    namespace
+    {
+        struct FileHeader
+        {
+            uint8_t identifier[12];
+            uint32_t vkFormat;
+            uint32_t typeSize;
+            uint32_t pixelWidth;
+            uint32_t pixelHeight;
+            uint32_t pixelDepth;
+            uint32_t layerCount;
+            uint32_t faceCount;
+            uint32_t levelCount;
+            uint32_t supercompressionScheme;
+            uint32_t dfdByteOffset;
+            uint32_t dfdByteLength;
+            uint32_t kvdByteOffset;
+            uint32_t kvdByteLength;
+            uint64_t sgdByteOffset;
+            uint64_t sgdByteLength;
+        };
+
+        // Follows the header once per level, base level first
+        struct LevelIndex
+        {
+            uint64_t byteOffset;
+            uint64_t byteLength;
+            uint64_t uncompressedByteLength;
+        };
+
+        constexpr uint8_t IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+        // Key of the one key/value entry, its value is the cache key so a renamed or colliding file is never used
+        constexpr char COOK_KEY[] = "GWIN.cookKey";
+
+        size_t alignUp(size_t offset, size_t alignment) { return (offset + alignment - 1) & ~(alignment - 1); }
+
+        uint32_t blockBytesOf(VkFormat format)
+        {
+            switch (format)
+            {
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                return 8;
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+                return 16;
+            default:
+                return 0;
+            }
+        }
+
+        VkExtent2D levelSize(VkExtent2D size, uint32_t level)
+        {
+            return {std::max(size.width >> level, 1u), std::max(size.height >> level, 1u)};
+        }
+
+        VkDeviceSize levelBytes(VkFormat format, VkExtent2D size, uint32_t level)
+        {
+            VkExtent2D extent = levelSize(size, level);
+            return VkDeviceSize((extent.width + 3) / 4) * ((extent.height + 3) / 4) * blockBytesOf(format);
+        }
+
+        // Basic data format descriptor of a block compressed format, see the Khronos Data Format Specification
+        std::vector<uint32_t> dataFormatDescriptor(VkFormat format)
+        {
+            uint32_t colorModel = format == VK_FORMAT_BC5_UNORM_BLOCK ? 132 : blockBytesOf(format) == 8 ? 128 : 134;
+            uint32_t transferFunction = format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK ? 2 : 1;
+            uint32_t bitLength = format == VK_FORMAT_BC5_UNORM_BLOCK ? 64 : blockBytesOf(format) * 8;
+            uint32_t sampleCount = format == VK_FORMAT_BC5_UNORM_BLOCK ? 2 : 1;
+            uint32_t blockSize = 24 + 16 * sampleCount;
+
+            std::vector<uint32_t> words{
+                4 + blockSize,
+                0,                                                   // Khronos vendor, basic descriptor type
+                2 | (blockSize << 16),                               // version 1.3 of the descriptor
+                colorModel | (1 << 8) | (transferFunction << 16),    // BT.709 primaries, straight alpha
+                3 | (3 << 8),                                        // 4x4 texel blocks
+                blockBytesOf(format),
+                0};
+
+            for (uint32_t sample = 0; sample < sampleCount; ++sample)
+            {
+                words.push_back((sample * bitLength) | ((bitLength - 1) << 16) | (sample << 24));
+                words.push_back(0);
+                words.push_back(0);
+                words.push_back(0xFFFFFFFF);
+            }
+
+            return words;
+        }
+
+        std::vector<char> keyValueData(uint64_t key)
+        {
+            std::vector<char> entry(sizeof(uint32_t) + sizeof(COOK_KEY) + sizeof(key));
+
+            uint32_t length = static_cast<uint32_t>(sizeof(COOK_KEY) + sizeof(key));
+            std::memcpy(entry.data(), &length, sizeof(length));
+            std::memcpy(entry.data() + sizeof(length), COOK_KEY, sizeof(COOK_KEY));
+            std::memcpy(entry.data() + sizeof(length) + sizeof(COOK_KEY), &key, sizeof(key));
+
+            entry.resize(alignUp(entry.size(), 4), 0);
+            return entry;
+        }
+    }
+
+    uint64_t GWTextureCache::keyOf(const std::string &source, VkFormat blockFormat)
+    {
+        uint64_t hash = GWMeshCache::hashSource(source);
+        if (hash == 0)
+            return 0;
+
+        for (uint32_t value : {static_cast<uint32_t>(blockFormat), TEXTURE_CACHE_VERSION})
+        {
+            hash ^= value;
+            hash *= 1099511628211ull;
+        }
+
+        return hash != 0 ? hash : 1;
+    }
+
+    std::string GWTextureCache::pathOf(uint64_t key) const
+    {
+        std::ostringstream name;
+        name << directory << '/' << std::hex << std::setw(16) << std::setfill('0') << key << ".ktx2";
+        return name.str();
+    }
+
+    bool GWTextureCache::load(uint64_t key, VkFormat blockFormat, DecodedImage &image) const
+    {
+        image = DecodedImage{};
+
+        if (key == 0 || blockBytesOf(blockFormat) == 0)
+            return false;
+
+        std::ifstream file{pathOf(key), std::ios::binary | std::ios::ate};
+        if (!file.is_open())
+            return false;
+
+        std::vector<char> data(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        if (!file.read(data.data(), data.size()) || data.size() < sizeof(FileHeader))
+            return false;
+
+        FileHeader header;
+        std::memcpy(&header, data.data(), sizeof(header));
+
+        if (std::memcmp(header.identifier, IDENTIFIER, sizeof(IDENTIFIER)) != 0 || header.vkFormat != static_cast<uint32_t>(blockFormat) ||
+            header.pixelWidth == 0 || header.pixelHeight == 0 || header.levelCount == 0 || header.levelCount > 32 ||
+            header.supercompressionScheme != 0 || sizeof(FileHeader) + sizeof(LevelIndex) * header.levelCount > data.size())
+        {
+            return false;
+        }
+
+        std::vector<char> expectedKeyValues = keyValueData(key);
+        if (header.kvdByteOffset > data.size() || header.kvdByteLength != expectedKeyValues.size() ||
+            data.size() - header.kvdByteOffset < header.kvdByteLength ||
+            std::memcmp(data.data() + header.kvdByteOffset, expectedKeyValues.data(), expectedKeyValues.size()) != 0)
+        {
+            return false;
+        }
+
+        VkExtent2D size{header.pixelWidth, header.pixelHeight};
+        std::vector<LevelIndex> levels(header.levelCount);
+        std::memcpy(levels.data(), data.data() + sizeof(FileHeader), sizeof(LevelIndex) * levels.size());
+
+        VkDeviceSize totalSize = 0;
+        for (uint32_t level = 0; level < header.levelCount; ++level)
+        {
+            const LevelIndex &index = levels[level];
+            if (index.byteLength != levelBytes(blockFormat, size, level) || index.byteOffset > data.size() ||
+                data.size() - index.byteOffset < index.byteLength)
+            {
+                return false;
+            }
+
+            image.levelOffsets.push_back(totalSize);
+            totalSize += index.byteLength;
+        }
+
+        image.blocks.resize(static_cast<size_t>(totalSize));
+        for (uint32_t level = 0; level < header.levelCount; ++level)
+        {
+            std::memcpy(image.blocks.data() + image.levelOffsets[level], data.data() + levels[level].byteOffset, levels[level].byteLength);
+        }
+
+        image.size = size;
+        image.blockFormat = blockFormat;
+        return true;
+    }
+
+    void GWTextureCache::store(uint64_t key, const DecodedImage &image) const
+    {
+        if (key == 0 || !image.isCompressed() || image.blocks.empty())
+            return;
+
+        // Two loads of the same file may store at the same time, each writes its own temporary file
+        static std::atomic<uint32_t> storeCount{0};
+
+        std::string path = pathOf(key);
+        std::string temporaryPath = path + "." + std::to_string(storeCount.fetch_add(1)) + ".tmp";
+
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+
+        {
+            std::ofstream file{temporaryPath, std::ios::binary | std::ios::trunc};
+            if (!file.is_open())
+            {
+                std::cout << "Failed to write texture cache " << path << std::endl;
+                return;
+            }
+
+            uint32_t levelCount = static_cast<uint32_t>(image.levelOffsets.size());
+            std::vector<uint32_t> descriptor = dataFormatDescriptor(image.blockFormat);
+            std::vector<char> keyValues = keyValueData(key);
+
+            FileHeader header{};
+            std::memcpy(header.identifier, IDENTIFIER, sizeof(IDENTIFIER));
+            header.vkFormat = static_cast<uint32_t>(image.blockFormat);
+            header.typeSize = 1;
+            header.pixelWidth = image.size.width;
+            header.pixelHeight = image.size.height;
+            header.faceCount = 1;
+            header.levelCount = levelCount;
+            header.dfdByteOffset = static_cast<uint32_t>(sizeof(FileHeader) + sizeof(LevelIndex) * levelCount);
+            header.dfdByteLength = static_cast<uint32_t>(descriptor.size() * sizeof(uint32_t));
+            header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+            header.kvdByteLength = static_cast<uint32_t>(keyValues.size());
+
+            // KTX2 stores the smallest level first, the level index stays ordered from the base level
+            std::vector<LevelIndex> levels(levelCount);
+            size_t offset = header.kvdByteOffset + header.kvdByteLength;
+            for (uint32_t level = levelCount; level-- > 0;)
+            {
+                size_t end = level + 1 < levelCount ? static_cast<size_t>(image.levelOffsets[level + 1]) : image.blocks.size();
+
+                offset = alignUp(offset, TEXTURE_CACHE_ALIGNMENT);
+                levels[level].byteOffset = offset;
+                levels[level].byteLength = end - image.levelOffsets[level];
+                levels[level].uncompressedByteLength = levels[level].byteLength;
+                offset += static_cast<size_t>(levels[level].byteLength);
+            }
+
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char *>(levels.data()), sizeof(LevelIndex) * levels.size());
+            file.write(reinterpret_cast<const char *>(descriptor.data()), header.dfdByteLength);
+            file.write(keyValues.data(), keyValues.size());
+
+            static const char zeros[TEXTURE_CACHE_ALIGNMENT] = {};
+            for (uint32_t level = levelCount; level-- > 0;)
+            {
+                size_t position = static_cast<size_t>(file.tellp());
+                file.write(zeros, levels[level].byteOffset - position);
+                file.write(reinterpret_cast<const char *>(image.blocks.data() + image.levelOffsets[level]), levels[level].byteLength);
+            }
+
+            if (!file)
+            {
+                std::cout << "Failed to write texture cache " << path << std::endl;
+                file.close();
+                std::filesystem::remove(temporaryPath, error);
+                return;
+            }
+        }
+
+        // Readers only ever see complete files
+        std::filesystem::rename(temporaryPath, path, error);
+        if (error)
+        {
+            std::cout << "Failed to write texture cache " << path << ": " << error.message() << std::endl;
+            std::filesystem::remove(temporaryPath, error);
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "GWImageLoader.hpp"
+
+// std
+#include <string>
+
+namespace GWIN
+{
+    // Block compressed textures on disk, so an image file is only decoded and compressed once per format.
+    // Files are KTX2 with every mip level, named after a hash of the source, the format and TEXTURE_CACHE_VERSION.
+    // Like GWMeshCache it holds no state besides its directory, so decode tasks on several threads can use it at once.
+    class GWTextureCache
+    {
+    public:
+        static constexpr uint32_t TEXTURE_CACHE_VERSION = 1;
+
+        explicit GWTextureCache(std::string directory = "cache/textures") : directory(std::move(directory)) {}
+
+        // Hash of the source file and how it is cooked, 0 when the file can't be read
+        static uint64_t keyOf(const std::string &source, VkFormat blockFormat);
+
+        // False when there is no cooked file for the key or it is damaged
+        bool load(uint64_t key, VkFormat blockFormat, DecodedImage &image) const;
+        // Failing to write only costs the next load its speed, so it is reported and otherwise ignored
+        void store(uint64_t key, const DecodedImage &image) const;
+
+    private:
+        std::string pathOf(uint64_t key) const;
+
+        std::string directory;
+    };
+}
@@ -1,48 +1,253 @@
 #include "GWTextureHandler.hpp"
 
+#include <algorithm>
+#include <filesystem>
 #include <stdexcept>
 #include <iostream>
 #include <numeric>
 
 namespace GWIN
 {
-    GWTextureHandler::GWTextureHandler(GWImageLoader &imageLoader, GWinDevice &device)
-        : imageLoader(imageLoader), device(device)
+    GWTextureHandler::GWTextureHandler(GWImageLoader &imageLoader, GWinDevice &device, GWThreadPool &threadPool, GWDeletionQueue &deletionQueue)
+        : imageLoader(imageLoader), device(device), threadPool(threadPool), deletionQueue(deletionQueue)
     {
     }
 
     GWTextureHandler::~GWTextureHandler()
     {
-        for (uint32_t i = 0; i < textures.size(); ++i)
+        std::vector<TextureHandle> remaining = getTextures();
+
+        // Handles still held elsewhere only free their Texture from now on, the image loader destroys the images
+        registry.reset();
+
+        for (const TextureHandle &texture : remaining)
         {
-            auto currentTexture = textures[i];
-            vkDestroySampler(device.device(), currentTexture.textureSampler, nullptr);
+            vkDestroySampler(device.device(), texture->textureSampler, nullptr);
         }
     }
 
-    Texture GWTextureHandler::createTexture(std::string &pathToTexture, bool mipMap, TextureType type)
+    std::string GWTextureHandler::registryKey(const TextureRequest &request) const
     {
-        ++lastTextureId;
-        
-        Texture texture{};
+        std::error_code error;
+        std::filesystem::path canonical = std::filesystem::weakly_canonical(request.pathToTexture, error);
+
+        VkFormat format = blockFormatOf(request);
+        if (format == VK_FORMAT_UNDEFINED)
+        {
+            format = formatOf(request.type);
+        }
 
-        texture.id = lastTextureId;
-        
-        texture.textureImage = imageLoader.loadImage(pathToTexture, mipMap, type == TEXTURE_TYPE_DIFFUSE ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM);
-        texture.pathToTexture = pathToTexture;
+        std::string key = error ? std::filesystem::path(request.pathToTexture).lexically_normal().generic_string() : canonical.generic_string();
+        return key + '|' + std::to_string(static_cast<int>(format)) + (request.mipMap ? "|mips" : "");
+    }
+
+    VkFormat GWTextureHandler::blockFormatOf(const TextureRequest &request) const
+    {
+        // Interface icons are drawn at their size and stay as they are
+        if (!request.mipMap || !device.textureCompressionBC)
+            return VK_FORMAT_UNDEFINED;
 
-        GWIN::createSampler(device, texture.textureSampler, texture.textureImage.mipLevels);
+        switch (request.type)
+        {
+        case TEXTURE_TYPE_DIFFUSE:
+            return VK_FORMAT_BC7_SRGB_BLOCK;
+        case TEXTURE_TYPE_NORMAL:
+            return VK_FORMAT_BC5_UNORM_BLOCK;
+        default:
+            return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+        }
+    }
+
+    DecodedImage GWTextureHandler::loadImage(const TextureRequest &request) const
+    {
+        VkFormat blockFormat = blockFormatOf(request);
+        if (blockFormat == VK_FORMAT_UNDEFINED)
+            return GWImageLoader::decodeImage(request.pathToTexture);
+
+        uint64_t key = GWTextureCache::keyOf(request.pathToTexture, blockFormat);
+
+        DecodedImage cooked{};
+        if (textureCache.load(key, blockFormat, cooked))
+            return cooked;
+
+        cooked = GWImageLoader::compressImage(GWImageLoader::decodeImage(request.pathToTexture), blockFormat);
+        textureCache.store(key, cooked);
+        return cooked;
+    }
+
+    TextureHandle GWTextureHandler::lookupTexture(const std::string &key) const
+    {
+        std::lock_guard<std::mutex> lock(registry->mutex);
+        auto it = registry->textures.find(key);
+        if (it == registry->textures.end())
+            return nullptr;
 
-        textures.push_back(std::move(texture));
+        return it->second.lock();
+    }
 
+    TextureHandle GWTextureHandler::findTexture(const std::string &key) const
+    {
+        // The texture may belong to a model still streaming in, whoever finds it now draws with it next frame
+        TextureHandle texture = lookupTexture(key);
+        if (texture)
+        {
+            imageLoader.requireImage(texture->textureImage);
+        }
         return texture;
     }
 
-    void GWTextureHandler::destroyTexture(uint32_t id)
+    TextureHandle GWTextureHandler::acquireTexture(const std::string &pathToTexture, bool mipMap, TextureType type)
+    {
+        TextureRequest request{pathToTexture, mipMap, type};
+        std::string key = registryKey(request);
+
+        if (TextureHandle texture = findTexture(key))
+            return texture;
+
+        return createTexture(key, pathToTexture, loadImage(request), mipMap, formatOf(type));
+    }
+
+    std::vector<TextureHandle> GWTextureHandler::acquireTextures(const std::vector<TextureRequest> &requests)
     {
-        auto currentTexture = textures[id];
-        vkDestroySampler(device.device(), currentTexture.textureSampler, nullptr);
-        imageLoader.destroyImage(currentTexture.textureImage.id);
+        PreparedTextures prepared = prepareTextures(requests);
+        return finishTextures(prepared);
+    }
+
+    GWTextureHandler::PreparedTextures GWTextureHandler::prepareTextures(const std::vector<TextureRequest> &requests) const
+    {
+        PreparedTextures prepared{};
+        prepared.requests = requests;
+        prepared.keys.resize(requests.size());
+        prepared.found.resize(requests.size());
+        prepared.decoded.resize(requests.size());
+
+        // A file requested twice is decoded once, finishTextures hands the later requests the first one's handle
+        std::unordered_map<std::string, size_t> firstRequest;
+        std::vector<size_t> missing;
+
+        for (size_t i = 0; i < requests.size(); ++i)
+        {
+            prepared.keys[i] = registryKey(requests[i]);
+            if (!firstRequest.emplace(prepared.keys[i], i).second)
+                continue;
+
+            prepared.found[i] = lookupTexture(prepared.keys[i]);
+            if (!prepared.found[i])
+            {
+                missing.push_back(i);
+            }
+        }
+
+        threadPool.parallelFor(missing.size(), 1, [&](size_t begin, size_t end)
+        {
+            for (size_t j = begin; j < end; ++j)
+            {
+                prepared.decoded[missing[j]] = loadImage(requests[missing[j]]);
+            }
+        });
+
+        return prepared;
+    }
+
+    std::vector<TextureHandle> GWTextureHandler::finishTextures(PreparedTextures &prepared)
+    {
+        std::vector<TextureHandle> textures(prepared.requests.size());
+        std::unordered_map<std::string, size_t> firstRequest;
+
+        for (size_t i = 0; i < prepared.requests.size(); ++i)
+        {
+            const std::string &key = prepared.keys[i];
+
+            auto [first, isFirst] = firstRequest.emplace(key, i);
+            if (!isFirst)
+            {
+                textures[i] = textures[first->second];
+                continue;
+            }
+
+            // Someone else may have registered the file since it was decoded
+            textures[i] = findTexture(key);
+            if (!textures[i])
+            {
+                const TextureRequest &request = prepared.requests[i];
+                textures[i] = createTexture(key, request.pathToTexture, prepared.decoded[i], request.mipMap, formatOf(request.type));
+            }
+        }
+
+        // The pixels are uploaded and the held handles are in textures now
+        prepared = PreparedTextures{};
+
+        return textures;
+    }
+
+    TextureHandle GWTextureHandler::createTexture(const std::string &key, const std::string &pathToTexture, const DecodedImage &decoded, bool mipMap, VkFormat format)
+    {
+        std::lock_guard<std::mutex> loadLock(loadMutex);
+
+        // Someone else may have loaded it while this thread decoded
+        if (TextureHandle texture = findTexture(key))
+            return texture;
+
+        Texture *texture = new Texture{};
+        texture->textureImage = imageLoader.uploadImage(decoded, mipMap, format);
+        texture->pathToTexture = pathToTexture;
+
+        GWIN::createSampler(device, texture->textureSampler, texture->textureImage.mipLevels);
+
+        std::lock_guard<std::mutex> lock(registry->mutex);
+        if (registry->freeIds.empty())
+        {
+            texture->id = ++registry->lastTextureId;
+        }
+        else
+        {
+            texture->id = registry->freeIds.back();
+            registry->freeIds.pop_back();
+        }
+
+        std::weak_ptr<Registry> owner = registry;
+        TextureHandle handle{texture, [this, owner, key](const Texture *released)
+                             {
+                                 if (owner.lock())
+                                 {
+                                     releaseTexture(key, *released);
+                                 }
+                                 delete released;
+                             }};
+
+        registry->textures[key] = handle;
+
+        return handle;
+    }
+
+    void GWTextureHandler::releaseTexture(const std::string &key, const Texture &texture)
+    {
+        {
+            std::lock_guard<std::mutex> lock(registry->mutex);
+
+            // The key may already name a newer load of the same file
+            auto it = registry->textures.find(key);
+            if (it != registry->textures.end() && it->second.expired())
+            {
+                registry->textures.erase(it);
+            }
+        }
+
+        // Frames in flight still sample the slot, it is only rewritten once they are done
+        std::weak_ptr<Registry> owner = registry;
+        deletionQueue.defer([&device = device, owner, sampler = texture.textureSampler, id = texture.id]()
+        {
+            vkDestroySampler(device.device(), sampler, nullptr);
+
+            if (auto registry = owner.lock())
+            {
+                std::lock_guard<std::mutex> lock(registry->mutex);
+                registry->freeIds.push_back(id);
+            }
+        });
+
+        std::lock_guard<std::mutex> loadLock(loadMutex);
+        imageLoader.destroyImage(texture.textureImage.id);
     }
 
     void GWTextureHandler::changeImageLayout(Texture &texture, VkImageLayout newLayout)
@@ -50,15 +255,23 @@ namespace GWIN
         imageLoader.transitionImageLayout(texture.textureImage, newLayout);
     }
 
-    std::vector<TextureInfo> GWTextureHandler::getTextures() const
+    std::vector<TextureHandle> GWTextureHandler::getTextures() const
     {
-        std::vector<TextureInfo> info;
-        
-        for (auto& texture : textures)
+        std::vector<TextureHandle> textures;
+
         {
-            info.push_back({texture.pathToTexture, texture.id});
+            std::lock_guard<std::mutex> lock(registry->mutex);
+            for (const auto &[key, texture] : registry->textures)
+            {
+                if (TextureHandle alive = texture.lock())
+                {
+                    textures.push_back(std::move(alive));
+                }
+            }
         }
 
-        return info;
+        std::sort(textures.begin(), textures.end(), [](const TextureHandle &a, const TextureHandle &b) { return a->id < b->id; });
+
+        return textures;
     }
-}
\ No newline at end of file
+}
@@ -1,12 +1,16 @@
 #pragma once
 
 #include "GWImageLoader.hpp"
+#include "GWTextureCache.hpp"
 #include "GWDescriptors.hpp"
 #include "../GWBuffer.hpp"
 #include "../GWRendererToolkit.hpp"
+#include "../GWThreadPool.hpp"
 
 #include <string>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 
 namespace GWIN
 {
@@ -20,12 +24,6 @@ namespace GWIN
         TEXTURE_TYPE_AMBIENT,
     };
 
-    struct TextureInfo
-    {
-        std::string pathToTexture;
-        uint32_t id;
-    };
-
     struct Texture
     {
         VkSampler textureSampler = VK_NULL_HANDLE;
@@ -34,33 +32,84 @@ namespace GWIN
         uint32_t id;
     };
 
+    // Shared texture, its GPU image is freed once the last handle is gone
+    using TextureHandle = std::shared_ptr<const Texture>;
+
+    // Registry of every loaded texture, keyed by canonical path, the format its image is created in and whether it has
+    // mips, so each file is loaded once per variant and no caller gets one cooked for another.
+    // Lookups may come from any thread. Texture ids are slots of the bindless texture array and are reused once freed.
+    // Mipmapped textures are cooked to block compressed formats with all their levels and kept in the texture cache.
     class GWTextureHandler
     {
     public:
-        GWTextureHandler(GWImageLoader &imageLoader, GWinDevice &device);
+        struct TextureRequest
+        {
+            std::string pathToTexture;
+            bool mipMap{true};
+            TextureType type{TEXTURE_TYPE_DIFFUSE};
+        };
+
+        // Requests looked up in the registry, with the files that were missing decoded and waiting for their upload
+        struct PreparedTextures
+        {
+            std::vector<TextureRequest> requests;
+            std::vector<std::string> keys;
+            std::vector<TextureHandle> found;   // registered already, held so they are still there when finishing
+            std::vector<DecodedImage> decoded;  // empty where a texture was found or an earlier request has the file
+        };
+
+        GWTextureHandler(GWImageLoader &imageLoader, GWinDevice &device, GWThreadPool &threadPool, GWDeletionQueue &deletionQueue);
         ~GWTextureHandler();
 
         GWTextureHandler(const GWTextureHandler &) = delete;
         GWTextureHandler &operator=(const GWTextureHandler &) = delete;
 
-        Texture createTexture(std::string &pathToTexture, bool mipMap, TextureType type = TEXTURE_TYPE_DIFFUSE);
-        void destroyTexture(uint32_t id);
+        // Returns the registered texture or loads it, the caller keeps it alive by holding the handle
+        TextureHandle acquireTexture(const std::string &pathToTexture, bool mipMap, TextureType type = TEXTURE_TYPE_DIFFUSE);
+        // Same for many files at once, the missing ones decode on the thread pool
+        std::vector<TextureHandle> acquireTextures(const std::vector<TextureRequest> &requests);
+        // First half of acquireTextures: decodes the missing files and touches no device state. Decodes through
+        // parallelFor, so it may run inside a pool task.
+        PreparedTextures prepareTextures(const std::vector<TextureRequest> &requests) const;
+        // Second half, registers and uploads what was decoded without waiting on the pool
+        std::vector<TextureHandle> finishTextures(PreparedTextures &prepared);
         void changeImageLayout(Texture& texture, VkImageLayout newLayout);
 
         GWImageLoader getImageLoader() { return imageLoader; }
 
-        std::vector<TextureInfo> getTextures() const;
-        void resetTextures() { textures.clear(); lastTextureId = 0; };
-        void decreaseLastTextureID() { lastTextureId -= 1; }
+        // Every texture alive right now, ordered by id
+        std::vector<TextureHandle> getTextures() const;
 
     private:
-        GWinDevice& device;
-        GWImageLoader& imageLoader;
+        // Outlives the handler for as long as handles do, so late releases know it is gone
+        struct Registry
+        {
+            std::unordered_map<std::string, std::weak_ptr<const Texture>> textures;
+            std::vector<uint32_t> freeIds;
+            uint32_t lastTextureId{0};
+            std::mutex mutex;
+        };
 
-        std::vector<Texture> textures;
+        static VkFormat formatOf(TextureType type) { return type == TEXTURE_TYPE_DIFFUSE ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM; }
+        // VK_FORMAT_UNDEFINED when the texture stays uncompressed
+        VkFormat blockFormatOf(const TextureRequest &request) const;
+        std::string registryKey(const TextureRequest &request) const;
+        // Cooked image from the cache, or decoded and cooked now. Thread-safe, the decode tasks run it.
+        DecodedImage loadImage(const TextureRequest &request) const;
 
-        uint32_t lastTextureId{0};
+        // Registry lookup only, findTexture also makes a shared image still streaming in ready for the next frame
+        TextureHandle lookupTexture(const std::string &key) const;
+        TextureHandle findTexture(const std::string &key) const;
+        TextureHandle createTexture(const std::string &key, const std::string &pathToTexture, const DecodedImage &decoded, bool mipMap, VkFormat format);
+        void releaseTexture(const std::string &key, const Texture &texture);
+
+        GWinDevice& device;
+        GWImageLoader& imageLoader;
+        GWThreadPool& threadPool;
+        GWDeletionQueue& deletionQueue;
+        GWTextureCache textureCache;
 
-        void createDescriptorSet(Texture &texture);
+        std::shared_ptr<Registry> registry{std::make_shared<Registry>()};
+        std::mutex loadMutex; // guards the image loader, uploads go through the device's single use command buffers
     };
 } // namespace GWIN
@@ -2,7 +2,7 @@
 
 namespace GWIN
 {
-    void keyboardMovementController::moveInPlaneXZ(GLFWwindow* window, float dt, GWGameObject& gameObject)
+    bool keyboardMovementController::moveInPlaneXZ(GLFWwindow* window, float dt, TransformComponent& transform)
     {
         glm::vec3 rotate{ 0 };
         if (glfwGetKey(window, keys.lookRight) == GLFW_PRESS)
@@ -14,15 +14,17 @@ namespace GWIN
         if (glfwGetKey(window, keys.lookDown) == GLFW_PRESS)
             rotate.x -= 1.f;
 
-        glm::vec3 currentRotation = gameObject.transform.getRotation();
+        glm::vec3 currentRotation = transform.getRotation();
+        bool moved = false;
 
         if (glm::dot(rotate, rotate) > std::numeric_limits<float>::epsilon())
         {
+            moved = true;
             currentRotation += lookSpeed * dt * glm::normalize(rotate);
             currentRotation.x = glm::clamp(currentRotation.x, -1.5f, 1.5f);
             currentRotation.y = glm::mod(currentRotation.y, glm::two_pi<float>());
 
-            gameObject.transform.rotateEuler(currentRotation);
+            transform.rotateEuler(currentRotation);
         }
 
         float yaw = currentRotation.y;
@@ -46,7 +48,10 @@ namespace GWIN
 
         if (glm::dot(moveDir, moveDir) > std::numeric_limits<float>::epsilon())
         {
-            gameObject.transform.translation += moveSpeed * dt * glm::normalize(moveDir);
+            transform.translation += moveSpeed * dt * glm::normalize(moveDir);
+            moved = true;
         }
+
+        return moved;
     }
 }
@@ -25,7 +25,7 @@ namespace GWIN
             int activateWireframe = GLFW_KEY_F;
         };
 
-        void moveInPlaneXZ(GLFWwindow *window, float dt, GWGameObject& gameObject);
+        bool moveInPlaneXZ(GLFWwindow *window, float dt, TransformComponent& transform);
 
         KeyMappings keys{};
         float moveSpeed{2.5f};
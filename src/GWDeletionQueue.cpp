@@ -0,0 +1,66 @@
+#include "GWDeletionQueue.hpp"
+
+// std
+#include <algorithm>
+#include <vector>
+
+namespace GWIN
+{
+    void GWDeletionQueue::defer(std::function<void()> destroy, const void *owner)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        deletions.push_back({frame, owner, std::move(destroy)});
+    }
+
+    void GWDeletionQueue::drop(const void *owner)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        deletions.erase(std::remove_if(deletions.begin(), deletions.end(), [owner](const Deletion &deletion) { return deletion.owner == owner; }),
+                        deletions.end());
+    }
+
+    void GWDeletionQueue::beginFrame()
+    {
+        std::vector<std::function<void()>> due;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++frame;
+
+            // Stamps only grow, so the due deletions are all at the front
+            while (!deletions.empty() && deletions.front().frame + framesInFlight <= frame)
+            {
+                due.push_back(std::move(deletions.front().destroy));
+                deletions.pop_front();
+            }
+        }
+
+        // Unlocked, a destroy may release something that defers again
+        for (auto &destroy : due)
+        {
+            destroy();
+        }
+    }
+
+    void GWDeletionQueue::flush()
+    {
+        // Releasing one resource may defer others, those go in the next round
+        while (true)
+        {
+            std::deque<Deletion> due;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                due.swap(deletions);
+            }
+
+            if (due.empty())
+                return;
+
+            for (auto &deletion : due)
+            {
+                deletion.destroy();
+            }
+        }
+    }
+}
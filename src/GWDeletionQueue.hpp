@@ -0,0 +1,46 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+namespace GWIN
+{
+    // Destroys GPU resources once no frame that was recorded while they were alive can still use them, so releasing
+    // one never waits for the device. Each deletion is stamped with the frame being recorded; beginFrame() runs every
+    // deletion whose frame is at least framesInFlight frames old, which the fence wait of the new frame guarantees done.
+    class GWDeletionQueue
+    {
+    public:
+        explicit GWDeletionQueue(uint32_t framesInFlight) : framesInFlight(framesInFlight) {}
+        // Runs whatever is left, the device has to be idle by then
+        ~GWDeletionQueue() { flush(); }
+
+        GWDeletionQueue(const GWDeletionQueue &) = delete;
+        GWDeletionQueue &operator=(const GWDeletionQueue &) = delete;
+
+        // owner lets an object that goes away before the queue drop the deletions it no longer needs
+        void defer(std::function<void()> destroy, const void *owner = nullptr);
+        void drop(const void *owner);
+
+        // Call once the new frame's fence was waited for
+        void beginFrame();
+        // Runs everything now, only once the device is idle
+        void flush();
+
+    private:
+        struct Deletion
+        {
+            uint64_t frame;
+            const void *owner;
+            std::function<void()> destroy;
+        };
+
+        uint32_t framesInFlight;
+        uint64_t frame{0}; // frames begun so far
+        std::deque<Deletion> deletions;
+        std::mutex mutex;
+    };
+}
@@ -183,7 +183,7 @@ namespace GWIN
         QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-        std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+        std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily, indices.transferFamily};
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -200,28 +200,36 @@ namespace GWIN
         deviceFeatures.samplerAnisotropy = VK_TRUE;
         deviceFeatures.fillModeNonSolid = VK_TRUE;
         deviceFeatures.robustBufferAccess = VK_TRUE;
+        deviceFeatures.multiDrawIndirect = VK_TRUE;
+        deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
 
-        // Bindless Descriptor Arrays Features
-        VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
-        indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
-        indexingFeatures.runtimeDescriptorArray = VK_TRUE;
-        indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
-        indexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
-        indexingFeatures.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
-        indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
-        indexingFeatures.shaderStorageImageArrayNonUniformIndexing = VK_TRUE;
-
-        VkPhysicalDeviceBufferDeviceAddressFeaturesKHR bdaFeatures = {};
-        bdaFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES_KHR;
-        bdaFeatures.bufferDeviceAddress = VK_TRUE;
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+        deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+        textureCompressionBC = supportedFeatures.textureCompressionBC == VK_TRUE;
+
+        // Bindless descriptor arrays, buffer device address, indirect count, min/max samplers and timeline semaphores all live in the 1.2 features
+        VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+        vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+        vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        vulkan12Features.descriptorBindingVariableDescriptorCount = VK_TRUE;
+        vulkan12Features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+        vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        vulkan12Features.shaderStorageImageArrayNonUniformIndexing = VK_TRUE;
+        vulkan12Features.bufferDeviceAddress = VK_TRUE;
+        vulkan12Features.drawIndirectCount = VK_TRUE;
+        vulkan12Features.samplerFilterMinmax = VK_TRUE;
+        vulkan12Features.timelineSemaphore = VK_TRUE;
 
         VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {};
         dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
         dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
 
-        // Build the pNext chain (BDA -> Bindless -> Dynamic Rendering)
-        bdaFeatures.pNext = &indexingFeatures;
-        indexingFeatures.pNext = &dynamicRenderingFeatures;
+        // Build the pNext chain (Vulkan 1.2 -> Dynamic Rendering)
+        vulkan12Features.pNext = &dynamicRenderingFeatures;
 
         VkDeviceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -230,7 +238,7 @@ namespace GWIN
         createInfo.pEnabledFeatures = &deviceFeatures;
         createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
         createInfo.ppEnabledExtensionNames = deviceExtensions.data();
-        createInfo.pNext = &bdaFeatures; 
+        createInfo.pNext = &vulkan12Features;
 
         if (enableValidationLayers)
         {
@@ -251,6 +259,7 @@ namespace GWIN
 
         vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
         vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+        vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
     }
 
     void GWinDevice::createCommandPool()
@@ -287,25 +296,27 @@ namespace GWIN
         VkPhysicalDeviceFeatures supportedFeatures;
         vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
-        VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
-        indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
-
-        VkPhysicalDeviceBufferDeviceAddressFeaturesKHR bdaFeatures = {};
-        bdaFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES_KHR;
-        bdaFeatures.pNext = &indexingFeatures; 
+        VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
 
         VkPhysicalDeviceFeatures2 deviceFeatures2 = {};
         deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
-        deviceFeatures2.pNext = &bdaFeatures;
+        deviceFeatures2.pNext = &vulkan12Features;
 
         vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
 
-        bool bindlessSupported = indexingFeatures.descriptorBindingPartiallyBound &&
-                                 indexingFeatures.runtimeDescriptorArray;
-        bool bdaSupported = bdaFeatures.bufferDeviceAddress;
+        // Textures are written into the array while earlier frames using other slots are still in flight
+        bool bindlessSupported = vulkan12Features.descriptorBindingPartiallyBound &&
+                                 vulkan12Features.runtimeDescriptorArray &&
+                                 vulkan12Features.descriptorBindingSampledImageUpdateAfterBind &&
+                                 vulkan12Features.descriptorBindingUpdateUnusedWhilePending;
+        bool bdaSupported = vulkan12Features.bufferDeviceAddress;
+        bool indirectSupported = vulkan12Features.drawIndirectCount &&
+                                 supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance;
+        bool minmaxSupported = vulkan12Features.samplerFilterMinmax; // depth pyramid reduction
 
         return indices.isComplete() && extensionsSupported && swapChainAdequate &&
-               supportedFeatures.samplerAnisotropy && bindlessSupported && bdaSupported;
+               supportedFeatures.samplerAnisotropy && bindlessSupported && bdaSupported && indirectSupported && minmaxSupported;
     }
 
     void GWinDevice::populateDebugMessengerCreateInfo(
@@ -462,6 +473,19 @@ namespace GWIN
             i++;
         }
 
+        // Uploads run on a family without graphics or compute when the device has one, DMA engines copy alongside rendering
+        indices.transferFamily = indices.graphicsFamily;
+        for (uint32_t family = 0; family < queueFamilyCount; ++family)
+        {
+            VkQueueFlags flags = queueFamilies[family].queueFlags;
+            if (queueFamilies[family].queueCount > 0 && (flags & VK_QUEUE_TRANSFER_BIT) &&
+                !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+            {
+                indices.transferFamily = family;
+                break;
+            }
+        }
+
         return indices;
     }
 
@@ -622,47 +646,6 @@ namespace GWIN
         vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
     }
 
-    void GWinDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
-    {
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-        VkBufferCopy copyRegion{};
-        copyRegion.srcOffset = 0; // Optional
-        copyRegion.dstOffset = 0; // Optional
-        copyRegion.size = size;
-        vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-        endSingleTimeCommands(commandBuffer);
-    }
-
-    void GWinDevice::copyBufferToImage(
-        VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount)
-    {
-        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-        VkBufferImageCopy region{};
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = layerCount;
-
-        region.imageOffset = {0, 0, 0};
-        region.imageExtent = {width, height, 1};
-
-        vkCmdCopyBufferToImage(
-            commandBuffer,
-            buffer,
-            image,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            1,
-            &region);
-        endSingleTimeCommands(commandBuffer);
-    }
-
     void GWinDevice::createImageWithInfo(
         const VkImageCreateInfo &imageInfo,
         VmaMemoryUsage memoryUsage,
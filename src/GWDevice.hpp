@@ -20,6 +20,7 @@ namespace GWIN
     {
         uint32_t graphicsFamily;
         uint32_t presentFamily;
+        uint32_t transferFamily; // a transfer only family when there is one, the graphics family otherwise
         bool graphicsFamilyHasValue = false;
         bool presentFamilyHasValue = false;
         bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
@@ -44,6 +45,8 @@ namespace GWIN
         VkSurfaceKHR surface() { return surface_; }
         VkQueue graphicsQueue() { return graphicsQueue_; }
         VkQueue presentQueue() { return presentQueue_; }
+        VkQueue transferQueue() { return transferQueue_; }
+        bool hasDedicatedTransferQueue() { return transferQueue_ != graphicsQueue_; }
         VkSampleCountFlagBits getMaxSamples() { return msaaSamples; }
 
         SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
@@ -62,9 +65,6 @@ namespace GWIN
 
         VkCommandBuffer beginSingleTimeCommands();
         void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-        void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-        void copyBufferToImage(
-            VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
         VkDeviceMemory getBufferMemory(VmaAllocation buffer);
 
         void createImageWithInfo(
@@ -79,6 +79,7 @@ namespace GWIN
         };
 
         VkPhysicalDeviceProperties properties;
+        bool textureCompressionBC = false; // BC1 to BC7 sampled images, cooked textures fall back to RGBA8 without it
 
     private:
         void createInstance();
@@ -114,6 +115,7 @@ namespace GWIN
         VkSurfaceKHR surface_;  
         VkQueue graphicsQueue_;
         VkQueue presentQueue_;
+        VkQueue transferQueue_;
 
         const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
         const std::vector<const char *> deviceExtensions = {
@@ -78,8 +78,8 @@ namespace GWIN
         shaderStages[1].pNext = nullptr;
         shaderStages[1].pSpecializationInfo = nullptr;
 
-        auto AttributeDescriptions = GWModel::Vertex::getAttributeDescriptions();
-        auto BindingDescriptions = GWModel::Vertex::getBindingDescriptions();
+        auto AttributeDescriptions = GWModel::PackedVertex::getAttributeDescriptions();
+        auto BindingDescriptions = GWModel::PackedVertex::getBindingDescriptions();
 
         VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -216,4 +216,42 @@ namespace GWIN
         configInfo.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
         configInfo.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
     }
-}
\ No newline at end of file
+
+    GComputePipeline::GComputePipeline(GWinDevice &device, const std::string &compFilepath, VkPipelineLayout pipelineLayout)
+        : gDevice{device}
+    {
+        assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline: no pipelineLayout provided");
+
+        auto compCode = GPipeLine::readFile(compFilepath);
+        GWIN::createShaderModule(compCode, &compShaderModule, gDevice);
+
+        VkPipelineShaderStageCreateInfo shaderStage{};
+        shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        shaderStage.module = compShaderModule;
+        shaderStage.pName = "main";
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage = shaderStage;
+        pipelineInfo.layout = pipelineLayout;
+        pipelineInfo.basePipelineIndex = -1;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+        if (vkCreateComputePipelines(gDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create compute pipeline");
+        }
+    }
+
+    GComputePipeline::~GComputePipeline()
+    {
+        vkDestroyShaderModule(gDevice.device(), compShaderModule, nullptr);
+        vkDestroyPipeline(gDevice.device(), computePipeline, nullptr);
+    }
+
+    void GComputePipeline::bind(VkCommandBuffer commandBuffer)
+    {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+    }
+}
@@ -49,9 +49,9 @@ namespace GWIN
 
         static void enableAlphaBlending(PipelineConfigInfo &configInfo);
 
-    private:
         static std::vector<char> readFile(const std::string &filepath);
 
+    private:
         void createGraphicsPipeline(
             const std::string &vertFilepath,
             const std::string &fragFilepath,
@@ -65,6 +65,20 @@ namespace GWIN
 
     class GComputePipeline
     {
+    public:
+        GComputePipeline(GWinDevice &device, const std::string &compFilepath, VkPipelineLayout pipelineLayout);
+        ~GComputePipeline();
 
+        GComputePipeline(const GComputePipeline &) = delete;
+        GComputePipeline operator=(const GComputePipeline &) = delete;
+
+        void bind(VkCommandBuffer commandBuffer);
+
+        VkPipeline pipeline() const { return computePipeline; }
+
+    private:
+        GWinDevice &gDevice;
+        VkPipeline computePipeline;
+        VkShaderModule compShaderModule;
     };
 }
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include "GWThreadPool.hpp"
+
+namespace GWIN
+{
+    GWThreadPool::GWThreadPool(uint32_t threadCount)
+    {
+        workers.reserve(threadCount);
+
+        for (uint32_t i = 0; i < threadCount; ++i)
+        {
+            workers.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    GWThreadPool::~GWThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+
+        condition.notify_all();
+
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    void GWThreadPool::enqueue(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            tasks.push(std::move(task));
+        }
+
+        condition.notify_one();
+    }
+
+    void GWThreadPool::workerLoop()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+                if (stopping && tasks.empty())
+                    return;
+
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+
+            task();
+        }
+    }
+
+    void GWThreadPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)> &body)
+    {
+        if (count == 0)
+            return;
+
+        grain = std::max<size_t>(grain, 1);
+        size_t chunks = (count + grain - 1) / grain;
+
+        if (chunks == 1 || workers.empty())
+        {
+            body(0, count);
+            return;
+        }
+
+        struct ForState
+        {
+            std::atomic<size_t> nextChunk{0};
+            std::atomic<size_t> finishedChunks{0};
+            std::mutex mutex;
+            std::condition_variable finished;
+        };
+
+        auto state = std::make_shared<ForState>();
+
+        // Helpers only touch body while they own a chunk, and the caller cannot return before every chunk is done
+        auto run = [state, &body, count, grain, chunks]()
+        {
+            size_t chunk;
+            while ((chunk = state->nextChunk.fetch_add(1)) < chunks)
+            {
+                size_t begin = chunk * grain;
+                body(begin, std::min(begin + grain, count));
+
+                if (state->finishedChunks.fetch_add(1) + 1 == chunks)
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->finished.notify_all();
+                }
+            }
+        };
+
+        size_t helpers = std::min(chunks - 1, workers.size());
+        for (size_t i = 0; i < helpers; ++i)
+        {
+            enqueue(run);
+        }
+
+        run();
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&state, chunks]() { return state->finishedChunks.load() == chunks; });
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace GWIN
+{
+    class GWThreadPool
+    {
+    public:
+        GWThreadPool(uint32_t threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1);
+        ~GWThreadPool();
+
+        GWThreadPool(const GWThreadPool &) = delete;
+        GWThreadPool &operator=(const GWThreadPool &) = delete;
+
+        template <typename F>
+        auto submit(F &&task) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+        {
+            using Result = std::invoke_result_t<std::decay_t<F>>;
+
+            auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+            std::future<Result> future = packaged->get_future();
+
+            enqueue([packaged]() { (*packaged)(); });
+
+            return future;
+        }
+
+        // Splits [0, count) in chunks of grain elements and runs body(begin, end) on them.
+        // The calling thread takes part in the work, so it is safe to call from inside a task.
+        void parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)> &body);
+
+        uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+    private:
+        void enqueue(std::function<void()> task);
+        void workerLoop();
+
+        std::vector<std::thread> workers;
+        std::queue<std::function<void()>> tasks;
+
+        std::mutex queueMutex;
+        std::condition_variable condition;
+        bool stopping{false};
+    };
+}
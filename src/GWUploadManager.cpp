@@ -0,0 +1,623 @@
+#include "GWUploadManager.hpp"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <stdexcept>
+
+// Staged data starts on this boundary, a multiple of every texel block size
+#define UPLOAD_STAGING_ALIGNMENT 16
+
+namespace GWIN
+{
+    namespace
+    {
+        VkDeviceSize alignUp(VkDeviceSize offset) { return (offset + UPLOAD_STAGING_ALIGNMENT - 1) & ~VkDeviceSize(UPLOAD_STAGING_ALIGNMENT - 1); }
+
+        VkCommandPool createPool(GWinDevice &device, uint32_t family)
+        {
+            VkCommandPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.queueFamilyIndex = family;
+            poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+            VkCommandPool pool;
+            if (vkCreateCommandPool(device.device(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create upload command pool!");
+            }
+            return pool;
+        }
+
+        VkSemaphore createTimeline(GWinDevice &device)
+        {
+            VkSemaphoreTypeCreateInfo typeInfo{};
+            typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+            typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+            typeInfo.initialValue = 0;
+
+            VkSemaphoreCreateInfo semaphoreInfo{};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            semaphoreInfo.pNext = &typeInfo;
+
+            VkSemaphore semaphore;
+            if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create upload semaphore!");
+            }
+            return semaphore;
+        }
+
+        uint64_t counterOf(GWinDevice &device, VkSemaphore semaphore)
+        {
+            uint64_t value = 0;
+            vkGetSemaphoreCounterValue(device.device(), semaphore, &value);
+            return value;
+        }
+    }
+
+    GWUploadManager::GWUploadManager(GWinDevice &device, VkDeviceSize stagingSize) : device(device)
+    {
+        QueueFamilyIndices families = device.findPhysicalQueueFamilies();
+        graphicsFamily = families.graphicsFamily;
+        transferFamily = families.transferFamily;
+        dedicatedTransfer = device.hasDedicatedTransferQueue();
+
+        stagingRing = std::make_unique<GWBuffer>(
+            device,
+            stagingSize,
+            1,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VMA_MEMORY_USAGE_CPU_ONLY);
+
+        stagingRing->map();
+        stagingMemory = static_cast<char *>(stagingRing->getMappedMemory());
+
+        transferPool = createPool(device, transferFamily);
+        graphicsPool = createPool(device, graphicsFamily);
+        transferTimeline = createTimeline(device);
+        readyTimeline = createTimeline(device);
+    }
+
+    GWUploadManager::~GWUploadManager()
+    {
+        // Whatever was never submitted is dropped, its command buffers go with the pools
+        if (openBatch.transferCommands != VK_NULL_HANDLE)
+        {
+            vkEndCommandBuffer(openBatch.transferCommands);
+        }
+
+        waitSemaphore(transferTimeline, nextValue - 1);
+        waitSemaphore(readyTimeline, lastReadySignal);
+
+        submittedBatches.clear();
+        openBatch = Batch{};
+
+        vkDestroySemaphore(device.device(), transferTimeline, nullptr);
+        vkDestroySemaphore(device.device(), readyTimeline, nullptr);
+        vkDestroyCommandPool(device.device(), transferPool, nullptr);
+        vkDestroyCommandPool(device.device(), graphicsPool, nullptr);
+    }
+
+    UploadToken GWUploadManager::uploadToBuffer(VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize size)
+    {
+        if (size == 0)
+            return UploadToken::Complete;
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        VkDeviceSize stagingOffset;
+        VkBuffer stagingBuffer = allocateStaging(data, size, stagingOffset);
+
+        VkBufferCopy region{};
+        region.srcOffset = stagingOffset;
+        region.dstOffset = offset;
+        region.size = size;
+        vkCmdCopyBuffer(openTransferCommands(), stagingBuffer, buffer, 1, &region);
+
+        VkBufferMemoryBarrier release{};
+        release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        release.dstAccessMask = dedicatedTransfer ? 0 : VK_ACCESS_MEMORY_READ_BIT;
+        release.srcQueueFamilyIndex = dedicatedTransfer ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+        release.dstQueueFamilyIndex = dedicatedTransfer ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+        release.buffer = buffer;
+        release.offset = offset;
+        release.size = size;
+        openBatch.bufferReleases.push_back(release);
+
+        return static_cast<UploadToken>(nextValue);
+    }
+
+    UploadToken GWUploadManager::uploadToImage(VkImage image, const VkImageSubresourceRange &range, const void *data, VkDeviceSize size,
+                                               const std::vector<VkBufferImageCopy> &regions, VkImageLayout finalLayout)
+    {
+        if (size == 0 || regions.empty())
+            return UploadToken::Complete;
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        VkDeviceSize stagingOffset;
+        VkBuffer stagingBuffer = allocateStaging(data, size, stagingOffset);
+        VkCommandBuffer commandBuffer = openTransferCommands();
+
+        VkImageMemoryBarrier toTransfer{};
+        toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        toTransfer.srcAccessMask = 0;
+        toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toTransfer.image = image;
+        toTransfer.subresourceRange = range;
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &toTransfer);
+
+        std::vector<VkBufferImageCopy> stagedRegions = regions;
+        for (VkBufferImageCopy &region : stagedRegions)
+        {
+            region.bufferOffset += stagingOffset;
+        }
+
+        vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               static_cast<uint32_t>(stagedRegions.size()), stagedRegions.data());
+
+        // The move to the final layout happens between release and acquire
+        VkImageMemoryBarrier release = toTransfer;
+        release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        release.dstAccessMask = dedicatedTransfer ? 0 : VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        release.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        release.newLayout = finalLayout;
+        release.srcQueueFamilyIndex = dedicatedTransfer ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+        release.dstQueueFamilyIndex = dedicatedTransfer ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+        openBatch.imageReleases.push_back(release);
+
+        return static_cast<UploadToken>(nextValue);
+    }
+
+    UploadToken GWUploadManager::recordGraphics(std::function<void(VkCommandBuffer)> commands)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        openBatch.graphicsWork.push_back(std::move(commands));
+
+        return static_cast<UploadToken>(nextValue);
+    }
+
+    UploadToken GWUploadManager::stream(const std::function<void()> &uploads)
+    {
+        {
+            // Whatever was recorded before belongs to callers that use it right away
+            std::lock_guard<std::mutex> lock(mutex);
+            submitTransfers(false);
+        }
+
+        uploads();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (openBatch.isEmpty())
+            return UploadToken::Complete;
+
+        uint64_t value = nextValue;
+        submitTransfers(true);
+        return static_cast<UploadToken>(value);
+    }
+
+    void GWUploadManager::require(UploadToken token)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // Batches still open are not streamed, the next flush readies them anyway
+        if (Batch *batch = findBatch(static_cast<uint64_t>(token)))
+        {
+            batch->required = true;
+        }
+    }
+
+    void GWUploadManager::flush()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        submitTransfers(false);
+        submitReady();
+        reclaim();
+    }
+
+    bool GWUploadManager::isReady(UploadToken token) const
+    {
+        uint64_t value = static_cast<uint64_t>(token);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (value >= nextValue)
+            return false;
+
+        // Batches are only retired once readied and done
+        const Batch *batch = findBatch(value);
+        return batch == nullptr || batch->ready;
+    }
+
+    bool GWUploadManager::isComplete(UploadToken token) const
+    {
+        uint64_t value = static_cast<uint64_t>(token);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (value >= nextValue)
+            return false;
+
+        const Batch *batch = findBatch(value);
+        if (batch == nullptr)
+            return true;
+
+        return batch->ready && batch->readySignal <= counterOf(device, readyTimeline);
+    }
+
+    void GWUploadManager::wait(UploadToken token)
+    {
+        uint64_t value = static_cast<uint64_t>(token);
+        if (value == 0)
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (value >= nextValue)
+        {
+            submitTransfers(false);
+        }
+
+        Batch *batch = findBatch(value);
+        if (batch == nullptr)
+            return;
+
+        batch->required = true;
+        submitReady();
+
+        waitSemaphore(readyTimeline, batch->readySignal);
+        reclaim();
+    }
+
+    GWUploadManager::Batch *GWUploadManager::findBatch(uint64_t value)
+    {
+        return const_cast<Batch *>(std::as_const(*this).findBatch(value));
+    }
+
+    const GWUploadManager::Batch *GWUploadManager::findBatch(uint64_t value) const
+    {
+        // Values are consecutive, the front one is the oldest still around
+        if (submittedBatches.empty() || value < submittedBatches.front().value || value > submittedBatches.back().value)
+            return nullptr;
+
+        return &submittedBatches[value - submittedBatches.front().value];
+    }
+
+    VkBuffer GWUploadManager::allocateStaging(const void *data, VkDeviceSize size, VkDeviceSize &offset)
+    {
+        if (size > stagingRing->getBufferSize())
+        {
+            auto stagingBuffer = std::make_unique<GWBuffer>(
+                device,
+                size,
+                1,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VMA_MEMORY_USAGE_CPU_ONLY);
+
+            stagingBuffer->map();
+            stagingBuffer->writeToBuffer(const_cast<void *>(data), size);
+            stagingBuffer->unmap();
+
+            offset = 0;
+            openBatch.dedicatedStaging.push_back(std::move(stagingBuffer));
+            return openBatch.dedicatedStaging.back()->getBuffer();
+        }
+
+        reclaim();
+
+        // The ring is full of data still to be copied, the oldest batch holding some frees its part first
+        while (!fitsRing(size, offset))
+        {
+            if (openBatch.usesRing)
+            {
+                submitTransfers(false);
+            }
+
+            auto holder = std::find_if(submittedBatches.begin(), submittedBatches.end(), [](const Batch &batch) { return batch.usesRing; });
+            waitSemaphore(transferTimeline, holder->value);
+            reclaim();
+        }
+
+        std::memcpy(stagingMemory + offset, data, size);
+        ringHead = offset + size;
+        openBatch.usesRing = true;
+
+        return stagingRing->getBuffer();
+    }
+
+    bool GWUploadManager::fitsRing(VkDeviceSize size, VkDeviceSize &offset) const
+    {
+        VkDeviceSize capacity = stagingRing->getBufferSize();
+        VkDeviceSize start = alignUp(ringHead);
+
+        // Data in use is [tail, head), free space is behind the head and in front of the tail
+        if (ringHead >= ringTail)
+        {
+            if (start + size <= capacity)
+            {
+                offset = start;
+                return true;
+            }
+
+            // Strictly below the tail so head and tail only meet when the ring is empty
+            if (size < ringTail)
+            {
+                offset = 0;
+                return true;
+            }
+
+            return false;
+        }
+
+        // Wrapped, data in use is [tail, capacity) and [0, head)
+        if (start + size < ringTail)
+        {
+            offset = start;
+            return true;
+        }
+
+        return false;
+    }
+
+    VkCommandBuffer GWUploadManager::beginCommands(VkCommandPool pool, std::vector<VkCommandBuffer> &freeBuffers)
+    {
+        VkCommandBuffer commandBuffer;
+
+        if (freeBuffers.empty())
+        {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandPool = pool;
+            allocInfo.commandBufferCount = 1;
+
+            if (vkAllocateCommandBuffers(device.device(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to allocate upload command buffer!");
+            }
+        }
+        else
+        {
+            commandBuffer = freeBuffers.back();
+            freeBuffers.pop_back();
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        return commandBuffer;
+    }
+
+    VkCommandBuffer GWUploadManager::openTransferCommands()
+    {
+        if (openBatch.transferCommands == VK_NULL_HANDLE)
+        {
+            openBatch.transferCommands = beginCommands(transferPool, freeTransferCommands);
+        }
+        return openBatch.transferCommands;
+    }
+
+    void GWUploadManager::submitTransfers(bool streamed)
+    {
+        if (openBatch.isEmpty())
+            return;
+
+        Batch batch = std::move(openBatch);
+        openBatch = Batch{};
+
+        batch.value = nextValue++;
+        batch.streamed = streamed;
+
+        if (batch.transferCommands != VK_NULL_HANDLE)
+        {
+            // Without a dedicated family the releases are plain barriers that already make the data visible
+            vkCmdPipelineBarrier(
+                batch.transferCommands,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, dedicatedTransfer ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                0,
+                0, nullptr,
+                static_cast<uint32_t>(batch.bufferReleases.size()), batch.bufferReleases.data(),
+                static_cast<uint32_t>(batch.imageReleases.size()), batch.imageReleases.data());
+
+            vkEndCommandBuffer(batch.transferCommands);
+        }
+
+        if (batch.usesRing)
+        {
+            stagingRing->flush();
+            batch.ringEnd = ringHead;
+        }
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &batch.value;
+
+        // A batch of graphics work only still signals, so the values keep counting up in order
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.commandBufferCount = batch.transferCommands != VK_NULL_HANDLE ? 1 : 0;
+        submitInfo.pCommandBuffers = &batch.transferCommands;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &transferTimeline;
+
+        if (vkQueueSubmit(device.transferQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to submit uploads!");
+        }
+
+        submittedBatches.push_back(std::move(batch));
+    }
+
+    void GWUploadManager::submitReady()
+    {
+        uint64_t copiedValue = counterOf(device, transferTimeline);
+
+        // Ordinary batches are needed by the next frame, a streamed one only once its copies are done or someone asks
+        // for it. Streamed batches left waiting do not hold back the ones after them.
+        for (Batch &batch : submittedBatches)
+        {
+            if (batch.ready)
+                continue;
+
+            if (batch.streamed && !batch.required && batch.value > copiedValue)
+                continue;
+
+            readyBatch(batch);
+        }
+    }
+
+    void GWUploadManager::readyBatch(Batch &batch)
+    {
+        bool acquires = dedicatedTransfer && (!batch.bufferReleases.empty() || !batch.imageReleases.empty());
+
+        if (acquires || !batch.graphicsWork.empty())
+        {
+            batch.graphicsCommands = beginCommands(graphicsPool, freeGraphicsCommands);
+
+            if (acquires)
+            {
+                std::vector<VkBufferMemoryBarrier> bufferAcquires = batch.bufferReleases;
+                for (VkBufferMemoryBarrier &barrier : bufferAcquires)
+                {
+                    barrier.srcAccessMask = 0;
+                    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+                }
+
+                std::vector<VkImageMemoryBarrier> imageAcquires = batch.imageReleases;
+                for (VkImageMemoryBarrier &barrier : imageAcquires)
+                {
+                    barrier.srcAccessMask = 0;
+                    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+                }
+
+                vkCmdPipelineBarrier(
+                    batch.graphicsCommands,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                    0,
+                    0, nullptr,
+                    static_cast<uint32_t>(bufferAcquires.size()), bufferAcquires.data(),
+                    static_cast<uint32_t>(imageAcquires.size()), imageAcquires.data());
+            }
+
+            for (const auto &work : batch.graphicsWork)
+            {
+                work(batch.graphicsCommands);
+            }
+
+            vkEndCommandBuffer(batch.graphicsCommands);
+        }
+
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        batch.readySignal = lastReadySignal + 1;
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = 1;
+        timelineInfo.pWaitSemaphoreValues = &batch.value;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &batch.readySignal;
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &transferTimeline;
+        submitInfo.pWaitDstStageMask = &waitStage;
+        submitInfo.commandBufferCount = batch.graphicsCommands != VK_NULL_HANDLE ? 1 : 0;
+        submitInfo.pCommandBuffers = &batch.graphicsCommands;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &readyTimeline;
+
+        if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to submit upload acquires!");
+        }
+
+        batch.graphicsWork.clear();
+        batch.ready = true;
+        lastReadySignal = batch.readySignal;
+    }
+
+    void GWUploadManager::waitSemaphore(VkSemaphore semaphore, uint64_t value)
+    {
+        if (value == 0)
+            return;
+
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &semaphore;
+        waitInfo.pValues = &value;
+        vkWaitSemaphores(device.device(), &waitInfo, UINT64_MAX);
+    }
+
+    void GWUploadManager::reclaim()
+    {
+        uint64_t copiedValue = counterOf(device, transferTimeline);
+        uint64_t readiedValue = counterOf(device, readyTimeline);
+
+        // Staging space and transfer command buffers are free as soon as the copies are done
+        for (Batch &batch : submittedBatches)
+        {
+            if (batch.value > copiedValue)
+                break;
+
+            if (batch.usesRing)
+            {
+                ringTail = batch.ringEnd;
+                batch.usesRing = false;
+            }
+            batch.dedicatedStaging.clear();
+
+            if (batch.transferCommands != VK_NULL_HANDLE)
+            {
+                vkResetCommandBuffer(batch.transferCommands, 0);
+                freeTransferCommands.push_back(batch.transferCommands);
+                batch.transferCommands = VK_NULL_HANDLE;
+            }
+        }
+
+        // Batches readied ahead of a streamed one still copying give back their commands right away
+        for (Batch &batch : submittedBatches)
+        {
+            if (batch.ready && batch.readySignal <= readiedValue && batch.graphicsCommands != VK_NULL_HANDLE)
+            {
+                vkResetCommandBuffer(batch.graphicsCommands, 0);
+                freeGraphicsCommands.push_back(batch.graphicsCommands);
+                batch.graphicsCommands = VK_NULL_HANDLE;
+            }
+        }
+
+        // Retired in order, so findBatch can index by value
+        while (!submittedBatches.empty() && submittedBatches.front().ready && submittedBatches.front().readySignal <= readiedValue)
+        {
+            submittedBatches.pop_front();
+        }
+
+        bool ringInUse = openBatch.usesRing ||
+                         std::any_of(submittedBatches.begin(), submittedBatches.end(), [](const Batch &batch) { return batch.usesRing; });
+        if (!ringInUse)
+        {
+            ringHead = 0;
+            ringTail = 0;
+        }
+    }
+}
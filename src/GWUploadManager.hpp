@@ -0,0 +1,124 @@
+#pragma once
+
+#include "GWDevice.hpp"
+#include "GWBuffer.hpp"
+
+// std
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Size of the persistent staging ring, uploads larger than it get a staging buffer of their own
+#define UPLOAD_STAGING_SIZE (64ull * 1024 * 1024)
+
+namespace GWIN
+{
+    // Batch an upload was recorded into, its value on the transfer semaphore. 0 means nothing to wait for.
+    enum class UploadToken : uint64_t
+    {
+        Complete = 0
+    };
+
+    // Batches uploads into one submission per flush instead of a submission and queue wait per copy.
+    // Data is copied into a persistently mapped staging ring right away and the copies are recorded for the transfer
+    // queue. With a dedicated transfer family a batch is submitted in two parts: the copies with release barriers on the
+    // transfer queue, then the matching acquire barriers and the graphics only work (mip blits) on the graphics queue,
+    // waiting for the copies. A batch is ready once that second part is submitted, later graphics work sees its data.
+    // flush() readies everything recorded the usual way before the frame using it is submitted. Uploads made through
+    // stream() are only readied by a flush after their copies are done, so they overlap with the frames drawn meanwhile;
+    // batches are readied out of order for that, so the ready semaphore counts readied batches instead of batch values.
+    class GWUploadManager
+    {
+    public:
+        GWUploadManager(GWinDevice &device, VkDeviceSize stagingSize = UPLOAD_STAGING_SIZE);
+        ~GWUploadManager();
+
+        GWUploadManager(const GWUploadManager &) = delete;
+        GWUploadManager &operator=(const GWUploadManager &) = delete;
+
+        UploadToken uploadToBuffer(VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize size);
+        // Takes the subresources from UNDEFINED through the copy to finalLayout, nothing may be using them yet.
+        // The bufferOffset of each region is relative to data.
+        UploadToken uploadToImage(VkImage image, const VkImageSubresourceRange &range, const void *data, VkDeviceSize size,
+                                  const std::vector<VkBufferImageCopy> &regions, VkImageLayout finalLayout);
+        // Records graphics queue work into the batch, it runs once the uploads recorded before it are acquired
+        UploadToken recordGraphics(std::function<void(VkCommandBuffer)> commands);
+
+        // Runs uploads, which record into the manager, as a batch of their own that is submitted right away
+        UploadToken stream(const std::function<void()> &uploads);
+        // Makes the next flush ready the token's batch even when its copies are still running, the batches streamed
+        // before it stay as they are
+        void require(UploadToken token);
+
+        // Submits the open batch and readies every required batch and every batch whose copies are done
+        void flush();
+        // Graphics work submitted from now on sees the upload
+        bool isReady(UploadToken token) const;
+        bool isComplete(UploadToken token) const;
+        // Readies the token's batch if needed and waits for it
+        void wait(UploadToken token);
+
+    private:
+        struct Batch
+        {
+            uint64_t value{0};
+            VkCommandBuffer transferCommands{VK_NULL_HANDLE};
+            VkCommandBuffer graphicsCommands{VK_NULL_HANDLE};
+            // Acquire barriers are the same with the access masks of the graphics side
+            std::vector<VkBufferMemoryBarrier> bufferReleases;
+            std::vector<VkImageMemoryBarrier> imageReleases;
+            std::vector<std::function<void(VkCommandBuffer)>> graphicsWork;
+            bool streamed{false};
+            bool required{false}; // streamed, but readied without waiting for its copies
+            bool ready{false};
+            uint64_t readySignal{0}; // value of the ready semaphore once readied
+            bool usesRing{false};
+            VkDeviceSize ringEnd{0};
+            std::vector<std::unique_ptr<GWBuffer>> dedicatedStaging;
+
+            bool isEmpty() const { return transferCommands == VK_NULL_HANDLE && graphicsWork.empty(); }
+        };
+
+        // Returns the staging buffer and the offset of the data in it
+        VkBuffer allocateStaging(const void *data, VkDeviceSize size, VkDeviceSize &offset);
+        bool fitsRing(VkDeviceSize size, VkDeviceSize &offset) const;
+        VkCommandBuffer beginCommands(VkCommandPool pool, std::vector<VkCommandBuffer> &freeBuffers);
+        VkCommandBuffer openTransferCommands();
+
+        // Submitted batch with that value, null once it is retired or while it is still open
+        Batch *findBatch(uint64_t value);
+        const Batch *findBatch(uint64_t value) const;
+
+        void submitTransfers(bool streamed);
+        void submitReady();
+        void readyBatch(Batch &batch);
+        void waitSemaphore(VkSemaphore semaphore, uint64_t value);
+        void reclaim();
+
+        GWinDevice &device;
+        uint32_t graphicsFamily;
+        uint32_t transferFamily;
+        bool dedicatedTransfer;
+
+        std::unique_ptr<GWBuffer> stagingRing;
+        char *stagingMemory{nullptr};
+        VkDeviceSize ringHead{0}; // end of the newest staged data
+        VkDeviceSize ringTail{0}; // start of the oldest staged data still in use
+
+        VkCommandPool transferPool{VK_NULL_HANDLE};
+        VkCommandPool graphicsPool{VK_NULL_HANDLE};
+        std::vector<VkCommandBuffer> freeTransferCommands;
+        std::vector<VkCommandBuffer> freeGraphicsCommands;
+        VkSemaphore transferTimeline{VK_NULL_HANDLE}; // signaled by the copies of each batch
+        VkSemaphore readyTimeline{VK_NULL_HANDLE};    // signaled by the graphics part of each batch, in the order they are readied
+
+        Batch openBatch{};
+        std::deque<Batch> submittedBatches;
+        uint64_t nextValue{1};
+        uint64_t lastReadySignal{0};
+
+        mutable std::mutex mutex;
+    };
+}
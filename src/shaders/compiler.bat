@@ -51,5 +51,23 @@ for /r "%SHADER_DIR%" %%f in (*.frag) do (
     )
 )
 
+:: Compile all .comp shaders
+for /r "%SHADER_DIR%" %%f in (*.comp) do (
+    set SHADER_FILE=%%f
+    set FILE_NAME=%%~nf
+    set FILE_EXT=%%~xf
+
+    :: Set the output file name
+    set OUTPUT_FILE=%OUTPUT_DIR%\!FILE_NAME!!FILE_EXT!.spv
+
+    :: Compile the shader
+    echo Compiling !SHADER_FILE! to !OUTPUT_FILE!
+    %GLSLANG_VALIDATOR% -V !SHADER_FILE! -o !OUTPUT_FILE!
+    if !ERRORLEVEL! NEQ 0 (
+        echo Error compiling !SHADER_FILE!
+        exit /b 1
+    )
+)
+
 echo All shaders compiled successfully!
 exit /b 0
\ No newline at end of file
@@ -2,12 +2,16 @@
 
 #extension GL_EXT_nonuniform_qualifier : enable
 #extension GL_EXT_buffer_reference : enable
+#extension GL_EXT_shader_explicit_arithmetic_types_int64 : enable
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec3 fragPosWorld;
 layout(location = 2) in vec3 fragNormalWorld;
 layout(location = 3) in vec2 fragUv;
 layout(location = 4) in mat3 fragTBN; 
+layout(location = 7) flat in uint fragMaterialIndex;
+layout(location = 8) flat in uint fragTextureIndex[6];
+layout(location = 14) flat in uint fragInstanceFlags;
 
 layout(location = 0) out vec4 outColor;
 
@@ -50,6 +54,8 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
   mat4 sunLightSpaceMatrix;
   lightBuffer light;
   materialBuffer material;
+  uint64_t instances;
+  uint64_t visibleInstances;
   float exposure;
   bool renderShadows;
 } ubo;
@@ -57,15 +63,11 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 #define DIFFUSE_TEX 0
 #define NORMAL_TEX 1
 
+#define INSTANCE_FLAG_TWO_CHANNEL_NORMALS 1
+
 layout(set = 1, binding = 0) uniform sampler2DShadow texSamplerShadow[];
 layout(set = 1, binding = 0) uniform sampler2D texSampler[];
 
-layout(push_constant) uniform Push {
-    mat4 modelMatrix;
-    uint materialIndex;
-    uint textureIndex[6];
-} push;
-
 float shadowCalculation(vec4 fragPosLightSpace, vec3 lightDir, vec3 normal, bool renderShadows) {
     if (!renderShadows)
         return 1.0;
@@ -141,7 +143,7 @@ vec3 ACESFilm(vec3 x) {
 }
 
 void main() {
-    Material material = ubo.material.materials[push.materialIndex];
+    Material material = ubo.material.materials[fragMaterialIndex];
 
     vec3 diffuseLight = ubo.light.ambientLightColor.xyz * ubo.light.ambientLightColor.w;
     vec3 specularLight = vec3(0.0);
@@ -149,7 +151,12 @@ void main() {
     vec3 cameraPosWorld = ubo.invView[3].xyz;
     vec3 viewDirection = normalize(cameraPosWorld - fragPosWorld);
 
-    vec3 normalMap = texture(texSampler[push.textureIndex[NORMAL_TEX]], fragUv).xyz * 2.0 - 1.0;
+    vec3 normalMap = texture(texSampler[fragTextureIndex[NORMAL_TEX]], fragUv).xyz * 2.0 - 1.0;
+    // BC5 normal maps only store x and y, the unit length gives z back
+    if ((fragInstanceFlags & INSTANCE_FLAG_TWO_CHANNEL_NORMALS) != 0)
+    {
+        normalMap.z = sqrt(max(1.0 - dot(normalMap.xy, normalMap.xy), 0.0));
+    }
     normalMap = normalize(fragTBN * normalMap);
 
     if (normalMap.z == 0.0)
@@ -195,7 +202,7 @@ void main() {
         }
     }
 
-    vec4 sampledColor = texture(texSampler[push.textureIndex[DIFFUSE_TEX]], fragUv);
+    vec4 sampledColor = texture(texSampler[fragTextureIndex[DIFFUSE_TEX]], fragUv);
 
     //default if diffuse texture doesn't exist
     if (length(sampledColor) == 0.0) {
@@ -1,27 +1,48 @@
 #version 450
 
+#extension GL_EXT_buffer_reference : enable
+#extension GL_EXT_shader_explicit_arithmetic_types_int64 : enable
+
+// GWModel::PackedVertex, normal and tangent are octahedral encoded
 layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 color;
-layout(location = 2) in vec3 normal;
+layout(location = 2) in vec2 packedNormal;
 layout(location = 3) in vec2 uv;
-layout(location = 4) in vec3 tangent;
+layout(location = 4) in vec2 packedTangent;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec3 fragPosWorld;
 layout(location = 2) out vec3 fragNormalWorld;
 layout(location = 3) out vec2 fragUv;
 layout(location = 4) out mat3 fragTBN; 
+layout(location = 7) flat out uint fragMaterialIndex;
+layout(location = 8) flat out uint fragTextureIndex[6];
+layout(location = 14) flat out uint fragInstanceFlags;
+
+layout(buffer_reference, std430, buffer_reference_align = 4) readonly buffer colorBuffer
+{
+    uint colors[];
+};
+
+struct Instance {
+  mat4 modelMatrix;
+  vec4 boundsCenter;
+  vec4 boundsExtent;
+  uint batchIndex;
+  uint materialIndex;
+  uint textureIndex[6];
+  uint visibilityIndex;
+  uint flags;
+  colorBuffer vertexColors;
+};
 
-struct Light {
-  vec4 position; 
-  vec4 color; 
-  vec4 direction;
-  mat4 lightSpaceMatrix[6]; 
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer instanceBuffer
+{
+    Instance instances[];
 };
 
-struct Material {
-  vec4 color;
-  vec3 data;
+layout(buffer_reference, std430, buffer_reference_align = 4) readonly buffer visibleInstanceBuffer
+{
+    uint visibleInstances[];
 };
 
 layout(set = 0, binding = 0) uniform GlobalUbo {
@@ -30,25 +51,41 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
   mat4 invView;
   vec4 sunLight;
   mat4 sunLightSpaceMatrix;
-  vec4 ambientLightColor;
-  Light lights[20];
-  Material materials[100];
-  int numLights;
+  uint64_t light;
+  uint64_t material;
+  instanceBuffer instance;
+  visibleInstanceBuffer visible;
+  float exposure;
+  bool renderShadows;
 } ubo;
 
-layout(push_constant) uniform Push {
-    mat4 modelMatrix;
-    uint materialIndex;
-    uint textureIndex[6];
-} push;
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0)
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(v);
+}
 
 void main() {
-    vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);
+    // cull.comp packed the visible instances of every batch from firstInstance on
+    Instance instance = ubo.instance.instances[ubo.visible.visibleInstances[gl_InstanceIndex]];
+    mat4 modelMatrix = instance.modelMatrix;
+
+    vec3 normal = decodeOctahedral(packedNormal);
+    vec3 tangent = decodeOctahedral(packedTangent);
+
+    // Meshes without vertex colors used to carry a constant gray in every vertex
+    vec3 color = vec3(0.5);
+    if (uint64_t(instance.vertexColors) != 0)
+        color = unpackUnorm4x8(instance.vertexColors.colors[gl_VertexIndex]).rgb;
+
+    vec4 positionWorld = modelMatrix * vec4(position, 1.0);
     //gl_Position = ubo.sunLightSpaceMatrix * positionWorld;
     gl_Position = ubo.projection * ubo.view * positionWorld;
 
-    vec3 worldNormal = normalize(normalize(mat3(push.modelMatrix) * normal));
-    vec3 worldTangent = normalize(mat3(push.modelMatrix) * tangent);
+    vec3 worldNormal = normalize(normalize(mat3(modelMatrix) * normal));
+    vec3 worldTangent = normalize(mat3(modelMatrix) * tangent);
     vec3 worldBitangent = normalize(cross(worldNormal, worldTangent) * tangent.z);
     
     fragTBN = mat3(worldTangent, worldBitangent, worldNormal);
@@ -56,4 +93,7 @@ void main() {
     fragPosWorld = positionWorld.xyz;
     fragColor = color;
     fragUv = uv;
+    fragMaterialIndex = instance.materialIndex;
+    fragTextureIndex = instance.textureIndex;
+    fragInstanceFlags = instance.flags;
 }
\ No newline at end of file
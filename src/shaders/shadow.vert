@@ -5,10 +5,6 @@ layout(push_constant) uniform PushConstants {
 } push;
 
 layout(location = 0) in vec3 position;
-layout(location = 1) in vec3 color;
-layout(location = 2) in vec3 normal;
-layout(location = 3) in vec2 uv;
-layout(location = 4) in vec3 tangent;
 
 struct Light {
   vec4 position; //w is type; 0 - Point, 1 - Spot
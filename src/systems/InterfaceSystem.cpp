@@ -104,6 +104,25 @@ namespace GWIN
         ImGui::Text("Selected Texture file: %s", texturePathBuffer);
     }
 
+    void GWInterface::pickObject(FrameInfo &frameInfo, ImVec2 viewportPos, ImVec2 viewportSize)
+    {
+        ImVec2 mouse = ImGui::GetMousePos();
+        glm::vec2 ndc = {
+            2.f * (mouse.x - viewportPos.x) / viewportSize.x - 1.f,
+            2.f * (mouse.y - viewportPos.y) / viewportSize.y - 1.f};
+
+        auto &camera = frameInfo.currentInfo.currentCamera;
+        glm::mat4 inverseViewProjection = glm::inverse(camera.getProjection() * camera.getView());
+
+        glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, 0.f, 1.f);
+        glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.f, 1.f);
+        glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+        glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+
+        if (auto hit = frameInfo.currentInfo.bvh.raycast(origin, direction))
+            objectList.selectObject(hit.value(), frameInfo.currentInfo.gameObjects.name(hit.value()));
+    }
+
     void GWInterface::drawImGuizmo(FrameInfo &frameInfo, ImDrawList* drawList)
     {
         uint32_t selectedObject = objectList.getSelectedObject();
@@ -115,9 +134,10 @@ namespace GWIN
             ImGuizmo::SetDrawlist(drawList);
             ImGuizmo::SetImGuiContext(ImGui::GetCurrentContext());
 
-            GWGameObject &gameObject = frameInfo.currentInfo.gameObjects.at(selectedObject);
+            auto &gameObjects = frameInfo.currentInfo.gameObjects;
+            const TransformComponent &transform = gameObjects.transform(selectedObject);
 
-            glm::mat4 transformMatrix = gameObject.transform.mat4();
+            glm::mat4 transformMatrix = gameObjects.worldMatrix(selectedObject);
 
             glm::mat4 view = frameInfo.currentInfo.currentCamera.getView();
             glm::mat4 projection = frameInfo.currentInfo.currentCamera.getProjection();
@@ -131,25 +151,31 @@ namespace GWIN
                                 
             if (ImGuizmo::IsUsing())
             {
+                auto parent = gameObjects.parent(selectedObject);
+                if (parent != GWEntityStore::NO_PARENT)
+                {
+                    transformMatrix = glm::inverse(gameObjects.worldMatrix(parent)) * transformMatrix;
+                }
+
                 glm::vec3 translation, rotation, scale;
                 ImGuizmo::DecomposeMatrixToComponents(glm::value_ptr(transformMatrix),
                                                     glm::value_ptr(translation),
                                                     glm::value_ptr(rotation),
                                                     glm::value_ptr(scale));
 
-                if (glm::any(glm::epsilonNotEqual(gameObject.transform.getRotation(), rotation, glm::epsilon<float>())))
+                if (glm::any(glm::epsilonNotEqual(transform.getRotation(), rotation, glm::epsilon<float>())))
                 {
-                    gameObject.transform.rotateEuler(rotation);
+                    gameObjects.editTransform(selectedObject).rotateEuler(rotation);
                 }
 
-                if(glm::any(glm::epsilonNotEqual(gameObject.transform.translation, translation, glm::epsilon<float>())))
+                if(glm::any(glm::epsilonNotEqual(transform.translation, translation, glm::epsilon<float>())))
                 {
-                    gameObject.transform.translation = translation;
+                    gameObjects.editTransform(selectedObject).translation = translation;
                 }
 
                 if (mCurrentGizmoOperation == ImGuizmo::SCALE)
                 {
-                    gameObject.transform.scale = scale;
+                    gameObjects.editTransform(selectedObject).scale = scale;
                 }
             }
         }
@@ -175,6 +201,17 @@ namespace GWIN
             if (ImGui::CollapsingHeader("Camera Settings"))
             {
                 ImGui::Checkbox("Frustum Culling", &flags.frustumCulling);
+                ImGui::Checkbox("Occlusion Culling", &flags.occlusionCulling);
+                ImGui::Text("Drawn: %u (early %u, late %u)", cullStats.drawnEarly + cullStats.drawnLate, cullStats.drawnEarly, cullStats.drawnLate);
+                ImGui::Text("Frustum culled: %u", cullStats.frustumCulled);
+                ImGui::Text("Occlusion culled: %u", cullStats.occlusionCulled);
+                ImGui::Checkbox("Meshlet Culling", &flags.clusterCulling);
+                ImGui::Text("Meshlets drawn: %u (frustum culled %u, back facing %u)", cullStats.meshletsDrawn, cullStats.meshletsFrustumCulled, cullStats.meshletsBackfaceCulled);
+                ImGui::DragFloat("LOD Bias", &flags.lodBias, 0.05f, 0.f, 16.f);
+                for (uint32_t lod = 0; lod < MAX_MESH_LODS; ++lod)
+                {
+                    ImGui::Text("LOD %u: %u instances, %u triangles", lod, lodStats.instances[lod], lodStats.triangles[lod]);
+                }
                 ImGui::DragFloat("FOV", &fieldOfView, 0.5f, 0.f, FLT_MAX);
             }
         }
@@ -331,6 +368,9 @@ namespace GWIN
             {
                 ImGui::Image((ImTextureID)frameInfo.currentFrameSet, viewportSize);
 
+                if (ImGui::IsItemClicked(ImGuiMouseButton_Left) && !ImGuizmo::IsOver() && !ImGuizmo::IsUsing())
+                    pickObject(frameInfo, viewportPos, viewportSize);
+
                 DebugVisuals::setDrawList(drawList);
 
                 DebugVisuals::setRect(viewportPos.x, viewportPos.y, viewportSize.x, viewportSize.y);
@@ -33,7 +33,10 @@ namespace GWIN
     struct Flags
     {
         bool showShadows{true};
-        bool frustumCulling{false};
+        bool frustumCulling{true};
+        bool occlusionCulling{true};
+        bool clusterCulling{true};
+        float lodBias{1.f};
         bool debugElements{true};
         bool debugHandles{true};
     };
@@ -48,7 +51,7 @@ namespace GWIN
         void newFrame(FrameInfo& frameInfo);
         void render(VkCommandBuffer commandBuffer);
 
-        void setCreateTextureCallback(std::function<void(Texture &texture, uint32_t id)> callback) { createTextureCallback = callback; objectList.setCreateTextureCallback(callback); };
+        void setCreateTextureCallback(std::function<void(const Texture &texture, uint32_t id)> callback) { createTextureCallback = callback; objectList.setCreateTextureCallback(callback); };
         void setSaveSceneCallback(std::function<void(const std::string path)> callback) { SaveSceneCallback = callback;  };
         void setLoadSceneCallback(std::function<void(const std::string path)> callback) { LoadSceneCallback = callback; };
         void setCreateMeshCallback(std::function<uint32_t(const std::string path, std::optional<uint32_t> replaceId)> callback) { createMeshCallback = callback; objectList.setCreateMeshCallback(callback); };
@@ -61,15 +64,18 @@ namespace GWIN
 
         float getExposure() { return exposure; }
         float getFOV() { return fieldOfView; }
-        glm::vec4 getLightDirection(GWGameObject& directionalLight) { return {directionalLight.transform.getRotation(), DirectionalLightingIntensity}; }
+        glm::vec4 getLightDirection(const TransformComponent& directionalLight) { return {directionalLight.getRotation(), DirectionalLightingIntensity}; }
 
         Flags getFlags() { return flags; }
 
+        void setCullStats(const CullStats &stats) { cullStats = stats; }
+        void setLodStats(const LodStats &stats) { lodStats = stats; }
+
     private:
         GWindow& window;
         GWinDevice& device;
 
-        std::function<void(Texture &texture, bool replace)> createTextureCallback;
+        std::function<void(const Texture &texture, bool replace)> createTextureCallback;
         std::function<void(const std::string path)> SaveSceneCallback;
         std::function<void(const std::string path)> LoadSceneCallback;
         std::function<uint32_t(const std::string path, std::optional<uint32_t> replaceId)> createMeshCallback;
@@ -82,6 +88,7 @@ namespace GWIN
 
         void initializeGUI(VkFormat imageFormat);
         void drawImGuizmo(FrameInfo &frameInfo, ImDrawList* drawList);
+        void pickObject(FrameInfo &frameInfo, ImVec2 viewportPos, ImVec2 viewportSize);
         void drawSceneSettings();
 
         GWConsole console{};
@@ -98,6 +105,8 @@ namespace GWIN
         float fieldOfView = 50.f;
 
         Flags flags; 
+        CullStats cullStats{};
+        LodStats lodStats{};
 
         std::unique_ptr<GWDescriptorPool> guipool;
     };
@@ -30,25 +30,34 @@ namespace GWIN
 
         auto& camera = frameInfo.currentInfo.currentCamera;
 
-        for (auto& kv : frameInfo.currentInfo.gameObjects) {
-            auto& obj = kv.second;
-            if (obj.light == nullptr) continue;
+        auto& gameObjects = frameInfo.currentInfo.gameObjects;
+        auto& lights = gameObjects.getLights();
+        auto& owners = gameObjects.getLightOwners();
+        auto& worldMatrices = gameObjects.getWorldMatrices();
+
+        for (size_t i = 0; i < lights.size(); ++i) {
+            auto& lightComponent = lights[i];
+            uint32_t index = gameObjects.indexOf(owners[i]);
+            glm::vec3 position = glm::vec3(worldMatrices[index][3]);
+            // Lights shine along their world forward axis (+z), parents rotate them as well. The shader compares the
+            // direction with the one from the fragment to the light, so it gets the reverse.
+            glm::vec3 direction = -glm::normalize(glm::vec3(worldMatrices[index][2]));
 
             assert(lightIndex < MAX_LIGHTS && "Point lights exceed maximum specified");
 
             auto& light = ubo.lights[lightIndex];
 
-            if (obj.light->cutOffAngle == 0.f)
+            if (lightComponent.cutOffAngle == 0.f)
             {
-                light.Position = glm::vec4(obj.transform.translation, 0.f);
-                light.Direction = glm::vec4(obj.transform.getRotation(), 0.0f);
+                light.Position = glm::vec4(position, 0.f);
+                light.Direction = glm::vec4(direction, 0.0f);
             } else {
-                light.Position = glm::vec4(obj.transform.translation, 1.f);
-                light.Direction = glm::vec4(obj.transform.getRotation(), glm::cos(obj.light->cutOffAngle));
+                light.Position = glm::vec4(position, 1.f);
+                light.Direction = glm::vec4(direction, glm::cos(lightComponent.cutOffAngle));
             }
 
             //calculateLightMatrix(light.lightSpaceMatrix, SHADOW_WIDTH / SHADOW_HEIGHT, camera.getNearClip(), camera.getFarClip());
-            light.Color = glm::vec4(obj.color, obj.light->lightIntensity);
+            light.Color = glm::vec4(lightComponent.color, lightComponent.lightIntensity);
 
             lightIndex += 1;
         }
@@ -18,9 +18,10 @@ namespace GWIN
         : window(window), device(device)
     {
         renderer = std::make_unique<GWRenderer>(window, device);
-        offscreenRenderer = std::make_unique<GWOffscreenRenderer>(window, device, renderer->getImageCount(), VK_FORMAT_D32_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT);
-        shadowMapRenderer = std::make_unique<GWShadowRenderer>(window, device, renderer->getSwapChainDepthFormat(), renderer->getImageCount());
-        cubemapHandler = std::make_unique<GWCubemapHandler>(device);
+        offscreenRenderer = std::make_unique<GWOffscreenRenderer>(window, device, deletionQueue, GWinSwapChain::MAX_FRAMES_IN_FLIGHT, VK_FORMAT_D32_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT);
+        shadowMapRenderer = std::make_unique<GWShadowRenderer>(window, device, renderer->getSwapChainDepthFormat());
+        depthPyramid = std::make_unique<GWDepthPyramid>(window, device);
+        cubemapHandler = std::make_unique<GWCubemapHandler>(device, threadPool, uploadManager);
         materialHandler = std::make_unique<GWMaterialHandler>(device);
 
         initialize();
@@ -29,7 +30,7 @@ namespace GWIN
         //Initializes GUI
         interfaceSystem = std::make_unique<GWInterface>(window, device, renderer->getSwapChainImageFormat(), textureHandler, materialHandler);
 
-        interfaceSystem->setCreateTextureCallback([this](Texture &texture, uint32_t id) {
+        interfaceSystem->setCreateTextureCallback([this](const Texture &texture, uint32_t id) {
             currentScene->createSet(texture, id);
         });
 
@@ -80,8 +81,10 @@ namespace GWIN
                           .setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT | VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT)
                           .build();
 
+        // New textures are written while the frames in flight sample other slots of the array
         textureSetLayout = GWDescriptorSetLayout::Builder(device)
-                               .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, device.properties.limits.maxPerStageDescriptorSamplers)
+                               .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, device.properties.limits.maxPerStageDescriptorSamplers,
+                                           VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT)
                                .addBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
                                .build();
 
@@ -110,37 +113,40 @@ namespace GWIN
                 .build(globalDescriptorSets[i]);
         }
 
-        lightBuffer = std::make_unique<GWBuffer>(
-            device,
-            sizeof(LightBuffer),
-            1,
-            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-            VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-        lightBuffer->map();
-
-        materialBuffer = std::make_unique<GWBuffer>(
-            device,
-            sizeof(MaterialBuffer),
-            1,
-            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-            VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-        materialBuffer->map();
+        for (size_t i = 0; i < lightBuffers.size(); ++i)
+        {
+            lightBuffers[i] = std::make_unique<GWBuffer>(
+                device,
+                sizeof(LightBuffer),
+                1,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+            lightBuffers[i]->map();
+
+            materialBuffers[i] = std::make_unique<GWBuffer>(
+                device,
+                sizeof(MaterialBuffer),
+                1,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+            materialBuffers[i]->map();
+        }
 
         std::vector<VkDescriptorSetLayout> setLayouts = {globalSetLayout->getDescriptorSetLayout(), textureSetLayout->getDescriptorSetLayout()};
 
-        textureHandler = std::make_unique<GWTextureHandler>(imageLoader, device);
+        textureHandler = std::make_unique<GWTextureHandler>(imageLoader, device, threadPool, deletionQueue);
 
-        modelLoader.setCreateTextureCallback([this](Texture &texture)
+        modelLoader.setCreateTextureCallback([this](const Texture &texture)
                                              { currentScene->createSet(texture); });
 
-        SceneCreateInfo createInfo{device, textureSetLayout, texturePool, modelLoader, jsonHandler, textureHandler, materialHandler};
+        SceneCreateInfo createInfo{device, textureSetLayout, texturePool, modelLoader, jsonHandler, textureHandler, materialHandler, threadPool, uploadManager};
         
         currentScene = std::make_unique<GWScene>(createInfo);
 
-        renderSystem = std::make_unique<RenderSystem>(device, false, setLayouts);
-        wireframeRenderSystem = std::make_unique<RenderSystem>(device, true, setLayouts);
+        renderSystem = std::make_unique<RenderSystem>(device, false, setLayouts, *depthPyramid);
+        wireframeRenderSystem = std::make_unique<RenderSystem>(device, true, setLayouts, *depthPyramid);
         lightSystem = std::make_unique<LightSystem>();
         skyboxSystem = std::make_unique<SkyboxSystem>(device, setLayouts);
         shadowSystem = std::make_unique<ShadowSystem>(device, setLayouts);
@@ -149,9 +155,15 @@ namespace GWIN
     void MasterRenderSystem::updateCamera(FrameInfo& frameInfo, float FOV)
     {
         auto& camera = frameInfo.currentInfo.currentCamera;
-        auto &viewerObject = frameInfo.currentInfo.gameObjects.at(camera.getViewerObject());
-        cameraController.moveInPlaneXZ(window.getWindow(), frameInfo.deltaTime,  viewerObject);
-        camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.getRotation());
+        auto &gameObjects = frameInfo.currentInfo.gameObjects;
+        TransformComponent viewerTransform = gameObjects.transform(camera.getViewerObject());
+
+        if (cameraController.moveInPlaneXZ(window.getWindow(), frameInfo.deltaTime, viewerTransform))
+        {
+            gameObjects.editTransform(camera.getViewerObject()) = viewerTransform;
+        }
+
+        camera.setViewYXZ(viewerTransform.translation, viewerTransform.getRotation());
 
         float aspect = renderer->getAspectRatio();
         camera.setPerspectiveProjection(glm::radians(FOV), aspect, 0.1f, 100.f);
@@ -172,7 +184,7 @@ namespace GWIN
             try {
                 json = std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
 
-                SceneCreateInfo createInfo{device, textureSetLayout, texturePool, modelLoader, jsonHandler, textureHandler, materialHandler, "DefaultScene", json};
+                SceneCreateInfo createInfo{device, textureSetLayout, texturePool, modelLoader, jsonHandler, textureHandler, materialHandler, threadPool, uploadManager, "DefaultScene", json};
 
                 vkDeviceWaitIdle(device.device());
 
@@ -203,6 +215,9 @@ namespace GWIN
             {
                 int frameIndex = renderer->getFrameIndex();
 
+                // The fence of this frame's slot was just waited for, what only older frames used can go
+                deletionQueue.beginFrame();
+
                 bool isWireFrame = false;
 
                 // update
@@ -214,7 +229,9 @@ namespace GWIN
                     currentCam,
                     currentScene->getGameObjects(),
                     currentScene->getMeshes(),
-                    currentScene->getTextures()};
+                    currentScene->getTextures(),
+                    currentScene->getSkybox(),
+                    currentScene->getBVH()};
 
                 FrameInfo frameInfo{
                     frameIndex,
@@ -225,8 +242,12 @@ namespace GWIN
                     VK_NULL_HANDLE};
 
                 frameInfo.flags.frustumCulling = interfaceFlags.frustumCulling;
+                frameInfo.flags.occlusionCulling = interfaceFlags.occlusionCulling;
+                frameInfo.flags.clusterCulling = interfaceFlags.clusterCulling;
+                frameInfo.flags.lodBias = interfaceFlags.lodBias;
 
                 updateCamera(frameInfo, interfaceSystem->getFOV());
+                currentScene->update();
 
                 LightBuffer light{};
                 lightSystem->update(frameInfo, light);
@@ -234,44 +255,48 @@ namespace GWIN
                 MaterialBuffer material{};
                 materialHandler->setMaterials(material);
 
-                lightBuffer->writeToIndex(&light, 0);
-                lightBuffer->flushIndex(0);
+                if (glfwGetKey(window.getWindow(), cameraController.keys.activateWireframe))
+                {
+                    isWireFrame = true;
+                }
+
+                // The culling dispatch has to be recorded before any rendering starts
+                RenderSystem &sceneRenderSystem = isWireFrame ? *wireframeRenderSystem : *renderSystem;
+                offscreenRenderer->beginFrame(frameIndex);
+                depthPyramid->checkExtent();
+                sceneRenderSystem.prepareDraws(frameInfo);
+                interfaceSystem->setCullStats(sceneRenderSystem.getCullStats());
+                interfaceSystem->setLodStats(sceneRenderSystem.getLodStats());
 
-                materialBuffer->writeToIndex(&material, 0);
-                materialBuffer->flushIndex(0);
+                lightBuffers[frameIndex]->writeToIndex(&light, 0);
+                lightBuffers[frameIndex]->flushIndex(0);
+
+                materialBuffers[frameIndex]->writeToIndex(&material, 0);
+                materialBuffers[frameIndex]->flushIndex(0);
 
                 GlobalUbo ubo{};
                 ubo.projection = frameInfo.currentInfo.currentCamera.getProjection();
                 ubo.view = frameInfo.currentInfo.currentCamera.getView();
                 ubo.inverseView = frameInfo.currentInfo.currentCamera.getInverseView();
-                ubo.sunLight = interfaceSystem->getLightDirection(frameInfo.currentInfo.gameObjects.at(1));
+                ubo.sunLight = interfaceSystem->getLightDirection(frameInfo.currentInfo.gameObjects.transform(1));
                 ubo.exposure = interfaceSystem->getExposure();
                 ubo.renderShadows = interfaceFlags.showShadows;
-                ubo.light = lightBuffer->getBufferDeviceAddress();
-                ubo.material = materialBuffer->getBufferDeviceAddress();
+                ubo.light = lightBuffers[frameIndex]->getBufferDeviceAddress();
+                ubo.material = materialBuffers[frameIndex]->getBufferDeviceAddress();
+                ubo.instances = sceneRenderSystem.getInstanceAddress(frameIndex);
+                ubo.visibleInstances = sceneRenderSystem.getVisibleInstanceAddress(frameIndex);
 
-                auto& currentViewerObj = currentScene->getGameObjects().at(frameInfo.currentInfo.currentCamera.getViewerObject());
+                auto& currentViewerTransform = currentScene->getGameObjects().transform(frameInfo.currentInfo.currentCamera.getViewerObject());
 
-                ubo.sunLightSpaceMatrix = lightSystem->calculateDirectionalLightMatrix(currentViewerObj.transform.translation, ubo.sunLight);
+                ubo.sunLightSpaceMatrix = lightSystem->calculateDirectionalLightMatrix(currentViewerTransform.translation, ubo.sunLight);
                 globalUboBuffer->writeToIndex(&ubo, frameIndex);
                 globalUboBuffer->flushIndex(frameIndex);
 
-                if (glfwGetKey(window.getWindow(), cameraController.keys.activateWireframe))
-                {
-                    isWireFrame = true;
-                }
-
                 if (interfaceFlags.showShadows)
                 {
                     shadowMapRenderer->startOffscreenRenderPass(commandBuffer);
                     shadowSystem->render(frameInfo);
                     shadowMapRenderer->endOffscreenRenderPass(commandBuffer);
-
-                    shadowMapRenderer->createNextImage();
-                    auto shadowImageView = shadowMapRenderer->getCurrentImageView();
-                    auto shadowSampler = shadowMapRenderer->getImageSampler();
-
-                    currentScene->createSet(VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, shadowImageView, shadowSampler, 0);
                 }
 
                 offscreenRenderer->startOffscreenRenderPass(commandBuffer);
@@ -281,11 +306,17 @@ namespace GWIN
                     skyboxSystem->render(frameInfo);
                 }
 
-                if (isWireFrame)
+                sceneRenderSystem.renderGameObjects(frameInfo, CullPhase::Early);
+
+                // Whatever the early phase drew occludes the rest
+                if (frameInfo.flags.occlusionCulling)
                 {
-                    wireframeRenderSystem->renderGameObjects(frameInfo);
-                } else {
-                   renderSystem->renderGameObjects(frameInfo);
+                    offscreenRenderer->pauseOffscreenRenderPass(commandBuffer);
+                    depthPyramid->build(commandBuffer, offscreenRenderer->getCurrentDepthImageView(), offscreenRenderer->getDepthExtent());
+                    sceneRenderSystem.prepareLateDraws(frameInfo);
+                    offscreenRenderer->resumeOffscreenRenderPass(commandBuffer);
+
+                    sceneRenderSystem.renderGameObjects(frameInfo, CullPhase::Late);
                 }
 
                 if (isLoading)
@@ -296,11 +327,7 @@ namespace GWIN
 
                 offscreenRenderer->endOffscreenRenderPass(commandBuffer);
 
-                offscreenRenderer->createNextImage();
-                frameInfo.currentFrameSet = ImGui_ImplVulkan_AddTexture(
-                    offscreenRenderer->getImageSampler(),
-                    offscreenRenderer->getCurrentImageView(),
-                    VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL);
+                frameInfo.currentFrameSet = getViewportSet(frameIndex);
                 
                 // render
                 interfaceSystem->newFrame(frameInfo);
@@ -309,24 +336,56 @@ namespace GWIN
 
                 interfaceSystem->render(commandBuffer);
                 renderer->endSwapChainRenderPass(commandBuffer);
-                renderer->endFrame();
 
-                vkDeviceWaitIdle(device.device());
-
-                ImGui_ImplVulkan_RemoveTexture(frameInfo.currentFrameSet);
-                frameInfo.currentFrameSet = VK_NULL_HANDLE;
+                // Everything loaded this frame goes to the queue ahead of the frame that draws it
+                uploadManager.flush();
+                renderer->endFrame();
 
                 isWireFrame = false;
             }
         }
 
         vkDeviceWaitIdle(device.device());
+
+        // The interface goes away before the queue, its descriptor sets have to be freed while it is there
+        for (auto &viewportSet : viewportSets)
+        {
+            if (viewportSet != VK_NULL_HANDLE)
+                ImGui_ImplVulkan_RemoveTexture(viewportSet);
+            viewportSet = VK_NULL_HANDLE;
+        }
+        viewportViews = {};
+
+        deletionQueue.flush();
+    }
+
+    VkDescriptorSet MasterRenderSystem::getViewportSet(int frameIndex)
+    {
+        VkImageView imageView = offscreenRenderer->getCurrentImageView();
+        if (viewportViews[frameIndex] == imageView)
+            return viewportSets[frameIndex];
+
+        // The targets were reallocated, frames in flight may still sample through the old set
+        if (viewportSets[frameIndex] != VK_NULL_HANDLE)
+        {
+            deletionQueue.defer([viewportSet = viewportSets[frameIndex]]() { ImGui_ImplVulkan_RemoveTexture(viewportSet); });
+        }
+
+        viewportSets[frameIndex] = ImGui_ImplVulkan_AddTexture(offscreenRenderer->getImageSampler(), imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        viewportViews[frameIndex] = imageView;
+
+        return viewportSets[frameIndex];
     }
 
     void MasterRenderSystem::loadGameObjects()
     {
-        Texture no_texture = textureHandler->createTexture(std::string("src/textures/no_texture.png"), true);
-        currentScene->createSet(no_texture);
+        defaultTexture = textureHandler->acquireTexture("src/textures/no_texture.png", true);
+        currentScene->createSet(*defaultTexture);
+
+        // Slot 0 always holds the shadow map, it is rendered and sampled in place every frame
+        VkImageView shadowImageView = shadowMapRenderer->getImageView();
+        VkSampler shadowSampler = shadowMapRenderer->getImageSampler();
+        currentScene->createSet(VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, shadowImageView, shadowSampler, 0);
         CubeMapInfo info{};
         info.negX = "src/textures/cubeMap/nx.png";
         info.posX = "src/textures/cubeMap/px.png";
@@ -347,14 +406,14 @@ namespace GWIN
         skyboxSystem->setSkybox(skyboxSet, texture2.id);
 
         uint32_t model = currentScene->createMesh("src/models/Sponza/sponza.obj", std::nullopt);
-        GWGameObject& obj = GWGameObject::createGameObject("Sponza");
+        GWGameObject obj = GWGameObject::createGameObject("Sponza");
         obj.model = model;
         obj.transform.scale = glm::vec3{0.02f, 0.02f, 0.02f};
 
         currentScene->createGameObject(obj);
 
         uint32_t model2 = currentScene->createMesh("src/models/quad.obj", std::nullopt);
-        GWGameObject& obj2 = GWGameObject::createGameObject("Quad");
+        GWGameObject obj2 = GWGameObject::createGameObject("Quad");
         obj2.model = model2;
 
         currentScene->getMeshes().at(model2)->Textures[0] = 0;
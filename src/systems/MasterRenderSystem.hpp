@@ -15,6 +15,11 @@
 #include "../GWRendererToolkit.hpp"
 #include "GWOffscreenRenderer.hpp"
 #include "GWShadowRenderer.hpp"
+#include "GWDepthPyramid.hpp"
+#include "GWGeometryPool.hpp"
+#include "../GWThreadPool.hpp"
+#include "../GWUploadManager.hpp"
+#include "../GWDeletionQueue.hpp"
 
 #include <stdexcept>
 #include <chrono>
@@ -39,12 +44,28 @@ namespace GWIN
 
         void loadNewScene(const std::string pathToFile);
 
+        // Interface descriptor of the frame's offscreen target
+        VkDescriptorSet getViewportSet(int frameIndex);
+
         GWindow& window;
         GWinDevice& device;
 
+        // Declared first so whatever is released while the rest is destroyed is still deleted
+        GWDeletionQueue deletionQueue{GWinSwapChain::MAX_FRAMES_IN_FLIGHT};
+        GWThreadPool threadPool{};
+        GWUploadManager uploadManager{device};
+
+        // Declared early so every model, including the ones held by the systems, is released before it
+        GWGeometryPool geometryPool{device, uploadManager, deletionQueue, sizeof(GWModel::PackedVertex)};
+
         std::unique_ptr<GWRenderer> renderer;
         std::unique_ptr<GWOffscreenRenderer> offscreenRenderer;
         std::unique_ptr<GWShadowRenderer> shadowMapRenderer;
+        std::unique_ptr<GWDepthPyramid> depthPyramid;
+
+        // One per offscreen target, only replaced when the targets are reallocated
+        std::array<VkDescriptorSet, GWinSwapChain::MAX_FRAMES_IN_FLIGHT> viewportSets{};
+        std::array<VkImageView, GWinSwapChain::MAX_FRAMES_IN_FLIGHT> viewportViews{};
 
         //Render Systems
         std::unique_ptr<RenderSystem> renderSystem;
@@ -55,19 +76,21 @@ namespace GWIN
         std::unique_ptr<ShadowSystem> shadowSystem;
 
         std::unique_ptr<GWBuffer> globalUboBuffer;
-        std::unique_ptr<GWBuffer> lightBuffer;
-        std::unique_ptr<GWBuffer> materialBuffer;
+        // One per frame in flight, the CPU writes the next frame's while the GPU reads the last one's
+        std::array<std::unique_ptr<GWBuffer>, GWinSwapChain::MAX_FRAMES_IN_FLIGHT> lightBuffers;
+        std::array<std::unique_ptr<GWBuffer>, GWinSwapChain::MAX_FRAMES_IN_FLIGHT> materialBuffers;
         std::vector<VkDescriptorSet> globalDescriptorSets;
         std::unique_ptr<GWDescriptorPool> globalPool{};
         std::unique_ptr<GWDescriptorPool> texturePool{};
         std::unique_ptr<GWDescriptorSetLayout> textureSetLayout;
 
-        GWImageLoader imageLoader{device};
+        GWImageLoader imageLoader{device, uploadManager, deletionQueue};
         std::unique_ptr<GWTextureHandler> textureHandler;
+        TextureHandle defaultTexture; // id 1, what models without a texture sample
         std::unique_ptr<GWCubemapHandler> cubemapHandler;
         std::unique_ptr<GWMaterialHandler> materialHandler;
         
-        GWModelLoader modelLoader{device, textureHandler};
+        GWModelLoader modelLoader{geometryPool, textureHandler, threadPool};
 
         JSONHandler jsonHandler{};
 
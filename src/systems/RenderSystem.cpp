@@ -1,22 +1,69 @@
 #include "RenderSystem.hpp"
 
 #include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cstddef>
 #include <iostream>
 
 namespace GWIN
 {
-    struct SpushConstant
+    #define CULL_FLAG_FRUSTUM 1
+    #define CULL_FLAG_OCCLUSION 2
+
+    // Matches shader.frag
+    #define INSTANCE_FLAG_TWO_CHANNEL_NORMALS 1
+
+    struct CullPushConstant
     {
-        glm::mat4 modelMatrix{1.f};
-        uint32_t MaterialIndex;
-        uint32_t TextureIndex[6];
+        glm::mat4 viewProjection;
+        DeviceAddress instances;
+        DeviceAddress visibleInstances;
+        DeviceAddress draws;
+        DeviceAddress visibility;
+        DeviceAddress stats;
+        DeviceAddress drawCounts;
+        uint32_t instanceCount;
+        uint32_t batchCount;
+        uint32_t phase;
+        uint32_t flags;
     };
 
-    RenderSystem::RenderSystem(GWinDevice &device, bool isWireFrame, std::vector<VkDescriptorSetLayout> setLayouts)
-        : GDevice(device)
+    static_assert(sizeof(CullPushConstant) <= 128, "CullPushConstant must fit the guaranteed push constant size");
+
+    struct ClusterCullPushConstant
+    {
+        glm::mat4 viewProjection;
+        glm::vec3 cameraPosition;
+        uint32_t phase;
+        DeviceAddress clusterBatches;
+        DeviceAddress instances;
+        DeviceAddress visibleInstances;
+        DeviceAddress draws;
+        DeviceAddress drawCounts;
+        DeviceAddress stats;
+    };
+
+    static_assert(sizeof(ClusterCullPushConstant) <= 128, "ClusterCullPushConstant must fit the guaranteed push constant size");
+
+    // Clustered batches are the rows of the dispatch and their tasks its columns, both within the guaranteed workgroup counts
+    #define MAX_CLUSTER_BATCHES 65535u
+    #define MAX_CLUSTER_TASKS (65535u * 64u)
+
+    static_assert(alignof(GWModel) >= MAX_MESH_LODS, "Batches keep the LOD in the low bits of the mesh address");
+
+    // Meshes with the same key are drawn from the same vertex and index buffer
+    static uint32_t geometryBinding(const GWModel *mesh)
+    {
+        return mesh->getGeometryChunk() * 2 + (mesh->getIndexType() == VK_INDEX_TYPE_UINT16 ? 0 : 1);
+    }
+
+    RenderSystem::RenderSystem(GWinDevice &device, bool isWireFrame, std::vector<VkDescriptorSetLayout> setLayouts, GWDepthPyramid &depthPyramid)
+        : GDevice(device), depthPyramid(depthPyramid)
     {
         createPipelineLayout(setLayouts);
         createPipeline(isWireFrame);
+        createCullPipeline();
+        createClusterCullPipeline();
     }
 
     RenderSystem::~RenderSystem()
@@ -25,21 +72,27 @@ namespace GWIN
         {
             vkDestroyPipelineLayout(GDevice.device(), pipelineLayout, nullptr);
         }
+
+        if (cullPipelineLayout != VK_NULL_HANDLE)
+        {
+            vkDestroyPipelineLayout(GDevice.device(), cullPipelineLayout, nullptr);
+        }
+
+        if (clusterCullPipelineLayout != VK_NULL_HANDLE)
+        {
+            vkDestroyPipelineLayout(GDevice.device(), clusterCullPipelineLayout, nullptr);
+        }
     }
 
     void RenderSystem::createPipelineLayout(std::vector<VkDescriptorSetLayout> setLayouts)
     {
-        VkPushConstantRange pushConstant{};
-        pushConstant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-        pushConstant.offset = 0;
-        pushConstant.size = sizeof(SpushConstant);
-
+        // Everything per draw comes from the instance buffer, so there are no push constants
         VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
         pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
         pipelineLayoutInfo.pSetLayouts = setLayouts.data();
-        pipelineLayoutInfo.pushConstantRangeCount = 1;
-        pipelineLayoutInfo.pPushConstantRanges = &pushConstant;
+        pipelineLayoutInfo.pushConstantRangeCount = 0;
+        pipelineLayoutInfo.pPushConstantRanges = nullptr;
 
         if (vkCreatePipelineLayout(GDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
         {
@@ -75,7 +128,218 @@ namespace GWIN
         }
     }
 
-    void RenderSystem::renderGameObjects(FrameInfo &frameInfo)
+    void RenderSystem::createCullPipeline()
+    {
+        VkPushConstantRange pushConstant{};
+        pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstant.offset = 0;
+        pushConstant.size = sizeof(CullPushConstant);
+
+        VkDescriptorSetLayout pyramidSetLayout = depthPyramid.getSetLayout();
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &pyramidSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstant;
+
+        if (vkCreatePipelineLayout(GDevice.device(), &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to Create Cull Pipeline Layout!");
+        }
+
+        cullPipeline = std::make_unique<GComputePipeline>(GDevice, "src/shaders/cull.comp.spv", cullPipelineLayout);
+    }
+
+    void RenderSystem::createClusterCullPipeline()
+    {
+        VkPushConstantRange pushConstant{};
+        pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstant.offset = 0;
+        pushConstant.size = sizeof(ClusterCullPushConstant);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 0;
+        pipelineLayoutInfo.pSetLayouts = nullptr;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstant;
+
+        if (vkCreatePipelineLayout(GDevice.device(), &pipelineLayoutInfo, nullptr, &clusterCullPipelineLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to Create Cluster Cull Pipeline Layout!");
+        }
+
+        clusterCullPipeline = std::make_unique<GComputePipeline>(GDevice, "src/shaders/clustercull.comp.spv", clusterCullPipelineLayout);
+    }
+
+    DeviceAddress RenderSystem::getInstanceAddress(int frameIndex) const
+    {
+        auto &buffers = frameBuffers[frameIndex];
+        return buffers.instances ? buffers.instances->getBufferDeviceAddress() : DeviceAddress::Invalid;
+    }
+
+    DeviceAddress RenderSystem::getVisibleInstanceAddress(int frameIndex) const
+    {
+        auto &buffers = frameBuffers[frameIndex];
+        return buffers.visibleInstances ? buffers.visibleInstances->getBufferDeviceAddress() : DeviceAddress::Invalid;
+    }
+
+    void RenderSystem::prepareDraws(FrameInfo &frameInfo)
+    {
+        auto &buffers = frameBuffers[frameInfo.frameIndex];
+
+        // The slot of this frame index is no longer in flight, so its stats are complete and its buffers can be overwritten directly
+        if (buffers.stats)
+        {
+            buffers.stats->invalidate();
+            cullStats = *static_cast<CullStats *>(buffers.stats->getMappedMemory());
+        }
+
+        gatherInstances(frameInfo);
+        reserveFrameBuffers(frameInfo.frameIndex);
+        reserveVisibility(frameInfo.commandBuffer);
+
+        CullStats emptyStats{};
+        buffers.stats->writeToBuffer(&emptyStats, sizeof(CullStats));
+        buffers.stats->flush();
+
+        if (instances.empty())
+            return;
+
+        buffers.instances->writeToBuffer(instances.data(), instances.size() * sizeof(InstanceData));
+        buffers.instances->flush();
+        buffers.draws->writeToBuffer(drawCommands.data(), drawCommands.size() * sizeof(DrawCommand));
+        buffers.draws->flush();
+        buffers.drawCounts->writeToBuffer(drawCounts.data(), drawCounts.size() * sizeof(uint32_t));
+        buffers.drawCounts->flush();
+
+        if (!clusterBatches.empty())
+        {
+            buffers.clusterBatches->writeToBuffer(clusterBatches.data(), clusterBatches.size() * sizeof(ClusterBatch));
+            buffers.clusterBatches->flush();
+        }
+
+        dispatchCull(frameInfo, CullPhase::Early);
+    }
+
+    void RenderSystem::prepareLateDraws(FrameInfo &frameInfo)
+    {
+        if (!frameInfo.flags.occlusionCulling || instances.empty())
+            return;
+
+        dispatchCull(frameInfo, CullPhase::Late);
+    }
+
+    void RenderSystem::dispatchCull(FrameInfo &frameInfo, CullPhase phase)
+    {
+        auto &buffers = frameBuffers[frameInfo.frameIndex];
+        auto &camera = frameInfo.currentInfo.currentCamera;
+
+        // Visibility is read and written by the culling of the previous frame as well
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+        vkCmdPipelineBarrier(
+            frameInfo.commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            1, &barrier,
+            0, nullptr,
+            0, nullptr);
+
+        CullPushConstant push{};
+        push.viewProjection = camera.getProjection() * camera.getView();
+        push.instances = buffers.instances->getBufferDeviceAddress();
+        push.visibleInstances = buffers.visibleInstances->getBufferDeviceAddress();
+        push.draws = buffers.draws->getBufferDeviceAddress();
+        push.visibility = visibility->getBufferDeviceAddress();
+        push.stats = buffers.stats->getBufferDeviceAddress();
+        push.drawCounts = buffers.drawCounts->getBufferDeviceAddress();
+        push.instanceCount = static_cast<uint32_t>(instances.size());
+        push.batchCount = static_cast<uint32_t>(batches.size());
+        push.phase = static_cast<uint32_t>(phase);
+        push.flags = (frameInfo.flags.frustumCulling ? CULL_FLAG_FRUSTUM : 0) |
+                     (frameInfo.flags.occlusionCulling ? CULL_FLAG_OCCLUSION : 0);
+
+        VkDescriptorSet pyramidSet = depthPyramid.getSampleSet();
+
+        cullPipeline->bind(frameInfo.commandBuffer);
+        vkCmdBindDescriptorSets(
+            frameInfo.commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            cullPipelineLayout,
+            0, 1,
+            &pyramidSet,
+            0,
+            nullptr);
+
+        vkCmdPushConstants(
+            frameInfo.commandBuffer,
+            cullPipelineLayout,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0,
+            sizeof(CullPushConstant),
+            &push);
+
+        vkCmdDispatch(frameInfo.commandBuffer, (push.instanceCount + 63) / 64, 1, 1);
+
+        if (!clusterBatches.empty())
+        {
+            // The meshlet pass reads the instances cull.comp just wrote into the batch commands
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+            vkCmdPipelineBarrier(
+                frameInfo.commandBuffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0,
+                1, &barrier,
+                0, nullptr,
+                0, nullptr);
+
+            ClusterCullPushConstant clusterPush{};
+            clusterPush.viewProjection = push.viewProjection;
+            clusterPush.cameraPosition = glm::vec3(camera.getInverseView()[3]);
+            clusterPush.phase = push.phase;
+            clusterPush.clusterBatches = buffers.clusterBatches->getBufferDeviceAddress();
+            clusterPush.instances = push.instances;
+            clusterPush.visibleInstances = push.visibleInstances;
+            clusterPush.draws = push.draws;
+            clusterPush.drawCounts = push.drawCounts;
+            clusterPush.stats = push.stats;
+
+            clusterCullPipeline->bind(frameInfo.commandBuffer);
+            vkCmdPushConstants(
+                frameInfo.commandBuffer,
+                clusterCullPipelineLayout,
+                VK_SHADER_STAGE_COMPUTE_BIT,
+                0,
+                sizeof(ClusterCullPushConstant),
+                &clusterPush);
+
+            vkCmdDispatch(frameInfo.commandBuffer, (maxClusterTasks + 63) / 64, static_cast<uint32_t>(clusterBatches.size()), 1);
+        }
+
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(
+            frameInfo.commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+            0,
+            1, &barrier,
+            0, nullptr,
+            0, nullptr);
+    }
+
+    void RenderSystem::renderGameObjects(FrameInfo &frameInfo, CullPhase phase)
     {
         assert(Pipeline && "Pipeline must be created before calling renderGameObjects");
 
@@ -98,62 +362,377 @@ namespace GWIN
             0,
             nullptr);
 
-        for (auto &kv : frameInfo.currentInfo.gameObjects)
+        if (instances.empty() || (phase == CullPhase::Late && !frameInfo.flags.occlusionCulling))
+            return;
+
+        auto &buffers = frameBuffers[frameInfo.frameIndex];
+        VkBuffer drawBuffer = buffers.draws->getBuffer();
+        VkBuffer countBuffer = buffers.drawCounts->getBuffer();
+
+        // One bind and one indirect draw per geometry pool chunk and index type, the count skips the commands culled away at its end.
+        // Chunks with clustered batches get a second draw for the meshlet commands, which are packed from the start of their range.
+        size_t firstCommand = phase == CullPhase::Late ? batches.size() : 0;
+        size_t firstCount = phase == CullPhase::Late ? chunkDraws.size() : 0;
+        size_t firstMeshletCommand = phase == CullPhase::Late ? meshletCommandCount : 0;
+        size_t firstMeshletCount = chunkDraws.size() * (phase == CullPhase::Late ? 3 : 2);
+        for (uint32_t c = 0; c < chunkDraws.size(); ++c)
         {
-            auto &obj = kv.second;
-            if (obj.model == -1 || obj.getName() == "Skybox")
-                continue;
+            const ChunkDraw &chunkDraw = chunkDraws[c];
+
+            batches[chunkDraw.firstBatch].mesh->bind(frameInfo.commandBuffer);
+            vkCmdDrawIndexedIndirectCount(
+                frameInfo.commandBuffer,
+                drawBuffer, (firstCommand + chunkDraw.firstBatch) * sizeof(DrawCommand),
+                countBuffer, (firstCount + c) * sizeof(uint32_t),
+                chunkDraw.batchCount,
+                sizeof(DrawCommand));
+
+            if (chunkDraw.meshletCommandCount > 0)
+            {
+                vkCmdDrawIndexedIndirectCount(
+                    frameInfo.commandBuffer,
+                    drawBuffer, (firstMeshletCommand + chunkDraw.firstMeshletCommand) * sizeof(DrawCommand),
+                    countBuffer, (firstMeshletCount + c) * sizeof(uint32_t),
+                    chunkDraw.meshletCommandCount,
+                    sizeof(DrawCommand));
+            }
+        }
+    }
+
+    void RenderSystem::gatherInstances(FrameInfo &frameInfo)
+    {
+        auto &gameObjects = frameInfo.currentInfo.gameObjects;
+        auto &ids = gameObjects.getIds();
+        auto &models = gameObjects.getModels();
+        auto &worldMatrices = gameObjects.getWorldMatrices();
+
+        // Whole objects still come from the BVH, so the upload only grows with what is on screen.
+        // The meshes of those objects are then culled one by one on the GPU.
+        drawIndices.clear();
+        if (frameInfo.flags.frustumCulling)
+        {
+            visibleIds.clear();
+            frameInfo.currentInfo.bvh.queryFrustum(frameInfo.currentInfo.currentCamera.getFrustum().getPlanes(), visibleIds);
+
+            for (GWGameObject::id_t id : visibleIds)
+            {
+                drawIndices.push_back(gameObjects.indexOf(id));
+            }
+            std::sort(drawIndices.begin(), drawIndices.end());
+        }
+        else
+        {
+            drawIndices.resize(ids.size());
+            for (uint32_t i = 0; i < ids.size(); ++i)
+            {
+                drawIndices[i] = i;
+            }
+        }
+
+        // Keys of deleted objects pile up, dropping them all only costs one frame of late draws
+        if (visibilitySlots.size() > 2 * instances.size() + 1024)
+        {
+            visibilitySlots.clear();
+        }
+
+        instances.clear();
+        batches.clear();
+        batchOfMeshLod.clear();
+        lodStats = {};
+
+        auto &camera = frameInfo.currentInfo.currentCamera;
+        glm::vec3 cameraPosition = glm::vec3(camera.getInverseView()[3]);
+        float projectionScale = GWModel::lodProjectionScale(camera.getProjection());
+        float lodBias = frameInfo.flags.lodBias;
 
-            if (frameInfo.flags.frustumCulling && !frameInfo.currentInfo.currentCamera.isPointInFrustum(obj.transform.translation))
+        auto addInstance = [&](GWModel *mesh, const glm::mat4 &world, GWGameObject::id_t id, uint32_t meshOrdinal)
+        {
+            if (mesh->numIndices() == 0)
+                return;
+
+            uint64_t key = (static_cast<uint64_t>(id) << 32) | meshOrdinal;
+            auto slot = visibilitySlots.try_emplace(key, static_cast<uint32_t>(visibilitySlots.size())).first;
+
+            // Every LOD of a mesh is its own batch, they differ only in their index range
+            uint32_t lod = mesh->selectLod(world, cameraPosition, projectionScale, lodBias);
+            uintptr_t batchKey = reinterpret_cast<uintptr_t>(mesh) | lod;
+
+            auto [it, inserted] = batchOfMeshLod.try_emplace(batchKey, static_cast<uint32_t>(batches.size()));
+            if (inserted)
+            {
+                batches.push_back({mesh, lod, 0, 0});
+            }
+            batches[it->second].instanceCount++;
+
+            lodStats.instances[lod]++;
+            lodStats.triangles[lod] += mesh->getLod(lod).indexCount / 3;
+
+            const GWModel::Bounds &bounds = mesh->getBounds();
+
+            InstanceData instance{};
+            instance.modelMatrix = world;
+            instance.boundsCenter = glm::vec4((bounds.min + bounds.max) * 0.5f, 0.f);
+            instance.boundsExtent = glm::vec4((bounds.max - bounds.min) * 0.5f, 0.f);
+            instance.batchIndex = it->second;
+            instance.materialIndex = mesh->Material;
+            std::copy(mesh->Textures.begin(), mesh->Textures.end(), instance.textureIndex);
+            instance.visibilityIndex = slot->second;
+            instance.flags = mesh->hasTwoChannelNormals() ? INSTANCE_FLAG_TWO_CHANNEL_NORMALS : 0;
+            instance.vertexColors = mesh->getVertexColorAddress();
+
+            instances.push_back(instance);
+        };
+
+        for (uint32_t i : drawIndices)
+        {
+            if (models[i] == -1 || ids[i] == frameInfo.currentInfo.skybox)
                 continue;
 
-            auto &model = frameInfo.currentInfo.meshes.at(obj.model);
+            auto &model = frameInfo.currentInfo.meshes.at(models[i]);
+            auto &subModels = model->getSubModels();
+            for (uint32_t m = 0; m < subModels.size(); ++m)
+            {
+                addInstance(subModels[m].get(), worldMatrices[i], ids[i], m);
+            }
+            addInstance(model.get(), worldMatrices[i], ids[i], static_cast<uint32_t>(subModels.size()));
+        }
+
+        // Batches of the same chunk and index type have to be next to each other to share a draw
+        batchOrder.resize(batches.size());
+        for (uint32_t b = 0; b < batches.size(); ++b)
+        {
+            batchOrder[b] = b;
+        }
+        std::stable_sort(batchOrder.begin(), batchOrder.end(), [this](uint32_t a, uint32_t b)
+                         { return geometryBinding(batches[a].mesh) < geometryBinding(batches[b].mesh); });
+
+        sortedBatches.resize(batches.size());
+        batchRemap.resize(batches.size());
+        for (uint32_t b = 0; b < batches.size(); ++b)
+        {
+            sortedBatches[b] = batches[batchOrder[b]];
+            batchRemap[batchOrder[b]] = b;
+        }
+        batches.swap(sortedBatches);
+
+        for (InstanceData &instance : instances)
+        {
+            instance.batchIndex = batchRemap[instance.batchIndex];
+        }
+
+        chunkDraws.clear();
+        for (uint32_t b = 0; b < batches.size(); ++b)
+        {
+            if (b == 0 || geometryBinding(batches[b].mesh) != geometryBinding(batches[b - 1].mesh))
+            {
+                chunkDraws.push_back({b, 0, 0, 0});
+            }
+            chunkDraws.back().batchCount++;
+        }
+
+        // Each batch gets a range of the visible instance buffer per phase, cull.comp fills it and counts the instances.
+        // The late commands follow the early ones and use the second half of the buffer.
+        uint32_t instanceCount = static_cast<uint32_t>(instances.size());
+        uint32_t chunkCount = static_cast<uint32_t>(chunkDraws.size());
+        drawCommands.resize(batches.size() * 2);
+        drawCounts.assign(chunkCount * 4, 0);
+
+        clusterBatches.clear();
+        meshletCommandCount = 0;
+        maxClusterTasks = 0;
 
-            if (model->hasSubModels())
+        uint32_t firstInstance = 0;
+        for (uint32_t c = 0; c < chunkCount; ++c)
+        {
+            chunkDraws[c].firstMeshletCommand = meshletCommandCount;
+
+            for (uint32_t i = 0; i < chunkDraws[c].batchCount; ++i)
             {
-                for (auto &subModel : model->getSubModels())
+                uint32_t b = chunkDraws[c].firstBatch + i;
+                GWModel *mesh = batches[b].mesh;
+
+                batches[b].firstInstance = firstInstance;
+                firstInstance += batches[b].instanceCount;
+
+                DrawCommand &draw = drawCommands[b];
+                draw = {};
+                const GWModel::Lod &lod = mesh->getLod(batches[b].lod);
+
+                draw.command.indexCount = lod.indexCount;
+                draw.command.instanceCount = 0;
+                draw.command.firstIndex = lod.firstIndex;
+                draw.command.vertexOffset = mesh->getVertexOffset();
+                draw.command.firstInstance = batches[b].firstInstance;
+                draw.countIndex = c;
+                draw.countValue = i + 1;
+
+                // Every kept instance may need all of its meshlets, the chunk reserves that many commands
+                uint32_t clusterTasks = batches[b].instanceCount * mesh->getMeshletCount();
+                if (frameInfo.flags.clusterCulling && batches[b].lod == 0 && mesh->getMeshletCount() > 0 &&
+                    clusterTasks <= MAX_CLUSTER_TASKS && clusterBatches.size() < MAX_CLUSTER_BATCHES)
                 {
-                    SpushConstant subPush{};
-                    subPush.modelMatrix = obj.transform.mat4(); 
-                    subPush.MaterialIndex = subModel->Material;
-
-                    for (uint32_t i = 0; i < subModel->Textures.size(); ++i)
-                    {
-                        subPush.TextureIndex[i] = subModel->Textures[i]; 
-                    }
-
-                    vkCmdPushConstants(
-                        frameInfo.commandBuffer,
-                        pipelineLayout,
-                        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                        0,
-                        sizeof(SpushConstant),
-                        &subPush);
-
-                    subModel->bind(frameInfo.commandBuffer);
-                    subModel->draw(frameInfo.commandBuffer);
+                    ClusterBatch cluster{};
+                    cluster.meshlets = mesh->getMeshletAddress();
+                    cluster.meshletCount = mesh->getMeshletCount();
+                    cluster.flags = frameInfo.flags.frustumCulling ? CULL_FLAG_FRUSTUM : 0;
+                    cluster.batchDraw[0] = b;
+                    cluster.batchDraw[1] = static_cast<uint32_t>(batches.size()) + b;
+                    cluster.firstCommand[0] = chunkDraws[c].firstMeshletCommand;
+                    cluster.countIndex[0] = chunkCount * 2 + c;
+                    cluster.countIndex[1] = chunkCount * 3 + c;
+                    clusterBatches.push_back(cluster);
+
+                    chunkDraws[c].meshletCommandCount += clusterTasks;
+                    meshletCommandCount += clusterTasks;
+                    maxClusterTasks = std::max(maxClusterTasks, clusterTasks);
+
+                    draw.command.indexCount = 0;
                 }
+
+                DrawCommand &lateDraw = drawCommands[batches.size() + b];
+                lateDraw = draw;
+                lateDraw.command.firstInstance = instanceCount + batches[b].firstInstance;
+                lateDraw.countIndex = chunkCount + c;
             }
+        }
 
-            SpushConstant push{};
-            push.modelMatrix = obj.transform.mat4();
-            push.MaterialIndex = model->Material;
+        // Meshlet commands follow all batch commands, the late ones after the early ones
+        uint32_t meshletCommandBase = static_cast<uint32_t>(drawCommands.size());
+        for (ChunkDraw &chunkDraw : chunkDraws)
+        {
+            chunkDraw.firstMeshletCommand += meshletCommandBase;
+        }
+        for (ClusterBatch &cluster : clusterBatches)
+        {
+            cluster.firstCommand[0] += meshletCommandBase;
+            cluster.firstCommand[1] = cluster.firstCommand[0] + meshletCommandCount;
+        }
+    }
+
+    void RenderSystem::reserveFrameBuffers(int frameIndex)
+    {
+        auto &buffers = frameBuffers[frameIndex];
+
+        // Grow geometrically so a scene that keeps gaining objects doesn't reallocate every frame
+        uint32_t instanceCapacity = buffers.instances ? buffers.instances->getInstanceCount() : 0;
+        if (instances.size() > instanceCapacity || !buffers.instances)
+        {
+            instanceCapacity = std::max<uint32_t>({64, static_cast<uint32_t>(instances.size()), instanceCapacity * 2});
+
+            buffers.instances = std::make_unique<GWBuffer>(
+                GDevice,
+                sizeof(InstanceData),
+                instanceCapacity,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                VMA_MEMORY_USAGE_CPU_TO_GPU);
+            buffers.instances->map();
+
+            buffers.visibleInstances = std::make_unique<GWBuffer>(
+                GDevice,
+                sizeof(uint32_t),
+                instanceCapacity * 2,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                VMA_MEMORY_USAGE_GPU_ONLY);
+        }
+
+        // Only the batch commands are uploaded, the meshlet commands behind them are written by clustercull.comp
+        uint32_t drawCount = static_cast<uint32_t>(drawCommands.size()) + meshletCommandCount * 2;
+        uint32_t drawCapacity = buffers.draws ? buffers.draws->getInstanceCount() : 0;
+        if (drawCount > drawCapacity || !buffers.draws)
+        {
+            drawCapacity = std::max<uint32_t>({64, drawCount, drawCapacity * 2});
 
-            for (uint32_t i = 0; i < model->Textures.size(); ++i)
+            buffers.draws = std::make_unique<GWBuffer>(
+                GDevice,
+                sizeof(DrawCommand),
+                drawCapacity,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                VMA_MEMORY_USAGE_CPU_TO_GPU);
+            buffers.draws->map();
+        }
+
+        uint32_t countCapacity = buffers.drawCounts ? buffers.drawCounts->getInstanceCount() : 0;
+        if (drawCounts.size() > countCapacity || !buffers.drawCounts)
+        {
+            countCapacity = std::max<uint32_t>({16, static_cast<uint32_t>(drawCounts.size()), countCapacity * 2});
+
+            buffers.drawCounts = std::make_unique<GWBuffer>(
+                GDevice,
+                sizeof(uint32_t),
+                countCapacity,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                VMA_MEMORY_USAGE_CPU_TO_GPU);
+            buffers.drawCounts->map();
+        }
+
+        uint32_t clusterCapacity = buffers.clusterBatches ? buffers.clusterBatches->getInstanceCount() : 0;
+        if (clusterBatches.size() > clusterCapacity || !buffers.clusterBatches)
+        {
+            clusterCapacity = std::max<uint32_t>({64, static_cast<uint32_t>(clusterBatches.size()), clusterCapacity * 2});
+
+            buffers.clusterBatches = std::make_unique<GWBuffer>(
+                GDevice,
+                sizeof(ClusterBatch),
+                clusterCapacity,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                VMA_MEMORY_USAGE_CPU_TO_GPU);
+            buffers.clusterBatches->map();
+        }
+
+        if (!buffers.stats)
+        {
+            buffers.stats = std::make_unique<GWBuffer>(
+                GDevice,
+                sizeof(CullStats),
+                1,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                VMA_MEMORY_USAGE_GPU_TO_CPU);
+            buffers.stats->map();
+        }
+    }
+
+    void RenderSystem::reserveVisibility(VkCommandBuffer commandBuffer)
+    {
+        uint32_t capacity = visibility ? visibility->getInstanceCount() : 0;
+        if (visibilitySlots.size() > capacity || !visibility)
+        {
+            capacity = std::max<uint32_t>({1024, static_cast<uint32_t>(visibilitySlots.size()), capacity * 2});
+
+            // Shared with the frames still in flight, growing is rare enough to just wait for them
+            if (visibility)
             {
-                push.TextureIndex[i] = model->Textures[i];
+                vkDeviceWaitIdle(GDevice.device());
             }
 
-            vkCmdPushConstants(
-                frameInfo.commandBuffer,
-                pipelineLayout,
-                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                0,
-                sizeof(SpushConstant),
-                &push);
-
-            model->bind(frameInfo.commandBuffer);
-            model->draw(frameInfo.commandBuffer);
+            visibility = std::make_unique<GWBuffer>(
+                GDevice,
+                sizeof(uint32_t),
+                capacity,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                VMA_MEMORY_USAGE_GPU_ONLY);
+            visibilityCleared = false;
         }
+
+        if (visibilityCleared)
+            return;
+
+        // Nothing was visible before the first frame, so it all goes through the late phase
+        vkCmdFillBuffer(commandBuffer, visibility->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            1, &barrier,
+            0, nullptr,
+            0, nullptr);
+
+        visibilityCleared = true;
     }
-}
\ No newline at end of file
+}
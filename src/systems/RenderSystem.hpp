@@ -3,37 +3,172 @@
 #include "../GWindow.hpp"
 #include "../GWDevice.hpp"
 #include "../GWPipeLine.hpp"
+#include "../GWBuffer.hpp"
 #include "../EC/GWFrameInfo.hpp"
 #include "../EC/GWGameObject.hpp"
 #include "../EC/GWCamera.hpp"
+#include "../EC/GWDepthPyramid.hpp"
 // std
+#include <array>
 #include <memory>
 #include <vector>
 #include <stdexcept>
+#include <unordered_map>
 
 #include "../GWSwapChain.hpp"
 
 namespace GWIN
 {
+    // Matches Instance in shader.vert, shader.frag and cull.comp (std430)
+    struct InstanceData
+    {
+        glm::mat4 modelMatrix{1.f};
+        glm::vec4 boundsCenter{0.f}; // local space box
+        glm::vec4 boundsExtent{0.f};
+        uint32_t batchIndex;
+        uint32_t materialIndex;
+        uint32_t textureIndex[6];
+        uint32_t visibilityIndex; // stable slot of this object and mesh in the visibility buffer
+        uint32_t flags;           // INSTANCE_FLAG_*
+        DeviceAddress vertexColors; // Invalid when the mesh has no vertex colors
+    };
+
+    // VkDrawIndexedIndirectCommand followed by the draw count it raises once it gets its first instance.
+    // countValue is the position of the command in its chunk plus one, so the count trims the empty commands at the end.
+    struct DrawCommand
+    {
+        VkDrawIndexedIndirectCommand command;
+        uint32_t countIndex;
+        uint32_t countValue;
+        uint32_t padding;
+    };
+
+    // Full detail batch of a mesh with meshlets. cull.comp still fills the batch's instances, but its own command
+    // draws nothing, clustercull.comp expands every kept instance into one command per meshlet that survives.
+    struct ClusterBatch
+    {
+        DeviceAddress meshlets;
+        uint32_t meshletCount;
+        uint32_t flags;
+        uint32_t batchDraw[2];    // early and late command of the batch
+        uint32_t firstCommand[2]; // meshlet commands of the batch's chunk, early and late
+        uint32_t countIndex[2];
+    };
+
+    static_assert(sizeof(InstanceData) == 144, "InstanceData must match the std430 layout in the shaders");
+    static_assert(sizeof(DrawCommand) == 32, "DrawCommand must match the std430 layout in cull.comp");
+    static_assert(sizeof(ClusterBatch) == 40, "ClusterBatch must match the std430 layout in clustercull.comp");
+
+    enum class CullPhase
+    {
+        Early, // instances visible last frame, before the depth pyramid exists
+        Late   // everything else, tested against the pyramid of the early depth
+    };
+
+    // Draws the scene GPU driven: every mesh of every object becomes an instance, cull.comp culls them
+    // and fills one indirect command per mesh. Meshes share the buffers of their geometry pool chunk, so
+    // each chunk and index type is bound once and drawn with a single vkCmdDrawIndexedIndirectCount.
+    // With occlusion culling the instances visible last frame are drawn first, the depth pyramid is built
+    // from that depth and the remaining instances are tested against it and drawn in a second phase.
+    // Full detail meshes split into meshlets are drawn meshlet by meshlet after a second compute pass
+    // rejected the ones outside the frustum or facing away, with the same draws on any Vulkan 1.3 device.
     class RenderSystem
     {
     public:
-        RenderSystem(GWinDevice &device, bool isWireFrame, std::vector<VkDescriptorSetLayout> setLayouts);
+        RenderSystem(GWinDevice &device, bool isWireFrame, std::vector<VkDescriptorSetLayout> setLayouts, GWDepthPyramid &depthPyramid);
         ~RenderSystem();
 
         RenderSystem(const RenderSystem &) = delete;
         RenderSystem &operator=(const RenderSystem &) = delete;
 
-        void renderGameObjects(FrameInfo& frameInfo);
+        // Uploads the instances and records the early culling dispatch, must be called outside of rendering
+        void prepareDraws(FrameInfo &frameInfo);
+        // Records the late culling dispatch, must be called after the depth pyramid was built and outside of rendering
+        void prepareLateDraws(FrameInfo &frameInfo);
+        void renderGameObjects(FrameInfo& frameInfo, CullPhase phase = CullPhase::Early);
+
+        DeviceAddress getInstanceAddress(int frameIndex) const;
+        DeviceAddress getVisibleInstanceAddress(int frameIndex) const;
+
+        // Counts of the last frame whose results reached the CPU, MAX_FRAMES_IN_FLIGHT frames behind
+        const CullStats &getCullStats() const { return cullStats; }
+        // Instances and triangles submitted per LOD this frame, before GPU culling
+        const LodStats &getLodStats() const { return lodStats; }
 
         VkPipeline getPipeline() const { return Pipeline->pipeline(); };
     private:
         void createPipelineLayout(std::vector<VkDescriptorSetLayout> setLayouts);
         void createPipeline(bool isWireFrame);
+        void createCullPipeline();
+        void createClusterCullPipeline();
+
+        void gatherInstances(FrameInfo &frameInfo);
+        void reserveFrameBuffers(int frameIndex);
+        void reserveVisibility(VkCommandBuffer commandBuffer);
+        void dispatchCull(FrameInfo &frameInfo, CullPhase phase);
 
         VkPipelineLayout pipelineLayout;
+        VkPipelineLayout cullPipelineLayout;
+        VkPipelineLayout clusterCullPipelineLayout;
 
         GWinDevice& GDevice;
         std::unique_ptr<GPipeLine> Pipeline;
+        std::unique_ptr<GComputePipeline> cullPipeline;
+        std::unique_ptr<GComputePipeline> clusterCullPipeline;
+        GWDepthPyramid &depthPyramid;
+
+        struct DrawBatch
+        {
+            GWModel *mesh;
+            uint32_t lod;
+            uint32_t firstInstance;
+            uint32_t instanceCount;
+        };
+
+        // Batches of one geometry pool chunk and index type, contiguous after sorting,
+        // and the range its meshlet commands may fill when some of them are clustered
+        struct ChunkDraw
+        {
+            uint32_t firstBatch;
+            uint32_t batchCount;
+            uint32_t firstMeshletCommand;
+            uint32_t meshletCommandCount;
+        };
+
+        struct FrameBuffers
+        {
+            std::unique_ptr<GWBuffer> instances;
+            std::unique_ptr<GWBuffer> visibleInstances;
+            std::unique_ptr<GWBuffer> draws; // early commands, late commands, then early and late meshlet commands
+            std::unique_ptr<GWBuffer> drawCounts; // one count per chunk, early then late, then the same for meshlets
+            std::unique_ptr<GWBuffer> clusterBatches;
+            std::unique_ptr<GWBuffer> stats;
+        };
+
+        std::array<FrameBuffers, GWinSwapChain::MAX_FRAMES_IN_FLIGHT> frameBuffers;
+
+        // Shared by all frames, each frame's late phase writes what the next early phase reads
+        std::unique_ptr<GWBuffer> visibility;
+        bool visibilityCleared{false};
+        std::unordered_map<uint64_t, uint32_t> visibilitySlots; // object id and mesh ordinal to visibility entry
+
+        CullStats cullStats{};
+        LodStats lodStats{};
+
+        // Rebuilt every frame, kept between frames to avoid reallocating
+        std::vector<GWGameObject::id_t> visibleIds;
+        std::vector<uint32_t> drawIndices; // dense indices of the objects to draw, ascending
+        std::vector<InstanceData> instances;
+        std::vector<DrawCommand> drawCommands;
+        std::vector<DrawBatch> batches;
+        std::vector<ChunkDraw> chunkDraws;
+        std::vector<uint32_t> drawCounts;
+        std::vector<ClusterBatch> clusterBatches;
+        uint32_t meshletCommandCount{0}; // per phase
+        uint32_t maxClusterTasks{0}; // instances times meshlets of the largest clustered batch
+        std::vector<DrawBatch> sortedBatches;
+        std::vector<uint32_t> batchOrder; // sorted position to gathered batch
+        std::vector<uint32_t> batchRemap; // gathered batch to sorted position
+        std::unordered_map<uintptr_t, uint32_t> batchOfMeshLod; // mesh address with the LOD in its low bits
     };
-}
\ No newline at end of file
+}
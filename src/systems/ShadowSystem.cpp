@@ -80,15 +80,25 @@ namespace GWIN
             0,
             nullptr);
 
-        for (auto &kv : frameInfo.currentInfo.gameObjects)
+        auto &gameObjects = frameInfo.currentInfo.gameObjects;
+        auto &models = gameObjects.getModels();
+        auto &shadowFlags = gameObjects.getShadowFlags();
+        auto &worldMatrices = gameObjects.getWorldMatrices();
+
+        // LODs follow the main camera, so shadows match the geometry on screen
+        auto &camera = frameInfo.currentInfo.currentCamera;
+        glm::vec3 cameraPosition = glm::vec3(camera.getInverseView()[3]);
+        float projectionScale = GWModel::lodProjectionScale(camera.getProjection());
+        float lodBias = frameInfo.flags.lodBias;
+
+        for (size_t i = 0; i < models.size(); ++i)
         {
-            auto &obj = kv.second;
-            if (!obj.castShadow || obj.model == -1)
+            if (!shadowFlags[i] || models[i] == -1)
                 continue;
 
-            auto &model = frameInfo.currentInfo.meshes.at(obj.model);
+            auto &model = frameInfo.currentInfo.meshes.at(models[i]);
             SpushConstant push{};
-            push.modelMatrix = obj.transform.mat4();
+            push.modelMatrix = worldMatrices[i];
 
             vkCmdPushConstants(
                 frameInfo.commandBuffer,
@@ -103,12 +113,12 @@ namespace GWIN
                 for (auto &subModel : model->getSubModels())
                 {
                     subModel->bind(frameInfo.commandBuffer);
-                    subModel->draw(frameInfo.commandBuffer);
+                    subModel->draw(frameInfo.commandBuffer, subModel->selectLod(worldMatrices[i], cameraPosition, projectionScale, lodBias));
                 }
             }
 
             model->bind(frameInfo.commandBuffer);
-            model->draw(frameInfo.commandBuffer);
+            model->draw(frameInfo.commandBuffer, model->selectLod(worldMatrices[i], cameraPosition, projectionScale, lodBias));
         }
     }
 }
\ No newline at end of file
@@ -88,7 +88,8 @@ namespace GWIN
         if (currentSkybox == VK_NULL_HANDLE)
             return;
 
-        auto &skybox = frameInfo.currentInfo.gameObjects.at(0);
+        auto &gameObjects = frameInfo.currentInfo.gameObjects;
+        auto skybox = frameInfo.currentInfo.skybox;
 
         pipeline->bind(frameInfo.commandBuffer);
 
@@ -105,7 +106,7 @@ namespace GWIN
             nullptr);
 
         SpushConstant push{};
-        push.modelMatrix = skybox.transform.mat4();
+        push.modelMatrix = gameObjects.worldMatrix(skybox);
 
         vkCmdPushConstants(
             frameInfo.commandBuffer,
@@ -115,7 +116,7 @@ namespace GWIN
             sizeof(SpushConstant),
             &push);
 
-        auto& model = frameInfo.currentInfo.meshes.at(skybox.model);
+        auto& model = frameInfo.currentInfo.meshes.at(gameObjects.model(skybox));
         model->bind(frameInfo.commandBuffer);
         model->draw(frameInfo.commandBuffer);
     }
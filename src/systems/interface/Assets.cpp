@@ -248,17 +248,24 @@ namespace GWIN
             return;
         }
 
-        Texture NewImage = imageLoader->createTexture(std::string(pathToFile), false);
-        imageLoader->decreaseLastTextureID();
+        // Every thumbnail gets one descriptor for the lifetime of the window
+        auto existing = images.find(fileName);
+        if (existing != images.end() && existing->second != VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        TextureHandle NewImage = imageLoader->acquireTexture(pathToFile, false);
 
-        if (NewImage.textureImage.imageView != nullptr && NewImage.textureSampler != nullptr)
+        if (NewImage->textureImage.imageView != nullptr && NewImage->textureSampler != nullptr)
         {
             VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
-            descriptorSet = ImGui_ImplVulkan_AddTexture(NewImage.textureSampler, NewImage.textureImage.imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+            descriptorSet = ImGui_ImplVulkan_AddTexture(NewImage->textureSampler, NewImage->textureImage.imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
             if (descriptorSet != VK_NULL_HANDLE)
             {
-                images.emplace(fileName, descriptorSet);
+                images[fileName] = descriptorSet;
+                imageTextures.push_back(std::move(NewImage));
             }
         }
     }
@@ -24,6 +24,7 @@ namespace GWIN
     {
         std::string pathToFile{"None"};
         int32_t index{0}; // what X object it points to, such as material.
+        TextureHandle texture; // keeps texture assets loaded
     };
 
     struct Asset
@@ -80,6 +81,7 @@ namespace GWIN
 
         std::vector<Asset> assets;
         std::unordered_map<std::string, VkDescriptorSet> images;
+        std::vector<TextureHandle> imageTextures;
 
         int32_t selectedAsset{-1}; //-1 for none
         uint32_t lastAssetID{0};
@@ -50,18 +50,19 @@ namespace GWIN
         History.push_back({passedTime, LogType::WARNING, warning});
     }
 
-    GWGameObject* GWConsole::findObjectByName(std::string &name, FrameInfo& frameInfo)
+    std::optional<GWGameObject::id_t> GWConsole::findObjectByName(std::string &name, FrameInfo& frameInfo)
     {
-        for (auto &kv : frameInfo.currentInfo.gameObjects)
+        auto &gameObjects = frameInfo.currentInfo.gameObjects;
+
+        for (auto id : gameObjects.getIds())
         {
-            auto& obj = kv.second;
-            if (obj.getName() == name)
+            if (gameObjects.name(id) == name)
             {
-                return &obj;
+                return id;
             }
         }
 
-        return nullptr;
+        return std::nullopt;
     }
 
     void GWConsole::cmdPrint(const std::string &command, FrameInfo &frameInfo)
@@ -84,9 +85,9 @@ namespace GWIN
 
         iss >> property;
 
-        GWGameObject *obj = findObjectByName(objectName, frameInfo);
+        auto obj = findObjectByName(objectName, frameInfo);
 
-        if (obj == nullptr)
+        if (!obj.has_value())
         {
             addError("Object with name " + objectName + " not found.");
             return;
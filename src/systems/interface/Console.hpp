@@ -3,6 +3,7 @@
 #include <imgui/imgui.h>
 #include <string>
 #include <vector>
+#include <optional>
 
 #include "GWFrameInfo.hpp"
 
@@ -40,7 +41,7 @@ namespace GWIN
         static std::vector<LogEntry> History;
         std::vector<std::string> Commands;
 
-        GWGameObject *findObjectByName(std::string &name, FrameInfo &frameInfo);
+        std::optional<GWGameObject::id_t> findObjectByName(std::string &name, FrameInfo &frameInfo);
 
         void cmdPrint(const std::string &command, FrameInfo &frameInfo);
         void clearLog();
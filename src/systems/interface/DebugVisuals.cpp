@@ -25,8 +25,7 @@ namespace GWIN
 
     void DebugElement::calcVerticesPos(FrameInfo &frameInfo)
     {
-        GWGameObject &obj = frameInfo.currentInfo.gameObjects.at(id);
-        glm::mat4 transformMatrix = obj.transform.mat4();
+        const glm::mat4 &transformMatrix = frameInfo.currentInfo.gameObjects.worldMatrix(id);
         glm::mat4 viewMatrix = frameInfo.currentInfo.currentCamera.getView();
         glm::mat4 projectionMatrix = frameInfo.currentInfo.currentCamera.getProjection();
 
@@ -86,27 +85,25 @@ namespace GWIN
 
         auto& currentInfo = frameInfo.currentInfo;
 
-        for (auto it = currentInfo.gameObjects.begin(); it != currentInfo.gameObjects.end(); it++)
-        {
-            const auto &[id, obj] = *it;
+        auto &lights = currentInfo.gameObjects.getLights();
+        auto &owners = currentInfo.gameObjects.getLightOwners();
 
-            auto findIt = processedIds.find(id);
+        for (size_t i = 0; i < lights.size(); ++i)
+        {
+            uint32_t id = owners[i];
 
-            if (findIt == processedIds.end())
+            if (processedIds.find(id) == processedIds.end())
             {
-                if (obj.light)
+                if (lights[i].cutOffAngle == 0.0f)
                 {
-                    if (obj.light->cutOffAngle == 0.0f)
-                    {
-                        createSphere(id);
-                    }
-                    else
-                    {
-                        createCone(id);
-                    }
-
-                    processedIds.emplace(id, id);
+                    createSphere(id);
                 }
+                else
+                {
+                    createCone(id);
+                }
+
+                processedIds.emplace(id, id);
             }
         }
 
@@ -114,8 +111,9 @@ namespace GWIN
         {
             auto &[id, element] = *it;
 
-            if (currentInfo.gameObjects.find(id) == currentInfo.gameObjects.end())
+            if (!currentInfo.gameObjects.contains(id))
             {
+                processedIds.erase(id);
                 it = debugMeshes.erase(it); // `erase` returns the iterator to the next element
             }
             else
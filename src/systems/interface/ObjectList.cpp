@@ -20,7 +20,7 @@ namespace GWIN
         return valueChanged;
     }
 
-    void GWObjectList::inputPosition(GWGameObject &selectedObject)
+    void GWObjectList::inputPosition(GWEntityStore &gameObjects, GWGameObject::id_t selectedObject)
     {
         ImGui::Text("Position:");
         bool positionChanged = false;
@@ -33,11 +33,11 @@ namespace GWIN
 
         if (positionChanged)
         {
-            selectedObject.transform.translation = positionBuffer;
+            gameObjects.editTransform(selectedObject).translation = positionBuffer;
         }
     }
 
-    void GWObjectList::inputRotation(GWGameObject &selectedObject)
+    void GWObjectList::inputRotation()
     {
         ImGui::Text("Rotation:");
         rotationChanged = false;
@@ -61,9 +61,19 @@ namespace GWIN
         ImGui::Text("%s", text);
     }
 
-    void GWObjectList::inputModel(GWGameObject &selectedObject)
+    void GWObjectList::selectObject(GWGameObject::id_t id, const std::string &name)
     {
-        if (selectedObject.model == -1)
+        selectedItem = id;
+        strncpy_s(nameBuffer, name.c_str(), sizeof(nameBuffer) - 1);
+        nameBuffer[sizeof(nameBuffer) - 1] = '\0';
+        isEditingName = false;
+        AssetSelected = false;
+        assets->setDisable(true);
+    }
+
+    void GWObjectList::inputModel(GWEntityStore &gameObjects, GWGameObject::id_t selectedObject)
+    {
+        if (gameObjects.model(selectedObject) == -1)
             return;
 
         if (ImGui::CollapsingHeader("Model", nullptr))
@@ -71,10 +81,15 @@ namespace GWIN
             ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(1.0f, 0.0f, 0.0f, 0.6f));
             if (ImGui::Button("Remove Model"))
             {
-                selectedObject.model = -1; 
+                gameObjects.setModel(selectedObject, -1);
             }
             ImGui::PopStyleColor();
-            ImGui::Checkbox("Cast Shadow", &selectedObject.castShadow);
+
+            bool castShadow = gameObjects.castShadow(selectedObject);
+            if (ImGui::Checkbox("Cast Shadow", &castShadow))
+            {
+                gameObjects.setCastShadow(selectedObject, castShadow);
+            }
 
             std::string modelName = "Placeholder Code";
             ImGui::Text("Current Model: %s", modelName.c_str());
@@ -92,6 +107,7 @@ namespace GWIN
             if (ImGui::Button("Remove Texture"))
             {
                 selectedObject->Textures[0] = 1;
+                selectedObject->textureHandles[0] = nullptr;
             }
             ImGui::PopStyleColor();
 
@@ -122,22 +138,22 @@ namespace GWIN
 
     float cutOffAngleBuffer = 0.0f;
     float lightColor[3] = {1.0f, 1.0f, 1.0f};
-    void GWObjectList::inputLight(GWGameObject &selectedObject)
+    void GWObjectList::inputLight(LightComponent &selectedLight)
     {
         if (ImGui::CollapsingHeader("Light", nullptr))
         {
-            lightColor[0] = selectedObject.color.r;
-            lightColor[1] = selectedObject.color.g;
-            lightColor[2] = selectedObject.color.b;
+            lightColor[0] = selectedLight.color.r;
+            lightColor[1] = selectedLight.color.g;
+            lightColor[2] = selectedLight.color.b;
 
-            if (selectedObject.light->cutOffAngle != 0.0f)
+            if (selectedLight.cutOffAngle != 0.0f)
             {
-                cutOffAngleBuffer = glm::degrees(selectedObject.light->cutOffAngle);
+                cutOffAngleBuffer = glm::degrees(selectedLight.cutOffAngle);
 
                 ImGui::Text("Type: Spotlight");
                 ImGui::DragFloat("CutOff Angle: ", &cutOffAngleBuffer, .1f, 0.1f, 90.f, "%.1f");
 
-                selectedObject.light->cutOffAngle = glm::radians(cutOffAngleBuffer);
+                selectedLight.cutOffAngle = glm::radians(cutOffAngleBuffer);
             }
             else
             {
@@ -145,20 +161,22 @@ namespace GWIN
             }
 
             ImGui::ColorEdit3("Light Color: ", lightColor);
-            selectedObject.color.r = lightColor[0];
-            selectedObject.color.g = lightColor[1];
-            selectedObject.color.b = lightColor[2];
+            selectedLight.color.r = lightColor[0];
+            selectedLight.color.g = lightColor[1];
+            selectedLight.color.b = lightColor[2];
 
-            ImGui::DragFloat("Intensity: ", &selectedObject.light->lightIntensity, .1f, 0.f, FLT_MAX, "%.1f");
+            ImGui::DragFloat("Intensity: ", &selectedLight.lightIntensity, .1f, 0.f, FLT_MAX, "%.1f");
         }
     }
 
-    void GWObjectList::inspectorGuis(GWGameObject &selectedObject, FrameInfo& frameInfo)
+    void GWObjectList::inspectorGuis(GWGameObject::id_t selectedObject, FrameInfo& frameInfo)
     {
+        auto &gameObjects = frameInfo.currentInfo.gameObjects;
+
         if (ImGui::CollapsingHeader("Transform", nullptr))
         {
-            inputPosition(selectedObject);
-            inputRotation(selectedObject);
+            inputPosition(gameObjects, selectedObject);
+            inputRotation();
 
             ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "Scale:");
 
@@ -170,23 +188,25 @@ namespace GWIN
 
             if (scaleChanged)
             {
-                selectedObject.transform.scale = scaleBuffer;
+                gameObjects.editTransform(selectedObject).scale = scaleBuffer;
             }
         }
 
-        if (selectedObject.light == nullptr)
+        LightComponent *light = gameObjects.light(selectedObject);
+
+        if (light == nullptr)
         {
-            if (selectedObject.model != -1)
+            if (gameObjects.model(selectedObject) != -1)
             {
-                auto &model = frameInfo.currentInfo.meshes.at(selectedObject.model);
-                inputModel(selectedObject);
+                auto &model = frameInfo.currentInfo.meshes.at(gameObjects.model(selectedObject));
+                inputModel(gameObjects, selectedObject);
                 inputTexture(model);
                 inputMaterial(model);
             }
         }
         else
         {
-            inputLight(selectedObject);
+            inputLight(*light);
         }
     }
 
@@ -334,23 +354,24 @@ namespace GWIN
                     path = fullPath;
                 }
 
-                Texture newTexture;
+                TextureHandle newTexture = assets->getTextureHandler()->acquireTexture(fullPath, true);
+                createTextureCallback(*newTexture, newTexture->id);
 
-                if (selectedAsset.info.index == 0)
+                // Models showing the old texture switch to the new one, the old one is freed once nothing holds it
+                if (selectedAsset.info.index != 0)
                 {
-                    newTexture = assets->getTextureHandler()->createTexture(fullPath, true);
-
-                    createTextureCallback(newTexture, newTexture.id);
-
-                    selectedAsset.info.index = newTexture.id;
-                } else {
-                    assets->getTextureHandler()->destroyTexture(selectedAsset.info.index);
-                    newTexture = assets->getTextureHandler()->createTexture(fullPath, selectedAsset.info.index);
-
-                    newTexture.id = selectedAsset.info.index;
-
-                    createTextureCallback(newTexture, newTexture.id);
+                    for (auto &[id, mesh] : frameInfo.currentInfo.meshes)
+                    {
+                        if (mesh->Textures[0] == static_cast<uint32_t>(selectedAsset.info.index))
+                        {
+                            mesh->Textures[0] = newTexture->id;
+                            mesh->textureHandles[0] = newTexture;
+                        }
+                    }
                 }
+
+                selectedAsset.info.index = newTexture->id;
+                selectedAsset.info.texture = newTexture;
             }
             ImGuiFileDialog::Instance()->Close();
         }
@@ -438,7 +459,7 @@ namespace GWIN
             std::vector<Asset> &textureAssets = assetsMap[ASSET_TYPE_TEXTURE];
             std::vector<Asset> &materialAssets = assetsMap[ASSET_TYPE_MATERIAL];
 
-            auto &currentObject = frameInfo.currentInfo.gameObjects.at(selectedItem);
+            int32_t currentModelId = frameInfo.currentInfo.gameObjects.model(selectedItem);
 
             if (ImGui::BeginCombo("##MeshCombo", "Select Mesh"))
             {
@@ -450,10 +471,11 @@ namespace GWIN
                 {
                     for (const auto &asset : meshAssets)
                     {
-                        bool isSelected = (asset.info.index == currentObject.model);
+                        bool isSelected = (asset.info.index == currentModelId);
                         if (ImGui::Selectable(asset.name.c_str(), isSelected))
                         {
-                            currentObject.model = asset.info.index;
+                            currentModelId = asset.info.index;
+                            frameInfo.currentInfo.gameObjects.setModel(selectedItem, currentModelId);
                             ImGui::CloseCurrentPopup(); 
                         }
                     }
@@ -463,19 +485,20 @@ namespace GWIN
 
             if (ImGui::BeginCombo("##TextureCombo", "Select Texture"))
             {
-                if (textureAssets.empty() || currentObject.model == -1)
+                if (textureAssets.empty() || currentModelId == -1)
                 {
                     ImGui::Text("No Textures Created!");
                 }
                 else
                 {
-                    auto &currentModel = frameInfo.currentInfo.meshes.at(currentObject.model);
+                    auto &currentModel = frameInfo.currentInfo.meshes.at(currentModelId);
                     for (const auto &asset : textureAssets)
                     {
                         bool isSelected = (asset.info.index == currentModel->Textures[0]);
                         if (ImGui::Selectable(asset.name.c_str(), isSelected))
                         {
                             currentModel->Textures[0] = asset.info.index;
+                            currentModel->textureHandles[0] = asset.info.texture;
                             ImGui::CloseCurrentPopup();
                         }
                     }
@@ -485,13 +508,13 @@ namespace GWIN
 
             if (ImGui::BeginCombo("##MaterialCombo", "Select Material"))
             {
-                if (materialAssets.empty() || currentObject.model == -1)
+                if (materialAssets.empty() || currentModelId == -1)
                 {
                     ImGui::Text("No Materials Created!");
                 }
                 else
                 {
-                    auto &currentModel = frameInfo.currentInfo.meshes.at(currentObject.model);
+                    auto &currentModel = frameInfo.currentInfo.meshes.at(currentModelId);
                     for (const auto &asset : materialAssets)
                     {
                         bool isSelected = (asset.info.index == currentModel->Material);
@@ -569,24 +592,62 @@ namespace GWIN
             }
 
             ImGui::BeginChild("##ScrollingRegion1", ImVec2(0, 0), ImGuiChildFlags_None);
-            for (auto &kv : frameInfo.currentInfo.gameObjects)
+            auto &gameObjects = frameInfo.currentInfo.gameObjects;
+            auto &ids = gameObjects.getIds();
+            auto &parentIndices = gameObjects.getParentIndices();
+            std::vector<uint32_t> depths(ids.size(), 0);
+
+            for (size_t i = 0; i < ids.size(); ++i)
             {
-                std::string objId = kv.second.getName() + "##" + (char)kv.first;
-                if (kv.first == selectedItem)
+                auto id = ids[i];
+                const std::string &name = gameObjects.name(id);
+
+                // Objects are stored depth-first, so the parent's depth is already known
+                depths[i] = parentIndices[i] < i ? depths[parentIndices[i]] + 1 : 0;
+                float indent = depths[i] * ImGui::GetStyle().IndentSpacing;
+                if (indent > 0.f)
+                    ImGui::Indent(indent);
+
+                std::string objId = name + "##" + (char)id;
+                if (id == selectedItem)
+                {
+                    auto &transform = gameObjects.transform(id);
+                    positionBuffer = transform.translation;
+                    rotationBuffer = transform.getRotation();
+                    scaleBuffer = transform.scale;
+                }
+                if (ImGui::Selectable(objId.c_str(), (selectedItem == id) && !AssetSelected))
+                {
+                    selectObject(id, name);
+                }
+
+                if (ImGui::BeginDragDropSource())
+                {
+                    ImGui::SetDragDropPayload("GW_GAMEOBJECT", &id, sizeof(id));
+                    ImGui::Text("%s", name.c_str());
+                    ImGui::EndDragDropSource();
+                }
+
+                if (ImGui::BeginDragDropTarget())
                 {
-                    positionBuffer = kv.second.transform.translation;
-                    rotationBuffer = kv.second.transform.getRotation();
-                    scaleBuffer = kv.second.transform.scale;
+                    if (const ImGuiPayload *payload = ImGui::AcceptDragDropPayload("GW_GAMEOBJECT"))
+                    {
+                        auto child = *static_cast<const GWGameObject::id_t *>(payload->Data);
+                        if (!gameObjects.setParent(child, id))
+                            GWConsole::addWarning("Cannot parent an object to itself or to one of its children.");
+                    }
+                    ImGui::EndDragDropTarget();
                 }
-                if (ImGui::Selectable(objId.c_str(), (selectedItem == kv.second.getId()) && !AssetSelected))
+
+                if (gameObjects.parent(id) != GWEntityStore::NO_PARENT && ImGui::BeginPopupContextItem())
                 {
-                    selectedItem = kv.second.getId();
-                    strncpy_s(nameBuffer, kv.second.getName().c_str(), sizeof(nameBuffer) - 1);
-                    nameBuffer[sizeof(nameBuffer) - 1] = '\0';
-                    isEditingName = false;
-                    AssetSelected = false;
-                    assets->setDisable(true);
+                    if (ImGui::MenuItem("Unparent"))
+                        gameObjects.setParent(id, GWEntityStore::NO_PARENT);
+                    ImGui::EndPopup();
                 }
+
+                if (indent > 0.f)
+                    ImGui::Unindent(indent);
             } 
             ImGui::EndChild(); 
             ImGui::End();
@@ -605,12 +666,12 @@ namespace GWIN
 
                 if (!AssetSelected)
                 {
-                    GWGameObject &selectedObject = frameInfo.currentInfo.gameObjects.at(selectedItem);
-                    glm::vec3 position = selectedObject.transform.translation;
+                    auto &gameObjects = frameInfo.currentInfo.gameObjects;
+                    GWGameObject::id_t selectedObject = selectedItem;
 
                     if (!isEditingName)
                     {
-                        std::string name = selectedObject.getName();
+                        std::string name = gameObjects.name(selectedObject);
                         auto nameDisplay = "Name: " + name;
                         if (ImGui::Selectable(nameDisplay.c_str(), isEditingName))
                         {
@@ -621,7 +682,7 @@ namespace GWIN
                     {
                         if (ImGui::InputText("##Name", nameBuffer, sizeof(nameBuffer), ImGuiInputTextFlags_EnterReturnsTrue))
                         {
-                            selectedObject.setName(std::string(nameBuffer));
+                            gameObjects.setName(selectedObject, std::string(nameBuffer));
                             isEditingName = false;
                         }
                     }
@@ -629,7 +690,7 @@ namespace GWIN
                     inspectorGuis(selectedObject, frameInfo);
                     if (rotationChanged)
                     {
-                        selectedObject.transform.rotate(rotationBuffer);
+                        gameObjects.editTransform(selectedObject).rotate(rotationBuffer);
                     }
                     addComponent(frameInfo);
                 }
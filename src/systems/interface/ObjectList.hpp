@@ -19,9 +19,10 @@ namespace GWIN
         void Draw(FrameInfo& frameInfo);
 
         uint32_t getSelectedObject() { return selectedItem; }
+        void selectObject(GWGameObject::id_t id, const std::string &name);
         bool isAssetSelected() { return AssetSelected; }
 
-        void setCreateTextureCallback(std::function<void(Texture &texture, uint32_t id)> callback) { createTextureCallback = callback; };
+        void setCreateTextureCallback(std::function<void(const Texture &texture, uint32_t id)> callback) { createTextureCallback = callback; };
         void setCreateMeshCallback(std::function<uint32_t(const std::string path, std::optional<uint32_t> replaceId)> callback) { createMeshCallback = callback; };
         void setRemoveMeshCallback(std::function<void(uint32_t id)> callback) { removeMeshCallback = callback; };
         void setCreateObjectCallback(std::function<void(GameObjectType type)> callback) { createObjectCallback = callback; };
@@ -43,7 +44,7 @@ namespace GWIN
         glm::vec3 scaleBuffer = { 1.0f, 1.0f, 1.0f };
 
         std::function<uint32_t(const std::string path, std::optional<uint32_t> replaceId)> createMeshCallback;
-        std::function<void(Texture &texture, uint32_t id)> createTextureCallback; 
+        std::function<void(const Texture &texture, uint32_t id)> createTextureCallback; 
         std::function<void(uint32_t id)> removeMeshCallback;
         std::function<void(GameObjectType type)> createObjectCallback;
         std::function<void(uint32_t id)> removeObjectCallback;
@@ -52,14 +53,14 @@ namespace GWIN
 
         std::unique_ptr<AssetsWindow>& assets;
 
-        void inputModel(GWGameObject &selectedObject);
+        void inputModel(GWEntityStore &gameObjects, GWGameObject::id_t selectedObject);
         void inputTexture(std::shared_ptr<GWModel> &selectedObject);
         void inputMaterial(std::shared_ptr<GWModel> &selectedObject);
 
-        void inputLight(GWGameObject &selectedObject); 
-        void inputRotation(GWGameObject &selectedObject);
-        void inputPosition(GWGameObject &selectedObject);
-        void inspectorGuis(GWGameObject &selectedObject, FrameInfo &frameInfo);
+        void inputLight(LightComponent &selectedLight); 
+        void inputRotation();
+        void inputPosition(GWEntityStore &gameObjects, GWGameObject::id_t selectedObject);
+        void inspectorGuis(GWGameObject::id_t selectedObject, FrameInfo &frameInfo);
 
         //Asset-Type specific options
         void materialEditor(Asset& selectedAsset);